@@ -0,0 +1,135 @@
+#include "bank_compaction.h"
+
+#include "orientation_estimation.h"
+#include "rotation_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+
+
+
+/**
+ * @brief Computes the normalized cross-correlation of two images of the same size over a mask.
+ *
+ * @param[in] first_img The first image.
+ * @param[in] second_img The second image.
+ * @param[in] mask The `CV_8U` mask of the pixels taken into account.
+ * @return The correlation coefficient of the masked pixels, in [-1, 1]; 0 if either image is flat.
+ */
+double maskedCorrelation(const cv::Mat& first_img, const cv::Mat& second_img, const cv::Mat& mask)
+{
+    cv::Mat first_64f, second_64f;
+    first_img.convertTo(first_64f, CV_64F);
+    second_img.convertTo(second_64f, CV_64F);
+
+    first_64f -= cv::mean(first_64f, mask);
+    second_64f -= cv::mean(second_64f, mask);
+    first_64f.setTo(0, mask == 0);
+    second_64f.setTo(0, mask == 0);
+
+    const double norms = cv::norm(first_64f) * cv::norm(second_64f);
+    return norms > 1e-6 ? first_64f.dot(second_64f) / norms : 0.0;
+}
+
+/**
+ * @brief Computes the similarity of two templates, whatever their relative rotation.
+ *
+ * The second template is scaled to the area of the first one, then rotated by every angle of the sweep. For
+ * each angle, the two templates are compared over the disk inscribed in both, which does not depend on the
+ * rotation (see `diskMask`). The similarity is the best correlation over the angles.
+ *
+ * @param[in] first_template The first grayscale template.
+ * @param[in] second_template The second grayscale template.
+ * @param[in] angle_step The angle step, in degrees, of the sweep.
+ * @param[in] max_area_ratio The maximum ratio between the areas of two comparable templates: templates of
+ *                           too different sizes match different aircraft, so they are never redundant.
+ * @return The similarity, in [-1, 1]; -1 if the templates are not comparable.
+ *
+ * @see maskedCorrelation
+ * @see rotateImage
+ */
+double templateSimilarity(const cv::Mat& first_template, const cv::Mat& second_template, int angle_step, double max_area_ratio)
+{
+    const double first_area = static_cast<double>(first_template.total());
+    const double second_area = static_cast<double>(second_template.total());
+    if (std::max(first_area, second_area) > max_area_ratio * std::min(first_area, second_area))
+        return -1.0;
+
+    cv::Mat scaled_template;
+    const double scale = std::sqrt(first_area / second_area);
+    cv::resize(second_template, scaled_template, cv::Size(), scale, scale, scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR);
+
+    const int disk_diameter = std::min({ first_template.cols, first_template.rows, scaled_template.cols, scaled_template.rows });
+    const cv::Mat disk_mask = diskMask(disk_diameter);
+    auto central_disk = [disk_diameter](const cv::Mat& img)
+    {
+        return img(cv::Rect((img.cols - disk_diameter) / 2, (img.rows - disk_diameter) / 2, disk_diameter, disk_diameter));
+    };
+
+    const cv::Mat first_disk = central_disk(first_template);
+    double similarity = -1.0;
+    for (int degree_angle = 0; degree_angle < 360; degree_angle += angle_step)
+    {
+        const cv::Mat rotated_template = rotateImage(scaled_template, degree_angle);
+        similarity = std::max(similarity, maskedCorrelation(first_disk, central_disk(rotated_template), disk_mask));
+    }
+    return similarity;
+}
+
+/**
+ * @brief Finds the templates that are redundant with another one, within a similarity tolerance.
+ *
+ * The pairwise similarities (see `templateSimilarity`) are computed in parallel on the shared thread pool.
+ * The templates are then visited in order: a template is kept unless it is at least `min_similarity` similar
+ * to an already kept one, in which case the most similar kept template stands for it.
+ *
+ * @param[in] templates The grayscale templates.
+ * @param[in] angle_step The angle step, in degrees, of the rotations compared.
+ * @param[in] min_similarity The similarity from which a template is redundant, in [-1, 1].
+ * @param[in] max_area_ratio The maximum ratio between the areas of two comparable templates.
+ * @return The representative of every template and its similarity to it.
+ *
+ * @see templateSimilarity
+ * @see sharedThreadPool
+ */
+TemplateRedundancy findRedundantTemplates(const std::vector<cv::Mat>& templates, int angle_step, double min_similarity, double max_area_ratio)
+{
+    const int num_templates = static_cast<int>(templates.size());
+
+    // Only the upper triangle is computed, the similarity being symmetric up to the rotation sampling
+    std::vector<std::future<std::vector<double>>> futures;
+    for (int i = 0; i < num_templates; i++)
+    {
+        futures.emplace_back(sharedThreadPool().submit([&templates, i, num_templates, angle_step, max_area_ratio]() {
+            std::vector<double> row(num_templates, -1.0);
+            for (int j = i + 1; j < num_templates; j++)
+                row[j] = templateSimilarity(templates[i], templates[j], angle_step, max_area_ratio);
+            return row;
+            }));
+    }
+    const std::vector<std::vector<double>> similarity_rows = sharedThreadPool().waitAll(futures);
+    auto similarity = [&](int i, int j) { return i < j ? similarity_rows[i][j] : similarity_rows[j][i]; };
+
+    TemplateRedundancy redundancy;
+    redundancy.representatives.resize(num_templates);
+    redundancy.similarities.assign(num_templates, 1.0);
+    std::vector<int> kept_templates;
+    for (int i = 0; i < num_templates; i++)
+    {
+        redundancy.representatives[i] = i;
+        double best_similarity = min_similarity;
+        for (const int kept_template : kept_templates)
+        {
+            if (similarity(i, kept_template) >= best_similarity)
+            {
+                best_similarity = similarity(i, kept_template);
+                redundancy.representatives[i] = kept_template;
+                redundancy.similarities[i] = best_similarity;
+            }
+        }
+
+        if (redundancy.representatives[i] == i)
+            kept_templates.push_back(i);
+    }
+    return redundancy;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+struct TemplateRedundancy
+{
+    std::vector<int> representatives; // for every template, the index of the kept template standing for it (itself if kept)
+    std::vector<double> similarities; // for every template, its similarity to its representative (1 if kept)
+};
+
+double templateSimilarity(const cv::Mat& first_template, const cv::Mat& second_template, int angle_step, double max_area_ratio);
+
+TemplateRedundancy findRedundantTemplates(const std::vector<cv::Mat>& templates, int angle_step, double min_similarity, double max_area_ratio);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T item);
+
+    std::optional<T> pop();
+
+    void close();
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+
+
+/**
+ * @brief Adds an item at the back of the queue, waiting while the queue is full.
+ *
+ * The producer is held back when the consumer falls behind, so the items in flight never exceed the capacity.
+ *
+ * @param[in] item The item to add.
+ * @return `true` if the item was added, `false` if the queue was closed (the item is then dropped).
+ *
+ * @see pop
+ */
+template<typename T>
+bool BoundedQueue<T>::push(T item)
+{
+    std::unique_lock lock(mutex);
+    not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+    if (closed)
+        return false;
+
+    items.push_back(std::move(item));
+    lock.unlock();
+    not_empty.notify_one();
+    return true;
+}
+
+/**
+ * @brief Removes the item at the front of the queue, waiting while the queue is empty.
+ *
+ * @return The item, or `std::nullopt` once the queue is closed and all the items pushed before have been popped.
+ *
+ * @see push
+ */
+template<typename T>
+std::optional<T> BoundedQueue<T>::pop()
+{
+    std::unique_lock lock(mutex);
+    not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+    if (items.empty())
+        return std::nullopt;
+
+    std::optional<T> item(std::move(items.front()));
+    items.pop_front();
+    lock.unlock();
+    not_full.notify_one();
+    return item;
+}
+
+/**
+ * @brief Closes the queue: no item can be pushed anymore, and the waiting producers and consumers are woken up.
+ *
+ * The items already in the queue can still be popped. Closing the queue is how the producer signals the end of
+ * the stream, and how the consumer stops a producer it no longer reads from (e.g. after an error).
+ */
+template<typename T>
+void BoundedQueue<T>::close()
+{
+    {
+        std::lock_guard lock(mutex);
+        closed = true;
+    }
+    not_full.notify_all();
+    not_empty.notify_all();
+}
@@ -0,0 +1,290 @@
+#include "dense_hog.h"
+
+#include "hog_features_extraction.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+
+/**
+ * @brief Computes the orientation bins of the gradient of every pixel, as `cv::HOGDescriptor` does.
+ *
+ * The gradient is the centered difference [-1, 0, 1] along each axis, with reflected borders. Its unsigned
+ * orientation (0 to 180 degrees) is linearly interpolated between the two nearest of the `hog_num_bins` bins,
+ * whose centers are at the middle of each 20 degree range: every pixel gives its magnitude to two bins, with
+ * weights summing to the magnitude.
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[out] bin_weights A `CV_32FC2` image with the weights of the two bins of every pixel.
+ * @param[out] bins A `CV_8UC2` image with the indices of the two bins of every pixel.
+ *
+ * @see cv::HOGDescriptor::computeGradient
+ */
+void hogGradientBins(const cv::Mat& gray_img, cv::Mat& bin_weights, cv::Mat& bins)
+{
+    cv::Mat dx, dy, magnitude, angle;
+    cv::Sobel(gray_img, dx, CV_32F, 1, 0, 1);
+    cv::Sobel(gray_img, dy, CV_32F, 0, 1, 1);
+    cv::cartToPolar(dx, dy, magnitude, angle);
+
+    bin_weights.create(gray_img.size(), CV_32FC2);
+    bins.create(gray_img.size(), CV_8UC2);
+
+    // The angle is in [0, 2 pi): its bin index wraps around twice
+    const float angle_scale = static_cast<float>(hog_num_bins / CV_PI);
+    for (int y = 0; y < gray_img.rows; y++)
+    {
+        const float* magnitude_row = magnitude.ptr<float>(y);
+        const float* angle_row = angle.ptr<float>(y);
+        float* weights_row = bin_weights.ptr<float>(y);
+        uchar* bins_row = bins.ptr<uchar>(y);
+        for (int x = 0; x < gray_img.cols; x++)
+        {
+            float bin_position = angle_row[x] * angle_scale - 0.5f;
+            int bin = cvFloor(bin_position);
+            bin_position -= bin;
+
+            weights_row[2 * x] = magnitude_row[x] * (1.0f - bin_position);
+            weights_row[2 * x + 1] = magnitude_row[x] * bin_position;
+
+            if (bin < 0)
+                bin += hog_num_bins;
+            else if (bin >= hog_num_bins)
+                bin -= hog_num_bins;
+            bins_row[2 * x] = static_cast<uchar>(bin);
+            bins_row[2 * x + 1] = static_cast<uchar>(bin + 1 < hog_num_bins ? bin + 1 : 0);
+        }
+    }
+}
+
+/**
+ * @brief Returns the weight of every pixel of a cell in its histogram, as `cv::HOGDescriptor` does.
+ *
+ * @return A `hog_cell_size` x `hog_cell_size` `CV_32F` matrix of weights.
+ *
+ * @see hogCellWeight
+ */
+cv::Mat hogCellWeights()
+{
+    cv::Mat weights(hog_cell_size, hog_cell_size, CV_32F);
+    for (int i = 0; i < hog_cell_size; i++)
+    {
+        for (int j = 0; j < hog_cell_size; j++)
+            weights.at<float>(i, j) = hogCellWeight<hog_cell_size>(i, j);
+    }
+    return weights;
+}
+
+/**
+ * @brief Computes the normalized cell histograms of an image on a dense grid.
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[in] cell_stride The distance, in pixels, between two neighboring cells of the grid.
+ * @return A `CV_32F` matrix with one row per row of cells and `hog_num_bins` columns per cell.
+ */
+cv::Mat denseCellHistograms(const cv::Mat& gray_img, int cell_stride)
+{
+    cv::Mat bin_weights, bins;
+    hogGradientBins(gray_img, bin_weights, bins);
+    const cv::Mat cell_weights = hogCellWeights();
+
+    const int grid_rows = (gray_img.rows - hog_cell_size) / cell_stride + 1;
+    const int grid_cols = (gray_img.cols - hog_cell_size) / cell_stride + 1;
+    cv::Mat cells = cv::Mat::zeros(grid_rows, grid_cols * hog_num_bins, CV_32F);
+    for (int cell_y = 0; cell_y < grid_rows; cell_y++)
+    {
+        float* cells_row = cells.ptr<float>(cell_y);
+        for (int cell_x = 0; cell_x < grid_cols; cell_x++)
+        {
+            float* histogram = cells_row + cell_x * hog_num_bins;
+            for (int i = 0; i < hog_cell_size; i++)
+            {
+                const int y = cell_y * cell_stride + i;
+                const float* weights_row = bin_weights.ptr<float>(y) + 2 * cell_x * cell_stride;
+                const uchar* bins_row = bins.ptr<uchar>(y) + 2 * cell_x * cell_stride;
+                const float* cell_weights_row = cell_weights.ptr<float>(i);
+                for (int j = 0; j < hog_cell_size; j++)
+                {
+                    histogram[bins_row[2 * j]] += weights_row[2 * j] * cell_weights_row[j];
+                    histogram[bins_row[2 * j + 1]] += weights_row[2 * j + 1] * cell_weights_row[j];
+                }
+            }
+            normalizeHogHistogram<hog_num_bins>(histogram);
+        }
+    }
+    return cells;
+}
+
+/**
+ * @brief Estimates the memory used to build the HOG cells of a level, for the admission of the pool tasks.
+ *
+ * @param[in] level_size The size of the resized image of the level.
+ * @param[in] cell_stride The distance, in pixels, between two neighboring cells of the grid.
+ * @return The estimated number of bytes.
+ *
+ * @see denseCellHistograms
+ */
+size_t denseHogLevelMemory(cv::Size level_size, int cell_stride)
+{
+    // Resized image, float gradients, magnitudes and angles, and the two bins (weights and indices) per pixel,
+    // plus the cell histograms, kept with the level
+    const size_t bytes_per_pixel = sizeof(uchar) + 4 * sizeof(float) + 2 * sizeof(float) + 2 * sizeof(uchar);
+    const size_t level_area = static_cast<size_t>(level_size.area());
+    return level_area * bytes_per_pixel + level_area * hog_num_bins * sizeof(float) / (cell_stride * cell_stride);
+}
+
+/**
+ * @brief Builds the HOG cells of an image, once for every ROI size.
+ *
+ * For every window size, the image is resized so that a ROI of that size spans exactly one HOG window (the
+ * resize `hog_features_extraction` applies to each ROI), and the normalized histograms of the cells are
+ * computed on a grid with the given stride. The blocks of the descriptors are single cells, so the normalized
+ * cells are shared as they are by all the overlapping ROIs. The levels are built in parallel on the shared
+ * thread pool, each task declaring the memory of its level (see `denseHogLevelMemory`).
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[in] window_sizes The ROI sizes the descriptors will be computed for.
+ * @param[in] cell_stride The distance, in pixels, between two neighboring cells; it must divide `hog_cell_size`.
+ *                        Smaller strides place the ROIs more accurately, at a higher cost.
+ *
+ * @throws std::invalid_argument If the stride does not divide the cell size.
+ *
+ * @see denseCellHistograms
+ */
+DenseHog::DenseHog(const cv::Mat& gray_img, const std::vector<cv::Size>& window_sizes, int cell_stride)
+    : cell_stride(cell_stride)
+{
+    if (cell_stride <= 0 || hog_cell_size % cell_stride != 0)
+        throw std::invalid_argument("The HOG cell stride must divide the cell size.");
+
+    std::vector<cv::Size> level_sizes;
+    for (const auto& window_size : window_sizes)
+    {
+        if (!window_size.empty() && std::find(level_sizes.begin(), level_sizes.end(), window_size) == level_sizes.end())
+            level_sizes.push_back(window_size);
+    }
+
+    std::vector<std::future<HogLevel>> futures;
+    for (const auto& window_size : level_sizes)
+    {
+        const double scale_x = static_cast<double>(hog_window_size) / window_size.width;
+        const double scale_y = static_cast<double>(hog_window_size) / window_size.height;
+        const cv::Size level_size(cvRound(gray_img.cols * scale_x), cvRound(gray_img.rows * scale_y));
+
+        futures.emplace_back(sharedThreadPool().submit([&gray_img, window_size, scale_x, scale_y, level_size, cell_stride]() {
+            HogLevel level;
+            level.window_size = window_size;
+            level.scale_x = scale_x;
+            level.scale_y = scale_y;
+            if (level_size.width < hog_window_size || level_size.height < hog_window_size)
+                return level;
+
+            cv::Mat level_img;
+            cv::resize(gray_img, level_img, level_size, 0, 0, cv::INTER_AREA);
+            level.cells = denseCellHistograms(level_img, cell_stride);
+            return level;
+            }, denseHogLevelMemory(level_size, cell_stride)));
+    }
+
+    // The levels too small to hold a window are dropped
+    for (auto& level : sharedThreadPool().waitAll(futures))
+    {
+        if (!level.cells.empty())
+            hog_levels.push_back(std::move(level));
+    }
+}
+
+/**
+ * @brief Returns the level whose window size is the nearest to a ROI size, in scale.
+ *
+ * @param[in] roi_size The size of the ROI.
+ * @return The nearest level.
+ *
+ * @throws std::runtime_error If the image has no level.
+ */
+const HogLevel& DenseHog::nearestLevel(cv::Size roi_size) const
+{
+    if (hog_levels.empty())
+        throw std::runtime_error("The image is too small for the HOG window.");
+
+    const HogLevel* nearest_level = &hog_levels.front();
+    double nearest_distance = std::numeric_limits<double>::infinity();
+    for (const auto& level : hog_levels)
+    {
+        const double distance = std::abs(std::log(static_cast<double>(roi_size.width) / level.window_size.width))
+            + std::abs(std::log(static_cast<double>(roi_size.height) / level.window_size.height));
+        if (distance < nearest_distance)
+        {
+            nearest_distance = distance;
+            nearest_level = &level;
+        }
+    }
+    return *nearest_level;
+}
+
+/**
+ * @brief Returns the cell of a level nearest to an image point, as the top-left cell of a window.
+ *
+ * @param[in] level The level.
+ * @param[in] point The point, in image coordinates.
+ * @return The column and row of the cell in the grid of the level, clamped so that the window fits in the grid.
+ */
+cv::Point DenseHog::cellPosition(const HogLevel& level, cv::Point point) const
+{
+    const int window_span = (hog_cells_per_side - 1) * (hog_cell_size / cell_stride) + 1;
+    const int grid_cols = level.cells.cols / hog_num_bins;
+    const int grid_rows = level.cells.rows;
+
+    return {
+        std::clamp(cvRound(point.x * level.scale_x / cell_stride), 0, grid_cols - window_span),
+        std::clamp(cvRound(point.y * level.scale_y / cell_stride), 0, grid_rows - window_span)
+    };
+}
+
+/**
+ * @brief Assembles the HOG descriptor of a ROI from the cells of the nearest level.
+ *
+ * The descriptor has the layout of `cv::HOGDescriptor` (blocks in column-major order), so it can be scored by
+ * the same SVM. The ROI is snapped to the nearest cell of the grid: with a stride s, its position is off by at
+ * most s / 2 pixels of the window.
+ *
+ * @param[in] roi The ROI, in image coordinates.
+ * @param[out] features The `hog_descriptor_size` features of the descriptor.
+ *
+ * @see nearestLevel
+ * @see cellPosition
+ */
+void DenseHog::descriptor(const cv::Rect& roi, float* features) const
+{
+    const HogLevel& level = nearestLevel(roi.size());
+    const cv::Point cell = cellPosition(level, roi.tl());
+    const int cell_step = hog_cell_size / cell_stride;
+
+    for (int block_x = 0; block_x < hog_cells_per_side; block_x++)
+    {
+        for (int block_y = 0; block_y < hog_cells_per_side; block_y++)
+        {
+            const float* histogram = level.cells.ptr<float>(cell.y + block_y * cell_step) + (cell.x + block_x * cell_step) * hog_num_bins;
+            std::copy(histogram, histogram + hog_num_bins, features + (block_x * hog_cells_per_side + block_y) * hog_num_bins);
+        }
+    }
+}
+
+/**
+ * @brief Assembles the HOG descriptors of several ROIs.
+ *
+ * @param[in] rois The ROIs, in image coordinates.
+ * @return A `CV_32F` matrix with the `hog_descriptor_size` features of every ROI, one ROI per row.
+ *
+ * @see descriptor
+ */
+cv::Mat DenseHog::descriptors(const std::vector<cv::Rect>& rois) const
+{
+    cv::Mat features(static_cast<int>(rois.size()), hog_descriptor_size, CV_32F);
+    for (size_t i = 0; i < rois.size(); i++)
+        descriptor(rois[i], features.ptr<float>(static_cast<int>(i)));
+    return features;
+}
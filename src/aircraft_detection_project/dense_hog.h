@@ -0,0 +1,39 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+struct HogLevel
+{
+    cv::Size window_size; // ROI size this level is scaled for: such ROIs span exactly one HOG window
+    double scale_x = 1.0; // horizontal and vertical scale from the image to the level
+    double scale_y = 1.0;
+    cv::Mat cells;        // CV_32F, one row of normalized cell histograms (bins contiguous) per row of cells
+};
+
+void hogGradientBins(const cv::Mat& gray_img, cv::Mat& bin_weights, cv::Mat& bins);
+
+cv::Mat hogCellWeights();
+
+class DenseHog
+{
+public:
+    DenseHog(const cv::Mat& gray_img, const std::vector<cv::Size>& window_sizes, int cell_stride);
+
+    const HogLevel& nearestLevel(cv::Size roi_size) const;
+
+    cv::Point cellPosition(const HogLevel& level, cv::Point point) const;
+
+    void descriptor(const cv::Rect& roi, float* features) const;
+
+    cv::Mat descriptors(const std::vector<cv::Rect>& rois) const;
+
+    const std::vector<HogLevel>& levels() const { return hog_levels; }
+
+    int cellStride() const { return cell_stride; }
+
+private:
+    int cell_stride;
+    std::vector<HogLevel> hog_levels;
+};
@@ -0,0 +1,339 @@
+#include "detection.h"
+
+#include "dense_hog.h"
+#include "hog_features_extraction.h"
+#include "sliding_window.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+
+
+/**
+ * @brief Returns the process-wide detection options, set from the command line.
+ */
+DetectionOptions& detectionOptions()
+{
+    static DetectionOptions options;
+    return options;
+}
+
+/**
+ * @brief Converts a detector engine name to the corresponding `DetectorEngine`.
+ *
+ * @param[in] engine The engine name: "matching" or "sliding-window".
+ * @return The corresponding `DetectorEngine`.
+ *
+ * @throws std::invalid_argument If the engine name is unknown.
+ */
+DetectorEngine parseDetectorEngine(const std::string& engine)
+{
+    if (engine == "matching")
+        return DetectorEngine::TemplateMatching;
+    if (engine == "sliding-window")
+        return DetectorEngine::SlidingWindow;
+
+    throw std::invalid_argument("Unknown detector engine: " + engine);
+}
+
+/**
+ * @brief Returns the sizes of the ROIs the SVM is trained on: the average sizes of the k-means clusters by size.
+ *
+ * @see calculateAvgDims
+ */
+std::vector<cv::Size> svmRoiSizes()
+{
+    std::vector<std::string> kmeans_by_size_clusters;
+    listDirectories(std::filesystem::path(SRC_DIR_PATH) / "kmeans_by_size", kmeans_by_size_clusters);
+
+    std::vector<cv::Size> roi_sizes;
+    roi_sizes.reserve(kmeans_by_size_clusters.size());
+    for (const auto& cluster : kmeans_by_size_clusters)
+        roi_sizes.push_back(calculateAvgDims(std::filesystem::path(cluster)));
+    return roi_sizes;
+}
+
+/**
+ * @brief Computes the Intersection over Union (IoU) of two boxes.
+ *
+ * @param[in] first_box The first box.
+ * @param[in] second_box The second box.
+ * @return The area of the intersection divided by the area of the union, in [0, 1].
+ */
+double intersectionOverUnion(const cv::Rect& first_box, const cv::Rect& second_box)
+{
+    const double intersection_area = (first_box & second_box).area();
+    const double union_area = first_box.area() + second_box.area() - intersection_area;
+    return union_area > 0 ? intersection_area / union_area : 0.0;
+}
+
+/**
+ * @brief Suppresses the detections overlapping a stronger one.
+ *
+ * The detections are visited by descending score, and each one is kept unless its IoU with an already kept
+ * detection exceeds the threshold.
+ *
+ * @param[in] detections The detections.
+ * @param[in] iou_threshold The IoU from which the weaker of two detections is suppressed, in [0, 1].
+ * @return The kept detections, sorted by descending score.
+ *
+ * @see intersectionOverUnion
+ */
+std::vector<Detection> nonMaximumSuppression(std::vector<Detection> detections, double iou_threshold)
+{
+    std::sort(detections.begin(), detections.end(), [](const Detection& a, const Detection& b) {
+        return a.score > b.score;
+        });
+
+    std::vector<Detection> kept_detections;
+    for (const auto& detection : detections)
+    {
+        const bool suppressed = std::any_of(kept_detections.begin(), kept_detections.end(), [&](const Detection& kept_detection) {
+            return intersectionOverUnion(detection.box, kept_detection.box) > iou_threshold;
+            });
+        if (!suppressed)
+            kept_detections.push_back(detection);
+    }
+    return kept_detections;
+}
+
+/**
+ * @brief Detects the airplanes of an image with template matching followed by a linear SVM on HOG features.
+ *
+ * With the sliding-window engine, the template matching is skipped and `slidingWindowDetection` scans the
+ * whole image instead.
+ *
+ * Every template match proposes a box of each of the ROI sizes used to extract the SVM training data (see
+ * `generateSvmTrainingData`), centered on the match. The HOG descriptors of the boxes are computed by the
+ * selected engine: per ROI, in one parallel batch (see `computeHogDescriptors`), or assembled from the dense cells of the image
+ * (see `DenseHog`). Each match keeps its best box, and the boxes above the score threshold go through non-maximum
+ * suppression.
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[in] svm The linear SVM trained on the HOG features.
+ * @param[in] roi_sizes The sizes of the boxes proposed around every match.
+ * @param[in] matching_options The template matching options.
+ * @param[in] options The detection options (engine, score threshold, NMS overlap and HOG engine).
+ * @return The detections, sorted by descending score.
+ *
+ * @see findTemplateMatches
+ * @see computeHogDescriptors
+ * @see DenseHog
+ * @see svmScores
+ * @see nonMaximumSuppression
+ * @see slidingWindowDetection
+ */
+std::vector<Detection> detectAircraft(const cv::Mat& gray_img, const LinearSvm& svm, const std::vector<cv::Size>& roi_sizes, const TemplateMatchingOptions& matching_options, const DetectionOptions& options)
+{
+    if (options.engine == DetectorEngine::SlidingWindow)
+        return slidingWindowDetection(gray_img, svm, roi_sizes, options);
+
+    const std::vector<TemplateMatch> matches = findTemplateMatches(gray_img, matching_options);
+
+    // Candidate boxes, each with the index of the match it comes from
+    std::vector<cv::Rect> candidate_boxes;
+    std::vector<size_t> candidate_matches;
+    for (size_t i = 0; i < matches.size(); i++)
+    {
+        for (const cv::Rect& box : generateRoisFromPoints({ matches[i].center }, roi_sizes, gray_img.size()))
+        {
+            candidate_boxes.push_back(box);
+            candidate_matches.push_back(i);
+        }
+    }
+
+    std::vector<float> candidate_scores;
+    if (!candidate_boxes.empty())
+    {
+        if (options.hog_engine == HogEngine::Dense)
+        {
+            candidate_scores = svmScores(svm, DenseHog(gray_img, roi_sizes, options.hog_cell_stride).descriptors(candidate_boxes));
+        }
+        else
+        {
+            cv::Mat candidate_features;
+            computeHogDescriptors(candidate_boxes, gray_img, candidate_features);
+            candidate_scores = svmScores(svm, candidate_features);
+        }
+    }
+
+    // Best box of every match
+    std::vector<Detection> detections(matches.size());
+    std::vector<bool> has_box(matches.size(), false);
+    for (size_t i = 0; i < candidate_boxes.size(); i++)
+    {
+        Detection& detection = detections[candidate_matches[i]];
+        if (!has_box[candidate_matches[i]] || candidate_scores[i] > detection.score)
+        {
+            const TemplateMatch& match = matches[candidate_matches[i]];
+            detection = { candidate_boxes[i], candidate_scores[i], match.template_index, match.degree_angle };
+            has_box[candidate_matches[i]] = true;
+        }
+    }
+
+    std::vector<Detection> scored_detections;
+    for (size_t i = 0; i < detections.size(); i++)
+    {
+        if (has_box[i] && detections[i].score >= options.score_threshold)
+            scored_detections.push_back(detections[i]);
+    }
+    return nonMaximumSuppression(std::move(scored_detections), options.nms_iou);
+}
+
+/**
+ * @brief Writes detections to a text file, in the YOLO label format followed by the score.
+ *
+ * Each line is "<class_id> <center_x> <center_y> <width> <height> <score>", with coordinates normalized by the
+ * image size as in the YOLO labels of the dataset (see `processYoloLabels`), and class 0.
+ *
+ * @param[in] detections The detections.
+ * @param[in] image_size The size of the image the detections belong to.
+ * @param[in] path The path of the output file.
+ *
+ * @see openFile
+ */
+void writeDetections(const std::vector<Detection>& detections, const cv::Size& image_size, const std::filesystem::path& path)
+{
+    auto file = openFile(path.string());
+    file << std::fixed << std::setprecision(6);
+    for (const auto& detection : detections)
+    {
+        const cv::Rect& box = detection.box;
+        file << 0 << " "
+            << (box.x + box.width / 2.0) / image_size.width << " "
+            << (box.y + box.height / 2.0) / image_size.height << " "
+            << static_cast<double>(box.width) / image_size.width << " "
+            << static_cast<double>(box.height) / image_size.height << " "
+            << detection.score << "\n";
+    }
+}
+
+/**
+ * @brief Runs the detector on the images given on the command line and writes their detections.
+ *
+ * The linear SVM is loaded once, and the detections of every image are written to
+ * `SRC_DIR_PATH/detections/<image name>.txt` (see `writeDetections`).
+ *
+ * @throws std::invalid_argument If no input is given.
+ * @throws std::runtime_error If the SVM model cannot be loaded or the input has no images.
+ *
+ * @see detectAircraft
+ * @see loadLinearSvm
+ * @see svmRoiSizes
+ */
+void runDetector()
+{
+    const DetectionOptions& options = detectionOptions();
+    if (options.input_path.empty())
+        throw std::invalid_argument("No image given to the detector (see --detect-input).");
+
+    std::vector<std::string> img_paths;
+    if (std::filesystem::is_directory(options.input_path))
+    {
+        // globFiles replaces its output, so the two patterns are globbed separately
+        std::vector<std::string> png_paths;
+        globFiles(options.input_path, "/*.jpg", img_paths);
+        globFiles(options.input_path, "/*.png", png_paths);
+        img_paths.insert(img_paths.end(), png_paths.begin(), png_paths.end());
+    }
+    else
+    {
+        img_paths.push_back(options.input_path);
+    }
+    if (img_paths.empty())
+        throw std::runtime_error("No image found in " + options.input_path);
+
+    const LinearSvm svm = loadLinearSvm(options.model_path);
+    std::cout << "Linear SVM with " << svm.weights.size() << " weights, " << dotProductKernelName() << " dot product\n";
+
+    // The boxes proposed around the matches have the sizes of the SVM training ROIs
+    const std::vector<cv::Size> roi_sizes = svmRoiSizes();
+
+    const std::filesystem::path output_dir = createDirectory(std::filesystem::path(SRC_DIR_PATH), "detections");
+    for (const auto& img_path : img_paths)
+    {
+        const cv::Mat gray_img = cv::imread(img_path, cv::IMREAD_GRAYSCALE);
+        if (gray_img.empty())
+        {
+            std::cerr << "Error: could not read image " << img_path << "\n";
+            continue;
+        }
+
+        const auto start_time = std::chrono::steady_clock::now();
+        const std::vector<Detection> detections = detectAircraft(gray_img, svm, roi_sizes, templateMatchingOptions(), options);
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+        const std::filesystem::path detections_path = output_dir / (std::filesystem::path(img_path).stem().string() + ".txt");
+        writeDetections(detections, gray_img.size(), detections_path);
+        std::cout << img_path << ": " << detections.size() << " detections in " << elapsed_ms << " ms\n";
+    }
+}
+
+/**
+ * @brief Compares the template matching and sliding-window detectors on the first training images.
+ *
+ * Both engines run with the same SVM, ROI sizes and detection options. A detection is a true positive if its IoU
+ * with a YOLO box not matched yet is at least 0.5 (the detections being visited by descending score). For each
+ * engine the function reports the total time, the recall and the precision over all the images.
+ *
+ * @param[in] num_images The maximum number of training images to use.
+ *
+ * @see detectAircraft
+ * @see readYoloBoxes
+ */
+void evaluateDetectors(int num_images)
+{
+    constexpr double min_iou = 0.5;
+
+    std::vector<std::string> dataset_img_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.jpg", dataset_img_paths);
+    std::vector<std::string> yolo_labels_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.txt", yolo_labels_paths);
+    const size_t evaluated_images = std::min({ dataset_img_paths.size(), yolo_labels_paths.size(), static_cast<size_t>(num_images) });
+
+    const LinearSvm svm = loadLinearSvm(detectionOptions().model_path);
+    const std::vector<cv::Size> roi_sizes = svmRoiSizes();
+
+    for (const auto& [engine_name, engine] : { std::pair{ "template matching", DetectorEngine::TemplateMatching }, std::pair{ "sliding window", DetectorEngine::SlidingWindow } })
+    {
+        DetectionOptions options = detectionOptions();
+        options.engine = engine;
+
+        size_t total_boxes = 0, total_detections = 0, true_positives = 0;
+        double total_ms = 0.0;
+        for (size_t i = 0; i < evaluated_images; i++)
+        {
+            const cv::Mat img = cv::imread(dataset_img_paths[i], cv::IMREAD_GRAYSCALE);
+            if (img.empty())
+                continue;
+            const std::vector<cv::Rect> yolo_boxes = readYoloBoxes(yolo_labels_paths[i], img);
+
+            const auto start_time = std::chrono::steady_clock::now();
+            const std::vector<Detection> detections = detectAircraft(img, svm, roi_sizes, templateMatchingOptions(), options);
+            total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+            std::vector<bool> matched_boxes(yolo_boxes.size(), false);
+            for (const auto& detection : detections)
+            {
+                for (size_t j = 0; j < yolo_boxes.size(); j++)
+                {
+                    if (!matched_boxes[j] && intersectionOverUnion(detection.box, yolo_boxes[j]) >= min_iou)
+                    {
+                        matched_boxes[j] = true;
+                        true_positives++;
+                        break;
+                    }
+                }
+            }
+            total_boxes += yolo_boxes.size();
+            total_detections += detections.size();
+        }
+
+        std::cout << std::fixed << std::setprecision(2) << engine_name << ": " << total_ms << " ms, "
+            << true_positives << "/" << total_boxes << " boxes found (recall " << 100.0 * true_positives / std::max<size_t>(total_boxes, 1) << "%), "
+            << total_detections << " detections (precision " << 100.0 * true_positives / std::max<size_t>(total_detections, 1) << "%)\n";
+    }
+}
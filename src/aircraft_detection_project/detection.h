@@ -0,0 +1,54 @@
+#pragma once
+
+#include "hog_features_extraction.h"
+#include "linear_svm.h"
+#include "template_matching.h"
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+enum class DetectorEngine
+{
+    TemplateMatching, // SVM on boxes around the template matches
+    SlidingWindow     // SVM on every window of the dense HOG cells, at several scales and rotations (see sliding_window.h)
+};
+
+struct DetectionOptions
+{
+    DetectorEngine engine = DetectorEngine::TemplateMatching;
+    std::string input_path;                     // image, or directory of images, to run the detector on
+    std::filesystem::path model_path = linearSvmPath();
+    float score_threshold = 0.0f;               // minimum SVM decision value of a detection
+    double nms_iou = 0.3;                       // overlap from which the weaker of two detections is suppressed
+    HogEngine hog_engine = HogEngine::PerRoi;
+    int hog_cell_stride = 4;                    // distance between two cells of the dense HOG engine
+    int window_angle_step = 30;                 // rotations scanned by the sliding-window engine, 0 scans the upright image only
+};
+
+struct Detection
+{
+    cv::Rect box;
+    float score = 0.0f;     // SVM decision value
+    int template_index = 0; // template of the match the detection comes from, -1 for the sliding-window engine
+    int degree_angle = 0;
+};
+
+DetectionOptions& detectionOptions();
+
+DetectorEngine parseDetectorEngine(const std::string& engine);
+
+std::vector<cv::Size> svmRoiSizes();
+
+double intersectionOverUnion(const cv::Rect& first_box, const cv::Rect& second_box);
+
+std::vector<Detection> nonMaximumSuppression(std::vector<Detection> detections, double iou_threshold);
+
+std::vector<Detection> detectAircraft(const cv::Mat& gray_img, const LinearSvm& svm, const std::vector<cv::Size>& roi_sizes, const TemplateMatchingOptions& matching_options, const DetectionOptions& options);
+
+void writeDetections(const std::vector<Detection>& detections, const cv::Size& image_size, const std::filesystem::path& path);
+
+void runDetector();
+
+void evaluateDetectors(int num_images);
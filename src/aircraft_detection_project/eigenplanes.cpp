@@ -1,5 +1,7 @@
 #include "eigenplanes.h"
+#include "fft_correlation.h"
 #include "utils.h"
+#include <opencv2/opencv.hpp>
 
 
 
@@ -35,15 +37,17 @@ cv::Mat createDataMatrix(const std::vector<cv::Mat>& images)
  * It then performs Principal Component Analysis (PCA) on the centered data matrix, projects each
  * image onto the PCA space, and computes the average projection. Finally, it reshapes the average
  * projection back into the original image dimensions and normalizes the result.
+ * The mean plane and the principal components are returned as well, so they can be persisted.
  *
  * @param[in] vec A vector of images (each represented as a `cv::Mat`) to be processed.
  * @param[in] img_dims The dimensions of the input images.
+ * @param[out] basis The mean plane and the principal components of the images.
  * @return A `cv::Mat` representing the average plane computed from the input images.
  *
  * @see cv::Mat
  * @see cv::PCA
  */
-cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims)
+cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims, EigenBasis& basis)
 {
     // Convert all images to CV_64F and create the data matrix from the vector of images
     std::vector<cv::Mat> vec64f;
@@ -63,6 +67,11 @@ cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims)
     // Perform PCA on the centered data matrix
     cv::PCA pca(data_centered, cv::Mat(), cv::PCA::DATA_AS_ROW, 0.95);
 
+    basis.mean_plane = mean_plane.clone();
+    basis.eigenvectors = pca.eigenvectors.clone();
+    basis.eigenvalues = pca.eigenvalues.clone();
+    basis.plane_size = img_dims;
+
     // Project each image onto the PCA space and compute the average projection
     cv::Mat avg_projection = cv::Mat::zeros(1, pca.eigenvectors.rows, CV_64F);
     for (size_t i = 0; i < vec.size(); i++)
@@ -89,3 +98,138 @@ cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims)
 
     return avg_plane;
 }
+
+
+/**
+ * @brief Saves the principal components of a cluster to a file.
+ *
+ * @param[in] basis The mean plane and the principal components of the cluster.
+ * @param[in] file_path The path of the file (`.yml`, `.xml` or `.json`, as supported by `cv::FileStorage`).
+ *
+ * @throws std::runtime_error If the file cannot be opened for writing.
+ *
+ * @see cv::FileStorage
+ */
+void saveEigenBasis(const EigenBasis& basis, const std::filesystem::path& file_path)
+{
+    cv::FileStorage file(file_path.string(), cv::FileStorage::WRITE);
+    if (!file.isOpened())
+        throw std::runtime_error("Could not open file: " + file_path.string());
+
+    file << "plane_size" << basis.plane_size;
+    file << "mean_plane" << basis.mean_plane;
+    file << "eigenvectors" << basis.eigenvectors;
+    file << "eigenvalues" << basis.eigenvalues;
+}
+
+/**
+ * @brief Decomposes a set of templates on shared orthonormal components.
+ *
+ * Every template is prepared for the normalized cross-correlation (zero mean, see `prepareTemplate`), scaled
+ * to unit norm and centered in a frame as large as the largest template. The data matrix of the flattened
+ * frames is decomposed by SVD, D = U S V^T, and the rows of V^T with a non-zero singular value are kept as
+ * components, by decreasing singular value. The coordinates of every template in the components are the rows
+ * of U S.
+ *
+ * The correlation is linear in the template, so the raw correlation of the scene with any template is the same
+ * linear combination of the correlations with the components: the few leading components kept by
+ * `truncateTemplateBasis` replace one correlation per template.
+ *
+ * @param[in] templates The grayscale templates, possibly of different sizes.
+ * @return A `TemplateBasis` holding all the components, the coordinates of the templates and their positions
+ *         in the frame. The templates are reconstructed exactly.
+ *
+ * @note The decomposition only depends on the upright templates, so it is computed once with the template bank.
+ *
+ * @see prepareTemplate
+ * @see truncateTemplateBasis
+ * @see cv::SVD
+ */
+TemplateBasis decomposeTemplateSet(const std::vector<cv::Mat>& templates)
+{
+    TemplateBasis basis;
+    for (const auto& templ : templates)
+    {
+        basis.frame_size.width = std::max(basis.frame_size.width, templ.cols);
+        basis.frame_size.height = std::max(basis.frame_size.height, templ.rows);
+    }
+
+    cv::Mat data(static_cast<int>(templates.size()), basis.frame_size.area(), CV_32F, cv::Scalar(0));
+    for (size_t i = 0; i < templates.size(); i++)
+    {
+        const PreparedTemplate prepared_template = prepareTemplate(templates[i]);
+        const cv::Rect template_rect(
+            (basis.frame_size.width - templates[i].cols) / 2,
+            (basis.frame_size.height - templates[i].rows) / 2,
+            templates[i].cols,
+            templates[i].rows);
+        basis.template_rects.push_back(template_rect);
+
+        // The row is continuous, so the frame is a view of it and the template is written in place
+        cv::Mat frame = data.row(static_cast<int>(i)).reshape(1, basis.frame_size.height);
+        cv::Mat frame_template = frame(template_rect);
+        prepared_template.kernel.convertTo(frame_template, CV_32F, 1.0 / std::max(prepared_template.norm, 1e-6));
+    }
+
+    if (templates.empty())
+        return basis;
+
+    cv::Mat singular_values, u, vt;
+    cv::SVD::compute(data, singular_values, u, vt);
+    singular_values.convertTo(singular_values, CV_64F);
+    u.convertTo(u, CV_64F);
+
+    int rank = 0;
+    while (rank < singular_values.rows && singular_values.at<double>(rank) > 0.0)
+        rank++;
+
+    for (int k = 0; k < rank; k++)
+        basis.components.push_back(vt.row(k).reshape(1, basis.frame_size.height).clone());
+
+    basis.singular_values = singular_values.rowRange(0, rank).clone();
+    basis.coefficients = u.colRange(0, rank) * cv::Mat::diag(basis.singular_values);
+    return basis;
+}
+
+/**
+ * @brief Keeps the leading components of a template basis that hold a fraction of the energy of the templates.
+ *
+ * The number k of components kept is the smallest rank whose singular values hold `energy_threshold` of the
+ * total energy (at least one component). The components are shared with the full basis, not copied.
+ *
+ * @param[in] basis The full basis, as returned by `decomposeTemplateSet`.
+ * @param[in] energy_threshold The fraction of the energy of the templates to keep, in (0, 1].
+ * @return The basis of the first k components, with the coordinates of the templates on them and the worst
+ *         relative error of the reconstructed templates.
+ *
+ * @see decomposeTemplateSet
+ */
+TemplateBasis truncateTemplateBasis(const TemplateBasis& basis, double energy_threshold)
+{
+    TemplateBasis truncated_basis;
+    truncated_basis.frame_size = basis.frame_size;
+    truncated_basis.template_rects = basis.template_rects;
+    if (basis.components.empty())
+        return truncated_basis;
+
+    const double total_energy = cv::sum(basis.singular_values.mul(basis.singular_values))[0];
+    double kept_energy = 0.0;
+    int rank = 0;
+    while (rank < basis.singular_values.rows && (rank == 0 || kept_energy < energy_threshold * total_energy))
+    {
+        kept_energy += basis.singular_values.at<double>(rank) * basis.singular_values.at<double>(rank);
+        rank++;
+    }
+
+    truncated_basis.components.assign(basis.components.begin(), basis.components.begin() + rank);
+    truncated_basis.singular_values = basis.singular_values.rowRange(0, rank);
+    truncated_basis.coefficients = basis.coefficients.colRange(0, rank);
+
+    // The templates have unit norm, so the error of each one is the norm of its discarded coordinates
+    for (int i = 0; i < truncated_basis.coefficients.rows; i++)
+    {
+        const double kept_norm = cv::norm(truncated_basis.coefficients.row(i));
+        truncated_basis.reconstruction_error = std::max(truncated_basis.reconstruction_error, std::sqrt(std::max(1.0 - kept_norm * kept_norm, 0.0)));
+    }
+    return truncated_basis;
+}
@@ -1,6 +1,32 @@
 #pragma once
 
 #include <opencv2/core/mat.hpp>
+#include <filesystem>
+#include <vector>
 
 
-cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims);
\ No newline at end of file
+struct EigenBasis
+{
+    cv::Mat mean_plane;   // CV_64F row vector, mean of the flattened cluster images
+    cv::Mat eigenvectors; // CV_64F, one principal component per row
+    cv::Mat eigenvalues;  // CV_64F column vector, variance along every principal component
+    cv::Size plane_size;  // size of the images of the cluster
+};
+
+struct TemplateBasis
+{
+    cv::Size frame_size;                // common frame holding every template, centered
+    std::vector<cv::Mat> components;    // CV_32F orthonormal components, of the frame size
+    cv::Mat coefficients;               // CV_64F, one row per template: its coordinates in the components
+    cv::Mat singular_values;            // CV_64F column vector, decreasing: the norm of the coordinates on every component
+    std::vector<cv::Rect> template_rects; // position of every template in the frame
+    double reconstruction_error = 0.0;  // worst relative L2 error of the reconstructed templates
+};
+
+cv::Mat eigenPlanes(const std::vector<cv::Mat>& vec, cv::Size img_dims, EigenBasis& basis);
+
+void saveEigenBasis(const EigenBasis& basis, const std::filesystem::path& file_path);
+
+TemplateBasis decomposeTemplateSet(const std::vector<cv::Mat>& templates);
+
+TemplateBasis truncateTemplateBasis(const TemplateBasis& basis, double energy_threshold);
@@ -0,0 +1,303 @@
+#include "feature_store.h"
+
+#include "hog_features_extraction.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+
+namespace
+{
+    constexpr char store_magic[8] = { 'H', 'O', 'G', 'F', 'E', 'A', 'T', '\0' };
+    constexpr uint32_t store_version = 1;
+
+    // Rows and labels are aligned to cache lines in the file, and therefore in the mapping, as in the template bank
+    constexpr size_t data_alignment = 64;
+
+    // Quantization of the Uint8 features: the normalized HOG features lie in [0, 1]
+    constexpr float uint8_scale = 1.0f / 255.0f;
+
+    struct StoreHeader
+    {
+        char magic[8];
+        uint32_t version;
+        int32_t type;           // FeatureType
+        uint64_t rows;
+        int32_t dims;
+        int32_t row_step;       // bytes between two rows: the row size rounded up to the data alignment
+        float scale;            // feature = scale * stored value + offset
+        float offset;
+        uint64_t data_offset;   // of the first row
+        uint64_t labels_offset; // of the int32 labels, one per row, after the rows
+    };
+
+    size_t alignedSize(size_t size)
+    {
+        return (size + data_alignment - 1) / data_alignment * data_alignment;
+    }
+
+    int cvType(FeatureType type)
+    {
+        switch (type)
+        {
+        case FeatureType::Float16:
+            return CV_16F;
+        case FeatureType::Uint8:
+            return CV_8U;
+        default:
+            return CV_32F;
+        }
+    }
+
+    void writePadding(std::ofstream& file, size_t bytes)
+    {
+        const char zeros[data_alignment] = {};
+        while (bytes > 0)
+        {
+            const size_t chunk = std::min(bytes, data_alignment);
+            file.write(zeros, chunk);
+            bytes -= chunk;
+        }
+    }
+}
+
+
+
+/**
+ * @brief Parses the name of a feature type.
+ *
+ * @param[in] type The name of the type: "float32", "float16" or "uint8".
+ * @return The corresponding `FeatureType`.
+ *
+ * @throws std::invalid_argument If the name is not a known type.
+ */
+FeatureType parseFeatureType(const std::string& type)
+{
+    if (type == "float32")
+        return FeatureType::Float32;
+    if (type == "float16")
+        return FeatureType::Float16;
+    if (type == "uint8")
+        return FeatureType::Uint8;
+
+    throw std::invalid_argument("Unknown feature type: " + type);
+}
+
+/**
+ * @brief Returns the path of the HOG features extracted for the SVM training.
+ */
+std::filesystem::path hogFeatureStorePath()
+{
+    return std::filesystem::path(SRC_DIR_PATH) / "svm_training_input" / "hog_features.bin";
+}
+
+/**
+ * @brief Creates a feature store file, to which rows of features are appended.
+ *
+ * The rows are written as they are appended: only their labels, 4 bytes per row, are kept in memory until the
+ * store is closed. The header is only written by `close`: until then, the file is not a valid store, and a store
+ * whose writing was interrupted is rejected by `FeatureStore::load` instead of being read as a truncated dataset.
+ *
+ * @param[in] path The path of the store file.
+ * @param[in] dims The number of features of every row.
+ * @param[in] type The type the features are stored as.
+ *
+ * @throws std::runtime_error If the file cannot be opened.
+ *
+ * @see close
+ */
+FeatureStoreWriter::FeatureStoreWriter(const std::string& path, int dims, FeatureType type)
+    : path(path), file(path, std::ios::binary), feature_type(type), dims(dims),
+    row_step(alignedSize(static_cast<size_t>(dims) * CV_ELEM_SIZE(cvType(type))))
+{
+    if (!file)
+        throw std::runtime_error("Could not open file " + path);
+
+    // Placeholder for the header, whose magic stays zero until the store is closed
+    writePadding(file, alignedSize(sizeof(StoreHeader)));
+}
+
+/**
+ * @brief Appends rows of features, all with the same label.
+ *
+ * The features are converted to the type of the store: Float16 rounds them to half precision, Uint8
+ * quantizes them to 256 levels over [0, 1], saturating the values out of that range.
+ *
+ * @param[in] features A `CV_32F` matrix with `dims` columns, one row per sample. An empty matrix is ignored.
+ * @param[in] label The label of the rows (e.g. 1 for the true positives, -1 for the false positives).
+ *
+ * @throws std::invalid_argument If the features are not `CV_32F` rows of `dims` features.
+ * @throws std::runtime_error If the store is closed or the rows cannot be written.
+ */
+void FeatureStoreWriter::append(const cv::Mat& features, int label)
+{
+    if (features.empty())
+        return;
+    if (features.type() != CV_32F || features.cols != dims)
+        throw std::invalid_argument("The features appended to " + path + " must be CV_32F rows of " + std::to_string(dims) + " features.");
+    if (!file.is_open())
+        throw std::runtime_error("The feature store " + path + " is already closed.");
+
+    if (feature_type == FeatureType::Float32)
+        stored_rows = features;
+    else
+        features.convertTo(stored_rows, cvType(feature_type), feature_type == FeatureType::Uint8 ? 1.0 / uint8_scale : 1.0);
+
+    const size_t row_size = static_cast<size_t>(dims) * stored_rows.elemSize();
+    for (int i = 0; i < stored_rows.rows; i++)
+    {
+        file.write(reinterpret_cast<const char*>(stored_rows.ptr(i)), row_size);
+        writePadding(file, row_step - row_size);
+    }
+    labels.insert(labels.end(), stored_rows.rows, label);
+
+    if (!file)
+        throw std::runtime_error("Could not write the feature store " + path);
+}
+
+/**
+ * @brief Writes the labels and the header of the store, and closes the file.
+ *
+ * @throws std::runtime_error If the store is already closed or cannot be written.
+ */
+void FeatureStoreWriter::close()
+{
+    if (!file.is_open())
+        throw std::runtime_error("The feature store " + path + " is already closed.");
+
+    StoreHeader header{};
+    std::memcpy(header.magic, store_magic, sizeof(store_magic));
+    header.version = store_version;
+    header.type = static_cast<int32_t>(feature_type);
+    header.rows = labels.size();
+    header.dims = dims;
+    header.row_step = static_cast<int32_t>(row_step);
+    header.scale = feature_type == FeatureType::Uint8 ? uint8_scale : 1.0f;
+    header.offset = 0.0f;
+    header.data_offset = alignedSize(sizeof(StoreHeader));
+    header.labels_offset = header.data_offset + header.rows * row_step;
+
+    file.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(int32_t));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    if (!file)
+        throw std::runtime_error("Could not write the feature store " + path);
+}
+
+/**
+ * @brief Loads a feature store written by `FeatureStoreWriter`.
+ *
+ * The file is memory-mapped and the matrices of the rows and of the labels point into the mapping: loading
+ * does no parsing and no copy, and the pages are only read from disk when first accessed.
+ *
+ * @param[in] path The path of the store file.
+ * @return The loaded store.
+ *
+ * @throws std::runtime_error If the file cannot be mapped, is not a complete feature store of the current
+ *                            version, or is truncated.
+ *
+ * @see MappedFile
+ */
+FeatureStore FeatureStore::load(const std::string& path)
+{
+    FeatureStore store;
+    store.mapped_file = std::make_shared<MappedFile>(path);
+    MappedFile& file = *store.mapped_file;
+
+    StoreHeader header{};
+    if (file.size() >= sizeof(header))
+        std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, store_magic, sizeof(store_magic)) != 0 || header.version != store_version)
+        throw std::runtime_error("Not a complete feature store of version " + std::to_string(store_version) + ": " + path);
+
+    if (header.type < static_cast<int32_t>(FeatureType::Float32) || header.type > static_cast<int32_t>(FeatureType::Uint8)
+        || header.dims < 0 || header.rows > static_cast<uint64_t>(std::numeric_limits<int>::max())
+        || header.row_step < static_cast<int64_t>(header.dims) * CV_ELEM_SIZE(cvType(static_cast<FeatureType>(header.type)))
+        || header.labels_offset < header.data_offset + header.rows * header.row_step
+        || header.labels_offset + header.rows * sizeof(int32_t) > file.size())
+        throw std::runtime_error("Corrupted feature store: " + path);
+
+    store.feature_type = static_cast<FeatureType>(header.type);
+    store.scale = header.scale;
+    store.offset = header.offset;
+    store.stored_rows = cv::Mat(static_cast<int>(header.rows), header.dims, cvType(store.feature_type), file.mutableData() + header.data_offset, header.row_step);
+    store.row_labels = cv::Mat(static_cast<int>(header.rows), 1, CV_32S, file.mutableData() + header.labels_offset);
+    return store;
+}
+
+/**
+ * @brief Returns the features as floats.
+ *
+ * @return A `CV_32F` matrix with one row per sample: the mapped rows themselves for a Float32 store, or their
+ *         decoded copy otherwise.
+ */
+cv::Mat FeatureStore::features() const
+{
+    if (feature_type == FeatureType::Float32)
+        return stored_rows;
+
+    cv::Mat decoded_rows;
+    stored_rows.convertTo(decoded_rows, CV_32F, scale, offset);
+    return decoded_rows;
+}
+
+/**
+ * @brief Converts the CSV files of HOG features read by ucasML to a feature store.
+ *
+ * @param[in] positives_csv The CSV file of the positive samples (label 1), one row of features per line.
+ * @param[in] negatives_csv The CSV file of the negative samples (label -1).
+ * @param[in] store_path The path of the store to write.
+ * @param[in] type The type the features are stored as.
+ *
+ * @throws std::runtime_error If a file cannot be read or written, or the two files do not have the same
+ *                            number of features.
+ *
+ * @see readHogFeaturesFromCsv
+ */
+void convertCsvToFeatureStore(const std::string& positives_csv, const std::string& negatives_csv, const std::string& store_path, FeatureType type)
+{
+    const cv::Mat positives = readHogFeaturesFromCsv(positives_csv);
+    const cv::Mat negatives = readHogFeaturesFromCsv(negatives_csv);
+    if (!positives.empty() && !negatives.empty() && positives.cols != negatives.cols)
+        throw std::runtime_error("The positive and negative samples do not have the same number of features.");
+
+    FeatureStoreWriter writer(store_path, positives.empty() ? negatives.cols : positives.cols, type);
+    writer.append(positives, 1);
+    writer.append(negatives, -1);
+    writer.close();
+}
+
+/**
+ * @brief Converts a feature store to the CSV files of HOG features read by ucasML.
+ *
+ * The rows with a positive label are written to the positives file, the others to the negatives file, in the
+ * format of `writeHogFeaturesToCsv`.
+ *
+ * @param[in] store_path The path of the store.
+ * @param[in] positives_csv The CSV file of the positive samples.
+ * @param[in] negatives_csv The CSV file of the negative samples.
+ *
+ * @throws std::runtime_error If a file cannot be read or written.
+ *
+ * @see writeHogFeaturesToCsv
+ */
+void convertFeatureStoreToCsv(const std::string& store_path, const std::string& positives_csv, const std::string& negatives_csv)
+{
+    const FeatureStore store = FeatureStore::load(store_path);
+    const cv::Mat features = store.features();
+
+    cv::Mat positives, negatives;
+    for (int i = 0; i < store.rows(); i++)
+    {
+        if (store.labels().at<int>(i) > 0)
+            positives.push_back(features.row(i));
+        else
+            negatives.push_back(features.row(i));
+    }
+
+    writeHogFeaturesToCsv(positives, positives_csv);
+    writeHogFeaturesToCsv(negatives, negatives_csv);
+}
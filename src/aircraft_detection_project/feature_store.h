@@ -0,0 +1,81 @@
+#pragma once
+
+#include "mapped_file.h"
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+enum class FeatureType
+{
+    Float32, // the features as computed
+    Float16, // half the size, about 3 significant digits
+    Uint8    // a quarter of the size, the [0, 1] range of the normalized HOG features quantized to 256 levels
+};
+
+FeatureType parseFeatureType(const std::string& type);
+
+class FeatureStoreWriter
+{
+public:
+    FeatureStoreWriter(const std::string& path, int dims, FeatureType type = FeatureType::Float32);
+
+    FeatureStoreWriter(const FeatureStoreWriter&) = delete;
+
+    FeatureStoreWriter& operator=(const FeatureStoreWriter&) = delete;
+
+    void append(const cv::Mat& features, int label);
+
+    void close();
+
+    size_t rows() const { return labels.size(); }
+
+private:
+    std::string path;
+    std::ofstream file;
+    FeatureType feature_type;
+    int dims;
+    size_t row_step;            // bytes between two rows in the file
+    std::vector<int32_t> labels;
+    cv::Mat stored_rows;        // conversion buffer, reused between appends
+};
+
+class FeatureStore
+{
+public:
+    FeatureStore() = default;
+
+    static FeatureStore load(const std::string& path);
+
+    cv::Mat features() const;
+
+    const cv::Mat& storedRows() const { return stored_rows; }
+
+    const cv::Mat& labels() const { return row_labels; }
+
+    FeatureType type() const { return feature_type; }
+
+    int rows() const { return stored_rows.rows; }
+
+    int dims() const { return stored_rows.cols; }
+
+private:
+    FeatureType feature_type = FeatureType::Float32;
+    float scale = 1.0f;
+    float offset = 0.0f;
+    cv::Mat stored_rows;
+    cv::Mat row_labels;
+
+    // Keeps the mapped file alive while the matrices point into it
+    std::shared_ptr<MappedFile> mapped_file;
+};
+
+std::filesystem::path hogFeatureStorePath();
+
+void convertCsvToFeatureStore(const std::string& positives_csv, const std::string& negatives_csv, const std::string& store_path, FeatureType type);
+
+void convertFeatureStoreToCsv(const std::string& store_path, const std::string& positives_csv, const std::string& negatives_csv);
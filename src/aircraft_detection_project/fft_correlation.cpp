@@ -0,0 +1,479 @@
+#include "fft_correlation.h"
+
+#include "integer_correlation.h"
+
+
+namespace
+{
+    // Windows whose variance is below a quarter of a gray level squared are flat: their normalized
+    // correlation is meaningless, and with a mask their sums carry the rounding noise of the transforms
+    constexpr double min_energy = 1e-6;
+    constexpr double min_masked_variance = 0.25;
+
+    // Square roots of the window energies, 0 for the flat windows (energy below `flat_energy`)
+    cv::Mat energyNorms(cv::Mat energy, double flat_energy)
+    {
+        energy.setTo(0.0, energy < flat_energy);
+
+        cv::Mat window_norms;
+        cv::sqrt(energy, window_norms);
+        window_norms.convertTo(window_norms, CV_32F);
+        return window_norms;
+    }
+}
+
+
+
+/**
+ * @brief Prepares a template for the FFT-based normalized cross-correlation.
+ *
+ * This function converts the template to `CV_32F`, subtracts its mean (computed over the mask only)
+ * and zeroes the pixels outside the mask. The resulting kernel is zero-mean, so correlating it with the
+ * scene directly gives the numerator of the normalized cross-correlation, without subtracting the local
+ * mean of the scene. The L2 norm of the kernel is stored for the normalization, and the mask for the local
+ * statistics of the scene (see `windowMask`).
+ *
+ * @param[in] templ The template image.
+ * @param[in] mask The `CV_8U` mask of the valid template pixels. An empty mask selects all the pixels.
+ * @return A `PreparedTemplate` holding the zero-mean kernel, its mask, the template mean and the kernel norm.
+ *
+ * @see cv::mean
+ * @see windowMask
+ */
+PreparedTemplate prepareTemplate(const cv::Mat& templ, const cv::Mat& mask)
+{
+    PreparedTemplate prepared_template;
+    templ.convertTo(prepared_template.kernel, CV_32F);
+
+    prepared_template.mean = cv::mean(prepared_template.kernel, mask)[0];
+    prepared_template.kernel -= prepared_template.mean;
+
+    if (!mask.empty())
+        prepared_template.kernel.setTo(0, mask == 0);
+
+    prepared_template.norm = cv::norm(prepared_template.kernel, cv::NORM_L2);
+    prepared_template.mask = windowMask(mask);
+    return prepared_template;
+}
+
+/**
+ * @brief Converts the mask of a template to the mask over which the local statistics of the scene are measured.
+ *
+ * @param[in] mask The `CV_8U` mask of the valid template pixels, or an empty matrix.
+ * @return The `CV_32F` mask, 1 on the valid pixels and 0 elsewhere, or an empty matrix if all the pixels are
+ *         valid: the statistics are then read from the integral images of the scene.
+ *
+ * @see PreparedTemplate
+ */
+cv::Mat windowMask(const cv::Mat& mask)
+{
+    if (mask.empty() || cv::countNonZero(mask) == static_cast<int>(mask.total()))
+        return cv::Mat();
+
+    cv::Mat window_mask;
+    cv::Mat(mask != 0).convertTo(window_mask, CV_32F, 1.0 / 255.0);
+    return window_mask;
+}
+
+
+/**
+ * @brief Computes the spectrum of a `CV_32F` matrix zero-padded to a DFT size.
+ *
+ * @param[in] kernel The matrix: a template kernel, a mask or a scene. It must not be larger than the DFT size.
+ * @param[in] dft_size The size of the transform, e.g. `FftCorrelator::dftSize`.
+ * @return The `CV_32F` spectrum (CCS packed format).
+ *
+ * @see cv::dft
+ */
+cv::Mat paddedSpectrum(const cv::Mat& kernel, cv::Size dft_size)
+{
+    cv::Mat padded_kernel = cv::Mat::zeros(dft_size, CV_32F);
+    cv::Mat kernel_area = padded_kernel(cv::Rect(cv::Point(0, 0), kernel.size()));
+    kernel.copyTo(kernel_area);
+
+    cv::Mat spectrum;
+    cv::dft(padded_kernel, spectrum, 0, kernel.rows);
+    return spectrum;
+}
+
+/**
+ * @brief Computes the sums of an image over all the windows of a given size, from its integral image.
+ *
+ * Each sum is read with four shifted views of the integral image, so the whole map is made of three
+ * vectorized matrix operations.
+ *
+ * @param[in] integral_img The integral image, as returned by `cv::integral`.
+ * @param[in] window_size The size of the windows.
+ * @param[in] result_size The number of window positions, (W - w + 1) x (H - h + 1) for the valid positions.
+ * @return The map of the window sums, of the depth of the integral image.
+ *
+ * @see cv::integral
+ */
+cv::Mat windowSums(const cv::Mat& integral_img, cv::Size window_size, cv::Size result_size)
+{
+    const cv::Mat top_left = integral_img(cv::Rect(cv::Point(0, 0), result_size));
+    const cv::Mat top_right = integral_img(cv::Rect(cv::Point(window_size.width, 0), result_size));
+    const cv::Mat bottom_left = integral_img(cv::Rect(cv::Point(0, window_size.height), result_size));
+    const cv::Mat bottom_right = integral_img(cv::Rect(cv::Point(window_size.width, window_size.height), result_size));
+    cv::Mat sum = bottom_right - top_right - bottom_left + top_left;
+    return sum;
+}
+
+/**
+ * @brief Computes the norm of every centered window of the scene, from its integral images.
+ *
+ * The norm of a window is the L2 norm of its pixels minus their mean: the scene side of the denominator of the
+ * normalized cross-correlation. The sum and the sum of squares of every window are read from the integral images
+ * (see `windowSums`). The norms only depend on the window size, so all the templates of a size share them.
+ *
+ * @param[in] integral_sum The `CV_64F` integral image of the scene.
+ * @param[in] integral_sqsum The `CV_64F` integral image of the squared scene.
+ * @param[in] window_size The size of the windows.
+ * @param[in] result_size The number of window positions, (W - w + 1) x (H - h + 1).
+ * @return The `CV_32F` map of the window norms, 0 for the windows with (almost) no variance.
+ *
+ * @see windowSums
+ * @see divideByWindowNorms
+ */
+cv::Mat integralWindowNorms(const cv::Mat& integral_sum, const cv::Mat& integral_sqsum, cv::Size window_size, cv::Size result_size)
+{
+    const double window_area = static_cast<double>(window_size.area());
+    const cv::Mat sum = windowSums(integral_sum, window_size, result_size);
+    return energyNorms(windowSums(integral_sqsum, window_size, result_size) - sum.mul(sum) / window_area, min_energy);
+}
+
+/**
+ * @brief Computes the norm of every centered window of the scene, under a mask.
+ *
+ * The window sums are computed by correlating the mask with the scene and its square, and therefore carry some
+ * rounding noise: windows whose variance under the mask is below a quarter of a gray level squared are treated
+ * as flat. The norms only depend on the mask, so all the templates with the same mask share them.
+ *
+ * @param[in] window_sum The correlation of the mask with the scene, minus any constant offset.
+ * @param[in] window_sqsum The correlation of the mask with the square of the same offset scene.
+ * @param[in] mask_area The number of pixels of the mask.
+ * @return The `CV_32F` map of the window norms, 0 for the flat windows.
+ *
+ * @note Offsetting the scene by a constant (e.g. its mean) leaves the norms unchanged and keeps the sums small.
+ *
+ * @see divideByWindowNorms
+ */
+cv::Mat maskedWindowNorms(const cv::Mat& window_sum, const cv::Mat& window_sqsum, double mask_area)
+{
+    cv::Mat sum, sqsum;
+    window_sum.convertTo(sum, CV_64F);
+    window_sqsum.convertTo(sqsum, CV_64F);
+    return energyNorms(sqsum - sum.mul(sum) / mask_area, min_masked_variance * mask_area);
+}
+
+/**
+ * @brief Normalizes a raw correlation map by the norms of the scene windows and of the template.
+ *
+ * @param[in] correlation The raw correlation of the zero-mean template kernel with the scene.
+ * @param[in] window_norms The norms of the centered scene windows, as returned by `integralWindowNorms` or
+ *                         `maskedWindowNorms`, of the size of the correlation map.
+ * @param[in] template_norm The L2 norm of the zero-mean template kernel.
+ * @return The `CV_32F` normalized cross-correlation map, 0 on the flat windows.
+ */
+cv::Mat divideByWindowNorms(const cv::Mat& correlation, const cv::Mat& window_norms, double template_norm)
+{
+    cv::Mat ncc;
+    cv::divide(correlation, window_norms, ncc, 1.0 / std::max(template_norm, min_energy));
+    ncc.setTo(0, window_norms == 0);
+    return ncc;
+}
+
+/**
+ * @brief Normalizes a raw correlation map with the local statistics of the scene.
+ *
+ * Windows with (almost) no variance get a score of 0.
+ *
+ * @param[in] correlation The raw correlation of the zero-mean template kernel with the scene.
+ * @param[in] integral_sum The `CV_64F` integral image of the scene.
+ * @param[in] integral_sqsum The `CV_64F` integral image of the squared scene.
+ * @param[in] template_size The size of the template window.
+ * @param[in] template_norm The L2 norm of the zero-mean template kernel.
+ * @return The `CV_32F` normalized cross-correlation map.
+ *
+ * @see integralWindowNorms
+ * @see divideByWindowNorms
+ */
+cv::Mat normalizeCorrelation(const cv::Mat& correlation, const cv::Mat& integral_sum, const cv::Mat& integral_sqsum, cv::Size template_size, double template_norm)
+{
+    return divideByWindowNorms(correlation, integralWindowNorms(integral_sum, integral_sqsum, template_size, correlation.size()), template_norm);
+}
+
+/**
+ * @brief Normalizes the raw correlation of a masked template with the statistics of the scene under the mask.
+ *
+ * The scene energy is measured over the pixels of the mask only, so the scores are the ones of
+ * `cv::matchTemplate` with `cv::TM_CCOEFF_NORMED` and the same mask. The flat windows (see `maskedWindowNorms`)
+ * get a score of 0.
+ *
+ * @param[in] correlation The raw correlation of the zero-mean masked kernel with the scene.
+ * @param[in] window_sum The correlation of the mask with the scene, minus any constant offset.
+ * @param[in] window_sqsum The correlation of the mask with the square of the same offset scene.
+ * @param[in] mask_area The number of pixels of the mask.
+ * @param[in] template_norm The L2 norm of the zero-mean template kernel.
+ * @return The `CV_32F` normalized cross-correlation map.
+ *
+ * @see maskedWindowNorms
+ * @see divideByWindowNorms
+ */
+cv::Mat normalizeMaskedCorrelation(const cv::Mat& correlation, const cv::Mat& window_sum, const cv::Mat& window_sqsum, double mask_area, double template_norm)
+{
+    return divideByWindowNorms(correlation, maskedWindowNorms(window_sum, window_sqsum, mask_area), template_norm);
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of a prepared template over a small patch.
+ *
+ * This function gives the same scores as `FftCorrelator::correlate`, but only over the given patch, so it is
+ * meant for the local searches (e.g. the refinement of a candidate), where transforming the whole scene would
+ * be wasteful. As there, the scene statistics of a masked template are measured under its mask.
+ *
+ * The maps of the local searches are small enough for the direct integer kernels to beat `cv::matchTemplate`:
+ * with `integer_correlation` set, an 8-bit patch is correlated by the integer kernels where they are faster
+ * (see `isIntegerCorrelationFaster`), with the same scores.
+ *
+ * @param[in] patch The grayscale patch of the scene in which to search the template.
+ * @param[in] prepared_template The prepared template. It must not be larger than the patch.
+ * @param[in] integer_correlation Whether to use the integer kernels, for a template prepared from an 8-bit one.
+ * @return A `CV_32F` map of size (W - w + 1) x (H - h + 1), as returned by `cv::matchTemplate`.
+ *
+ * @see prepareTemplate
+ * @see integerKernelCorrelation
+ * @see normalizeCorrelation
+ * @see normalizeMaskedCorrelation
+ * @see cv::matchTemplate
+ */
+cv::Mat correlateLocally(const cv::Mat& patch, const PreparedTemplate& prepared_template, bool integer_correlation)
+{
+    const cv::Size template_size = prepared_template.kernel.size();
+    const bool use_integers = integer_correlation && patch.type() == CV_8UC1 && isIntegerCorrelationFaster(patch.size(), template_size);
+
+    cv::Mat patch_32f;
+    patch.convertTo(patch_32f, CV_32F);
+
+    cv::Mat correlation;
+    if (!use_integers)
+        cv::matchTemplate(patch_32f, prepared_template.kernel, correlation, cv::TM_CCORR);
+
+    if (!prepared_template.mask.empty())
+    {
+        const double patch_mean = cv::mean(patch_32f)[0];
+        const double mask_area = cv::sum(prepared_template.mask)[0];
+        const cv::Mat centered_patch = patch_32f - patch_mean;
+        cv::Mat window_sum, window_sqsum;
+        cv::matchTemplate(centered_patch, prepared_template.mask, window_sum, cv::TM_CCORR);
+        cv::matchTemplate(centered_patch.mul(centered_patch), prepared_template.mask, window_sqsum, cv::TM_CCORR);
+
+        // The integer kernels need the sums of the patch itself under the mask
+        if (use_integers)
+            correlation = integerKernelCorrelation(patch, prepared_template, window_sum + patch_mean * mask_area);
+
+        return normalizeMaskedCorrelation(correlation, window_sum, window_sqsum, mask_area, prepared_template.norm);
+    }
+
+    cv::Mat integral_sum, integral_sqsum;
+    cv::integral(patch, integral_sum, integral_sqsum, CV_64F, CV_64F);
+
+    if (use_integers)
+    {
+        const cv::Size result_size(patch.cols - template_size.width + 1, patch.rows - template_size.height + 1);
+        correlation = integerKernelCorrelation(patch, prepared_template, windowSums(integral_sum, template_size, result_size));
+    }
+
+    return normalizeCorrelation(correlation, integral_sum, integral_sqsum, template_size, prepared_template.norm);
+}
+
+/**
+ * @brief Builds the correlator for a scene, computing all the scene-side work once.
+ *
+ * This constructor computes the DFT of the scene, zero-padded to an optimal DFT size, and the integral
+ * images of the scene and of its square. They are shared by all the subsequent correlations, whatever
+ * the template and its rotation, so with the template spectrum at hand (see `TemplateBank::kernelSpectrum`)
+ * each correlation only costs one spectrum multiplication and one inverse transform. The DFTs of the centered
+ * scene and of its square are computed too, for the window norms under the masks of the rotated templates.
+ *
+ * @param[in] scene The grayscale scene in which the templates are searched.
+ *
+ * @note Only the valid correlation positions (the template fully inside the scene) are ever read back,
+ *       so padding the scene to its own optimal DFT size is enough to avoid the circular wrap-around.
+ *
+ * @see cv::getOptimalDFTSize
+ * @see cv::dft
+ * @see cv::integral
+ */
+FftCorrelator::FftCorrelator(const cv::Mat& scene)
+    : scene_size(scene.size()),
+      dft_size(cv::getOptimalDFTSize(scene.cols), cv::getOptimalDFTSize(scene.rows))
+{
+    cv::Mat scene_32f;
+    scene.convertTo(scene_32f, CV_32F);
+    scene_spectrum = paddedSpectrum(scene_32f, dft_size);
+
+    const cv::Mat centered_scene = scene_32f - cv::mean(scene_32f)[0];
+    centered_spectrum = paddedSpectrum(centered_scene, dft_size);
+    squared_spectrum = paddedSpectrum(centered_scene.mul(centered_scene), dft_size);
+
+    cv::integral(scene, integral_sum, integral_sqsum, CV_64F, CV_64F);
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of a prepared template against the scene.
+ *
+ * This function computes the template spectrum and the window norms of the template, then correlates it (see
+ * the overload taking them). It suits a one-off correlation: when several templates share a window size or a
+ * mask, their window norms should be computed once, and the spectra of a bank are cached by the bank.
+ *
+ * @param[in] prepared_template The prepared template.
+ * @return A `CV_32F` map of size (W - w + 1) x (H - h + 1), as returned by `cv::matchTemplate`.
+ *
+ * @throws std::invalid_argument If the template is larger than the scene.
+ *
+ * @see prepareTemplate
+ * @see windowNorms
+ */
+cv::Mat FftCorrelator::correlate(const PreparedTemplate& prepared_template) const
+{
+    const cv::Size template_size = prepared_template.kernel.size();
+    const cv::Mat window_norms = prepared_template.mask.empty()
+        ? windowNorms(template_size)
+        : windowNorms(template_size, paddedSpectrum(prepared_template.mask, dft_size), cv::sum(prepared_template.mask)[0]);
+
+    return correlate(paddedSpectrum(prepared_template.kernel, dft_size), template_size, window_norms, prepared_template.norm);
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of a template spectrum against the scene.
+ *
+ * This function multiplies the scene spectrum by the conjugate template spectrum, transforms the product
+ * back and divides it by the window norms and the template norm, so the result matches `cv::matchTemplate`
+ * with `cv::TM_CCOEFF_NORMED` (and the template mask, if any): one spectrum multiplication and one inverse
+ * transform per template.
+ *
+ * @param[in] kernel_spectrum The spectrum of the prepared kernel, zero-padded to the DFT size of the scene.
+ * @param[in] template_size The size of the template.
+ * @param[in] window_norms The norms of the scene windows under the template, as returned by `windowNorms`.
+ * @param[in] template_norm The L2 norm of the prepared kernel.
+ * @return A `CV_32F` map of size (W - w + 1) x (H - h + 1), as returned by `cv::matchTemplate`.
+ *
+ * @throws std::invalid_argument If the template is larger than the scene.
+ *
+ * @see paddedSpectrum
+ * @see inverseCorrelation
+ * @see divideByWindowNorms
+ */
+cv::Mat FftCorrelator::correlate(const cv::Mat& kernel_spectrum, cv::Size template_size, const cv::Mat& window_norms, double template_norm) const
+{
+    return divideByWindowNorms(inverseCorrelation(scene_spectrum, kernel_spectrum, template_size), window_norms, template_norm);
+}
+
+/**
+ * @brief Computes the norms of the centered scene windows under a template, for all its positions.
+ *
+ * Without a mask, the norms are read from the integral images of the scene. With the mask of a rotated
+ * template, the statistics are measured under the mask, as `cv::matchTemplate` does with a mask: the mask is
+ * correlated with the centered scene and its square, which costs two inverse transforms. The norms only depend
+ * on the window size and the mask, so they are computed once for all the templates sharing them (e.g. the
+ * templates of a size cluster at the same angle).
+ *
+ * @param[in] window_size The size of the template window.
+ * @param[in] mask_spectrum The spectrum of the `CV_32F` mask zero-padded to the DFT size of the scene, or an
+ *                          empty matrix for an unmasked window.
+ * @param[in] mask_area The number of pixels of the mask.
+ * @return The `CV_32F` map of the window norms, of size (W - w + 1) x (H - h + 1), 0 for the flat windows.
+ *
+ * @throws std::invalid_argument If the window is larger than the scene.
+ *
+ * @see integralWindowNorms
+ * @see maskedWindowNorms
+ */
+cv::Mat FftCorrelator::windowNorms(cv::Size window_size, const cv::Mat& mask_spectrum, double mask_area) const
+{
+    if (mask_spectrum.empty())
+        return integralWindowNorms(integral_sum, integral_sqsum, window_size, resultSize(window_size));
+
+    const cv::Mat window_sum = inverseCorrelation(centered_spectrum, mask_spectrum, window_size);
+    const cv::Mat window_sqsum = inverseCorrelation(squared_spectrum, mask_spectrum, window_size);
+    return maskedWindowNorms(window_sum, window_sqsum, mask_area);
+}
+
+/**
+ * @brief Computes the raw (unnormalized) correlation of a kernel with the scene.
+ *
+ * @param[in] kernel The `CV_32F` kernel, e.g. a zero-mean template or a linear combination of such templates.
+ * @return The `CV_32F` correlation map, of size (W - w + 1) x (H - h + 1).
+ *
+ * @throws std::invalid_argument If the kernel is larger than the scene.
+ *
+ * @see normalize
+ */
+cv::Mat FftCorrelator::rawCorrelation(const cv::Mat& kernel) const
+{
+    return inverseCorrelation(scene_spectrum, paddedSpectrum(kernel, dft_size), kernel.size());
+}
+
+/**
+ * @brief Normalizes a raw correlation map with the local statistics of a window of the scene.
+ *
+ * The window is the part of the correlated kernel covered by the template: at the position p of the map, the
+ * local scene statistics are measured over the window of size `window_size` whose top-left corner is
+ * p + `window_offset`. This normalizes the correlation of a template embedded in a larger kernel.
+ *
+ * @param[in] correlation The raw correlation map, as returned by `rawCorrelation`.
+ * @param[in] window_offset The position of the template window in the kernel.
+ * @param[in] window_size The size of the template window.
+ * @param[in] template_norm The L2 norm of the zero-mean template.
+ * @return The `CV_32F` normalized cross-correlation map, of the size of `correlation`.
+ *
+ * @see normalizeCorrelation
+ */
+cv::Mat FftCorrelator::normalize(const cv::Mat& correlation, cv::Point window_offset, cv::Size window_size, double template_norm) const
+{
+    const cv::Rect integral_rect(window_offset, cv::Size(correlation.cols + window_size.width, correlation.rows + window_size.height));
+    return normalizeCorrelation(correlation, integral_sum(integral_rect), integral_sqsum(integral_rect), window_size, template_norm);
+}
+
+/**
+ * @brief Returns the number of valid positions of a template in the scene.
+ *
+ * @param[in] template_size The size of the template.
+ * @return The size of the correlation map, (W - w + 1) x (H - h + 1).
+ *
+ * @throws std::invalid_argument If the template is larger than the scene.
+ */
+cv::Size FftCorrelator::resultSize(cv::Size template_size) const
+{
+    if (template_size.width > scene_size.width || template_size.height > scene_size.height)
+        throw std::invalid_argument("The template is larger than the scene.");
+
+    return cv::Size(scene_size.width - template_size.width + 1, scene_size.height - template_size.height + 1);
+}
+
+/**
+ * @brief Transforms the product of a scene spectrum and of a template spectrum back to a correlation map.
+ *
+ * @param[in] spectrum The spectrum of the scene, of the centered scene or of its square.
+ * @param[in] template_spectrum The spectrum of the zero-padded template or mask, as returned by `paddedSpectrum`.
+ * @param[in] template_size The size of the template.
+ * @return The `CV_32F` raw correlation map over the valid positions, (W - w + 1) x (H - h + 1).
+ *
+ * @throws std::invalid_argument If the template is larger than the scene.
+ *
+ * @see cv::mulSpectrums
+ * @see cv::idft
+ */
+cv::Mat FftCorrelator::inverseCorrelation(const cv::Mat& spectrum, const cv::Mat& template_spectrum, cv::Size template_size) const
+{
+    const cv::Size result_size = resultSize(template_size);
+
+    cv::Mat product;
+    cv::mulSpectrums(spectrum, template_spectrum, product, 0, true);
+
+    cv::Mat correlation;
+    cv::idft(product, correlation, cv::DFT_SCALE | cv::DFT_REAL_OUTPUT, result_size.height);
+
+    return correlation(cv::Rect(cv::Point(0, 0), result_size));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+
+struct PreparedTemplate
+{
+    cv::Mat kernel;    // CV_32F, zero-mean template inside the mask and 0 outside of it
+    cv::Mat mask;      // CV_32F, 1 inside the mask and 0 outside of it; empty when the mask covers the whole window
+    double mean = 0.0; // mean of the template inside the mask
+    double norm = 0.0; // L2 norm of the kernel
+};
+
+PreparedTemplate prepareTemplate(const cv::Mat& templ, const cv::Mat& mask = cv::Mat());
+
+cv::Mat windowMask(const cv::Mat& mask);
+
+cv::Mat paddedSpectrum(const cv::Mat& kernel, cv::Size dft_size);
+
+cv::Mat windowSums(const cv::Mat& integral_img, cv::Size window_size, cv::Size result_size);
+
+cv::Mat integralWindowNorms(const cv::Mat& integral_sum, const cv::Mat& integral_sqsum, cv::Size window_size, cv::Size result_size);
+
+cv::Mat maskedWindowNorms(const cv::Mat& window_sum, const cv::Mat& window_sqsum, double mask_area);
+
+cv::Mat divideByWindowNorms(const cv::Mat& correlation, const cv::Mat& window_norms, double template_norm);
+
+cv::Mat normalizeCorrelation(const cv::Mat& correlation, const cv::Mat& integral_sum, const cv::Mat& integral_sqsum, cv::Size template_size, double template_norm);
+
+cv::Mat normalizeMaskedCorrelation(const cv::Mat& correlation, const cv::Mat& window_sum, const cv::Mat& window_sqsum, double mask_area, double template_norm);
+
+cv::Mat correlateLocally(const cv::Mat& patch, const PreparedTemplate& prepared_template, bool integer_correlation = false);
+
+class FftCorrelator
+{
+public:
+    explicit FftCorrelator(const cv::Mat& scene);
+
+    cv::Mat correlate(const PreparedTemplate& prepared_template) const;
+
+    cv::Mat correlate(const cv::Mat& kernel_spectrum, cv::Size template_size, const cv::Mat& window_norms, double template_norm) const;
+
+    cv::Mat windowNorms(cv::Size window_size, const cv::Mat& mask_spectrum = cv::Mat(), double mask_area = 0.0) const;
+
+    cv::Mat rawCorrelation(const cv::Mat& kernel) const;
+
+    cv::Mat normalize(const cv::Mat& correlation, cv::Point window_offset, cv::Size window_size, double template_norm) const;
+
+    cv::Size sceneSize() const { return scene_size; }
+
+    cv::Size dftSize() const { return dft_size; }
+
+private:
+    cv::Size resultSize(cv::Size template_size) const;
+
+    cv::Mat inverseCorrelation(const cv::Mat& spectrum, const cv::Mat& template_spectrum, cv::Size template_size) const;
+
+    cv::Size scene_size;
+    cv::Size dft_size;
+    cv::Mat scene_spectrum;
+    cv::Mat centered_spectrum; // of the scene minus its mean, for the masked window sums
+    cv::Mat squared_spectrum;  // of the square of the centered scene
+    cv::Mat integral_sum;
+    cv::Mat integral_sqsum;
+};
\ No newline at end of file
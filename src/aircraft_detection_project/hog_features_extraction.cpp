@@ -1,6 +1,10 @@
 #include "hog_features_extraction.h"
+#include "hog_kernel.h"
+#include "thread_pool.h"
 #include "utils.h"
-#include <iomanip>
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
 
 
 
@@ -23,10 +27,10 @@
 std::vector< std::vector<float> > hog_features_extraction(const std::vector<cv::Rect>& rois, const cv::Mat& image)
 {
     // Create a HOG descriptor object
-    cv::HOGDescriptor hog(cv::Size(64, 64),
-        cv::Size(8, 8),
-        cv::Size(8, 8),
-        cv::Size(8, 8), 9);
+    cv::HOGDescriptor hog(cv::Size(hog_window_size, hog_window_size),
+        cv::Size(hog_cell_size, hog_cell_size),
+        cv::Size(hog_cell_size, hog_cell_size),
+        cv::Size(hog_cell_size, hog_cell_size), hog_num_bins);
 
     // Avoids multiple reallocations by reserving space for the HOG features of all ROIs
 	std::vector<std::vector<float>> hog_features;
@@ -39,7 +43,7 @@ std::vector< std::vector<float> > hog_features_extraction(const std::vector<cv::
 
         // Resize the ROI to 64x64
         cv::Mat resized_roi_img;
-        cv::resize(roi_img, resized_roi_img, cv::Size(64, 64), 0, 0, cv::INTER_AREA);
+        cv::resize(roi_img, resized_roi_img, cv::Size(hog_window_size, hog_window_size), 0, 0, cv::INTER_AREA);
 
 
         // Compute the HOG descriptors for the resized ROI
@@ -53,37 +57,238 @@ std::vector< std::vector<float> > hog_features_extraction(const std::vector<cv::
 }
 
 
+/**
+ * @brief Computes the HOG descriptors of a batch of ROIs into one contiguous matrix.
+ *
+ * This function computes the same descriptors as `hog_features_extraction` (to within about 1e-6, with the
+ * compile-time specialized `SvmHogKernel` instead of `cv::HOGDescriptor`), but writes them straight into the rows
+ * of a single row-major `CV_32F` matrix, which the SVM reads as one cache-friendly block. The ROIs are split into
+ * one chunk per thread of the shared thread pool. Every thread keeps its resize buffer from one call to the next,
+ * so a batch allocates nothing but the output matrix, which is itself reused when the caller passes the matrix
+ * of the previous batch.
+ *
+ * @param[in] rois A vector of `cv::Rect` defining the regions of interest in the image.
+ * @param[in] image The input image from which the ROIs are extracted.
+ * @param[out] descriptors A `CV_32F` matrix with the `hog_descriptor_size` features of every ROI, one ROI per row.
+ *
+ * @throws std::invalid_argument If the image is not an 8-bit grayscale image.
+ *
+ * @see hog_features_extraction
+ * @see HogKernel::compute
+ * @see sharedThreadPool
+ */
+void computeHogDescriptors(const std::vector<cv::Rect>& rois, const cv::Mat& image, cv::Mat& descriptors)
+{
+    // Below this number of ROIs per thread, the work is not worth splitting
+    constexpr size_t min_chunk_size = 16;
+
+    if (image.type() != CV_8UC1)
+        throw std::invalid_argument("The HOG descriptors are computed on 8-bit grayscale images.");
+
+    descriptors.create(static_cast<int>(rois.size()), hog_descriptor_size, CV_32F);
+
+    auto compute_chunk = [&rois, &image, &descriptors](size_t begin, size_t end)
+    {
+        thread_local cv::Mat resized_roi_img;
+
+        for (size_t i = begin; i < end; i++)
+        {
+            cv::resize(image(rois[i]), resized_roi_img, cv::Size(hog_window_size, hog_window_size), 0, 0, cv::INTER_AREA);
+            SvmHogKernel::compute(resized_roi_img.data, resized_roi_img.step, descriptors.ptr<float>(static_cast<int>(i)));
+        }
+    };
+
+    ThreadPool& pool = sharedThreadPool();
+    const size_t chunk_size = std::max(min_chunk_size, (rois.size() + pool.numThreads() - 1) / pool.numThreads());
+    if (rois.size() <= chunk_size)
+    {
+        compute_chunk(0, rois.size());
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    for (size_t begin = 0; begin < rois.size(); begin += chunk_size)
+        futures.emplace_back(pool.submit([&compute_chunk, begin, end = std::min(begin + chunk_size, rois.size())]() { compute_chunk(begin, end); }));
+    pool.waitAll(futures);
+}
+
+
+/**
+ * @brief Parses the name of a HOG engine.
+ *
+ * @param[in] engine The name of the engine: "roi" or "dense".
+ * @return The corresponding `HogEngine`.
+ *
+ * @throws std::invalid_argument If the name is not a known engine.
+ */
+HogEngine parseHogEngine(const std::string& engine)
+{
+    if (engine == "roi")
+        return HogEngine::PerRoi;
+    if (engine == "dense")
+        return HogEngine::Dense;
+
+    throw std::invalid_argument("Unknown HOG engine: " + engine);
+}
+
+
+/**
+ * @brief Formats rows of features as CSV lines, as `writeHogFeaturesToCsv` writes them.
+ *
+ * Every value is formatted with `std::to_chars` in fixed notation with 6 decimal places, the values of a row are
+ * separated by commas and every row ends with a newline.
+ *
+ * @param[in] rows A `CV_32F` matrix, one CSV line per row.
+ * @param[in,out] buffer The buffer the lines are written to, from its beginning. It is only ever enlarged, so a
+ *                       buffer reused for the next rows neither reallocates nor clears its memory again.
+ * @return The number of characters written to the buffer.
+ */
+size_t formatCsvRows(const cv::Mat& rows, std::vector<char>& buffer)
+{
+    // Longest value: sign, 39 integer digits (FLT_MAX), decimal point and 6 decimals, followed by a separator
+    constexpr size_t max_value_chars = 48;
+
+    const size_t max_chars = static_cast<size_t>(rows.rows) * (static_cast<size_t>(rows.cols) * max_value_chars + 1);
+    if (buffer.size() < max_chars)
+        buffer.resize(max_chars);
+
+    char* position = buffer.data();
+    char* const end = buffer.data() + buffer.size();
+    for (int row = 0; row < rows.rows; row++)
+    {
+        const float* features = rows.ptr<float>(row);
+        for (int col = 0; col < rows.cols; col++)
+        {
+            // Add a comma before each feature except the first one
+            if (col > 0)
+                *position++ = ',';
+            position = std::to_chars(position, end, features[col], std::chars_format::fixed, 6).ptr;
+        }
+        *position++ = '\n';
+    }
+    return static_cast<size_t>(position - buffer.data());
+}
+
 /**
  * @brief Writes HOG features to a CSV file.
  *
- * This function takes a vector of HOG feature vectors and writes them to a specified
+ * This function takes a matrix of HOG feature vectors and writes them to a specified
  * CSV file. Each row in the CSV file corresponds to one HOG feature vector, and each
  * value in the vector is written with a fixed precision of 6 decimal places.
  *
- * @param[in] hog_features A vector of HOG feature vectors to be written to the CSV file.
+ * The rows are formatted with `std::to_chars` in chunks of `rows_per_chunk` rows, one chunk per thread of the
+ * shared thread pool, each into its own buffer. The buffers are written to the file in order, with one large
+ * write per chunk, while the threads already format the next chunks. The output is byte for byte the one of
+ * `std::fixed << std::setprecision(6)`, which `std::to_chars` reproduces by definition (as `printf("%.6f")`).
+ *
+ * @param[in] hog_features A `CV_32F` matrix of HOG feature vectors, one per row, to be written to the CSV file.
  * @param[in] filename The name of the CSV file to write the HOG features to.
  *
+ * @throws std::invalid_argument If the features are not a `CV_32F` matrix.
+ * @throws std::runtime_error If the file cannot be written.
+ *
  * @note The file is opened using the `openFile` function, which is assumed to return a
  *       file stream. The features are written in a consistent format with a fixed
- *       precision to ensure proper formatting regardless of locale settings.
+ *       precision to ensure proper formatting regardless of locale settings:
+ *       `std::to_chars` never uses the locale (e.g., a comma as the decimal separator).
+ *
+ * @see formatCsvRows
  */
-void writeHogFeaturesToCsv(const std::vector<std::vector<float>>& hog_features, const std::string& filename)
+void writeHogFeaturesToCsv(const cv::Mat& hog_features, const std::string& filename)
 {
+    constexpr int rows_per_chunk = 256;
+
+    if (!hog_features.empty() && hog_features.type() != CV_32F)
+        throw std::invalid_argument("The HOG features written to " + filename + " must be a CV_32F matrix.");
+
     auto file = openFile(filename);
 
-    for (const auto& features : hog_features)
+    ThreadPool& pool = sharedThreadPool();
+    const int num_chunks = (hog_features.rows + rows_per_chunk - 1) / rows_per_chunk;
+    const int chunks_per_batch = static_cast<int>(pool.numThreads());
+
+    // Two sets of buffers: the chunks of the next batch are formatted while those of the current one are written
+    std::vector<std::vector<char>> buffers(2 * static_cast<size_t>(chunks_per_batch));
+    std::vector<size_t> buffer_sizes(buffers.size());
+
+    auto format_batch = [&](int first_chunk)
     {
-        for (auto it = features.cbegin(); it != features.cend(); ++it)
+        std::vector<std::future<void>> futures;
+        for (int chunk = first_chunk; chunk < std::min(first_chunk + chunks_per_batch, num_chunks); chunk++)
         {
-            // Add a comma before each feature except the first one
-            if (it != features.cbegin())
-                file << ",";
+            const size_t slot = chunk % buffers.size();
+            const int first_row = chunk * rows_per_chunk;
+            const int last_row = std::min(first_row + rows_per_chunk, hog_features.rows);
+            futures.push_back(pool.submit([&hog_features, &buffers, &buffer_sizes, slot, first_row, last_row]() {
+                buffer_sizes[slot] = formatCsvRows(hog_features.rowRange(first_row, last_row), buffers[slot]);
+                }));
+        }
+        return futures;
+    };
+
+    std::vector<std::future<void>> futures = format_batch(0);
+    for (int first_chunk = 0; first_chunk < num_chunks; first_chunk += chunks_per_batch)
+    {
+        pool.waitAll(futures);
+        futures = format_batch(first_chunk + chunks_per_batch);
 
-            // Write the feature to the file with fixed precision and 6 decimal places (e.g., 0.123456)
-            // This is done to ensure that the features are written in a consistent format, regardless of the locale settings
-            // (e.g., using a comma as the decimal separator in some locales)
-            file << std::fixed << std::setprecision(6) << *it;
+        for (int chunk = first_chunk; chunk < std::min(first_chunk + chunks_per_batch, num_chunks); chunk++)
+        {
+            const size_t slot = chunk % buffers.size();
+            file.write(buffers[slot].data(), static_cast<std::streamsize>(buffer_sizes[slot]));
         }
-        file << "\n";
     }
-}
\ No newline at end of file
+    pool.waitAll(futures);
+
+    if (!file)
+        throw std::runtime_error("Could not write the CSV file " + filename);
+}
+
+/**
+ * @brief Reads HOG features from a CSV file written by `writeHogFeaturesToCsv`.
+ *
+ * @param[in] filename The name of the CSV file.
+ * @return A `CV_32F` matrix with one row of HOG features per line of the file.
+ *
+ * @throws std::runtime_error If the file cannot be opened, if a value is not a number, or if the lines do not all
+ *         have the same number of features.
+ *
+ * @note The values are parsed with `std::from_chars`, which does not depend on the locale, as the writer.
+ */
+cv::Mat readHogFeaturesFromCsv(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open the CSV file " + filename);
+
+    cv::Mat hog_features;
+    std::vector<float> features;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        features.clear();
+        const char* it = line.data();
+        const char* end = line.data() + line.size();
+        while (it < end)
+        {
+            float value = 0.0f;
+            const auto [next, error] = std::from_chars(it, end, value);
+            if (error != std::errc() || (next != end && *next != ','))
+                throw std::runtime_error("Invalid HOG feature in " + filename + ": " + line);
+
+            features.push_back(value);
+            it = next + 1;
+        }
+
+        if (!hog_features.empty() && static_cast<int>(features.size()) != hog_features.cols)
+            throw std::runtime_error("The lines of " + filename + " do not all have the same number of features.");
+
+        hog_features.push_back(cv::Mat(1, static_cast<int>(features.size()), CV_32F, features.data()));
+    }
+    return hog_features;
+}
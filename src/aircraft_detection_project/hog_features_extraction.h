@@ -1,10 +1,103 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
 #include <string>
 #include <vector>
 
 
+// Geometry of the HOG descriptors the SVM is trained on: one 9-bin histogram per 8x8 cell (blocks of one cell) of
+// a 64x64 window, i.e. 8 x 8 cells and 576 features
+constexpr int hog_window_size = 64;
+constexpr int hog_cell_size = 8;
+constexpr int hog_num_bins = 9;
+constexpr int hog_cells_per_side = hog_window_size / hog_cell_size;
+constexpr int hog_descriptor_size = hog_cells_per_side * hog_cells_per_side * hog_num_bins;
+
+enum class HogEngine
+{
+    PerRoi, // crop and resize every ROI to the window size, then cv::HOGDescriptor (batched, see computeHogDescriptors)
+    Dense   // cell histograms computed once per image and scale, shared by all the ROIs (see dense_hog.h)
+};
+
+HogEngine parseHogEngine(const std::string& engine);
+
 std::vector<std::vector<float>> hog_features_extraction(const std::vector<cv::Rect>& rois, const cv::Mat& image);
 
-void writeHogFeaturesToCsv(const std::vector<std::vector<float>>& hog_features, const std::string& filename);
\ No newline at end of file
+void computeHogDescriptors(const std::vector<cv::Rect>& rois, const cv::Mat& image, cv::Mat& descriptors);
+
+size_t formatCsvRows(const cv::Mat& rows, std::vector<char>& buffer);
+
+void writeHogFeaturesToCsv(const cv::Mat& hog_features, const std::string& filename);
+
+cv::Mat readHogFeaturesFromCsv(const std::string& filename);
+
+template<int CellSize>
+float hogCellWeight(int i, int j);
+
+template<int NumBins>
+void normalizeHogHistogram(float* histogram);
+
+
+
+/**
+ * @brief Returns the weight of a pixel of a cell in its histogram, as `cv::HOGDescriptor` does.
+ *
+ * With blocks of a single cell, the weight is the product of a Gaussian centered on the block (sigma of a quarter
+ * of the cell, 2 pixels for the default 8x8 cells of `cv::HOGDescriptor`) and of the spatial interpolation
+ * weight of the pixel towards the cell center, a tent going from 0.5625 at the borders to 0.9375 at the center.
+ * It is shared by the dense HOG and the HOG kernel, so that both give the descriptors of `cv::HOGDescriptor`.
+ *
+ * @param[in] i The row of the pixel in the cell.
+ * @param[in] j The column of the pixel in the cell.
+ * @return The weight of the pixel.
+ *
+ * @see cv::HOGDescriptor::getWinSigma
+ */
+template<int CellSize>
+inline float hogCellWeight(int i, int j)
+{
+    static_assert(CellSize >= 2 && CellSize % 2 == 0, "The spatial interpolation needs an even cell size.");
+
+    constexpr float sigma = CellSize / 4.0f;
+    constexpr float half_size = CellSize * 0.5f;
+
+    auto interpolation_weight = [](int k)
+    {
+        const float cell_position = (k + 0.5f) / CellSize - 0.5f;
+        return k < CellSize / 2 ? cell_position + 1.0f : 1.0f - cell_position;
+    };
+
+    const float squared_distance = (i - half_size) * (i - half_size) + (j - half_size) * (j - half_size);
+    return std::exp(-squared_distance / (2.0f * sigma * sigma)) * interpolation_weight(i) * interpolation_weight(j);
+}
+
+/**
+ * @brief Normalizes a cell histogram in place with the L2-Hys scheme of `cv::HOGDescriptor`.
+ *
+ * The histogram is L2-normalized, clipped at 0.2 and L2-normalized again.
+ *
+ * @param[in,out] histogram The `NumBins` values of the histogram.
+ */
+template<int NumBins>
+inline void normalizeHogHistogram(float* histogram)
+{
+    constexpr float clip_threshold = 0.2f;
+
+    float squared_sum = 0.0f;
+    for (int bin = 0; bin < NumBins; bin++)
+        squared_sum += histogram[bin] * histogram[bin];
+
+    float scale = 1.0f / (std::sqrt(squared_sum) + NumBins * 0.1f);
+    squared_sum = 0.0f;
+    for (int bin = 0; bin < NumBins; bin++)
+    {
+        histogram[bin] = std::min(histogram[bin] * scale, clip_threshold);
+        squared_sum += histogram[bin] * histogram[bin];
+    }
+
+    scale = 1.0f / (std::sqrt(squared_sum) + 1e-3f);
+    for (int bin = 0; bin < NumBins; bin++)
+        histogram[bin] *= scale;
+}
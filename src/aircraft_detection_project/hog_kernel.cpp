@@ -0,0 +1,340 @@
+#include "hog_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HOG_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+// As in integer_correlation.cpp, only the kernels are compiled for the wider instruction sets
+#if defined(__GNUC__) || defined(__clang__)
+#define HOG_KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define HOG_KERNEL_TARGET(isa)
+#endif
+
+
+namespace
+{
+    // Polynomial approximation of atan on [0, 1], in degrees: the one of cv::cartToPolar, so that the orientations
+    // (and therefore the bins) match those of cv::HOGDescriptor
+    constexpr float atan_p1 = static_cast<float>(0.9997878412794807 * 180 / CV_PI);
+    constexpr float atan_p3 = static_cast<float>(-0.3258083974640975 * 180 / CV_PI);
+    constexpr float atan_p5 = static_cast<float>(0.1555786518463281 * 180 / CV_PI);
+    constexpr float atan_p7 = static_cast<float>(-0.04432655554792128 * 180 / CV_PI);
+    constexpr float atan_epsilon = static_cast<float>(std::numeric_limits<double>::epsilon());
+
+    // Gradients of one band of CellSize rows: every pixel gives its magnitude to two neighboring bins
+    template<int WindowSize, int CellSize>
+    struct GradientBand
+    {
+        alignas(32) float low_weights[CellSize][WindowSize];
+        alignas(32) float high_weights[CellSize][WindowSize];
+        alignas(32) float low_bins[CellSize][WindowSize]; // index of the lower bin, stored as a float for the SIMD kernels
+    };
+
+    // Weight of every pixel of a cell in its histogram, aligned for the SIMD kernels: see hogCellWeight
+    template<int CellSize>
+    struct CellWeights
+    {
+        alignas(32) float values[CellSize][CellSize];
+
+        CellWeights()
+        {
+            for (int i = 0; i < CellSize; i++)
+            {
+                for (int j = 0; j < CellSize; j++)
+                    values[i][j] = hogCellWeight<CellSize>(i, j);
+            }
+        }
+    };
+
+    template<int CellSize>
+    const CellWeights<CellSize>& cellWeights()
+    {
+        static const CellWeights<CellSize> weights;
+        return weights;
+    }
+
+    template<int NumBins>
+    void binGradient(float dx, float dy, float& low_weight, float& high_weight, float& low_bin)
+    {
+        const float magnitude = std::sqrt(dx * dx + dy * dy);
+
+        const float ax = std::abs(dx), ay = std::abs(dy);
+        const float c = std::min(ax, ay) / (std::max(ax, ay) + atan_epsilon);
+        const float c2 = c * c;
+        float degrees = (((atan_p7 * c2 + atan_p5) * c2 + atan_p3) * c2 + atan_p1) * c;
+        if (ax < ay)
+            degrees = 90.0f - degrees;
+        if (dx < 0)
+            degrees = 180.0f - degrees;
+        if (dy < 0)
+            degrees = 360.0f - degrees;
+
+        // Unsigned orientation: the bin index wraps around twice over the 360 degrees
+        float position = degrees * (NumBins / 180.0f) - 0.5f;
+        float bin = std::floor(position);
+        position -= bin;
+        if (bin < 0)
+            bin += NumBins;
+        else if (bin >= NumBins)
+            bin -= NumBins;
+
+        low_weight = magnitude * (1.0f - position);
+        high_weight = magnitude * position;
+        low_bin = bin;
+    }
+
+    /*
+     * Copies a row of the window with one reflected pixel on each side (BORDER_REFLECT_101, as
+     * cv::HOGDescriptor::computeGradient), so that the horizontal differences need no special case.
+     */
+    template<int WindowSize>
+    void padRow(const uchar* row, uchar* padded_row)
+    {
+        padded_row[0] = row[1];
+        std::memcpy(padded_row + 1, row, WindowSize);
+        padded_row[WindowSize + 1] = row[WindowSize - 2];
+    }
+
+    template<int WindowSize, int CellSize, int NumBins>
+    void gradientBandScalar(const uchar* window, size_t step, int first_row, GradientBand<WindowSize, CellSize>& band)
+    {
+        uchar padded_row[WindowSize + 2];
+        for (int i = 0; i < CellSize; i++)
+        {
+            const int y = first_row + i;
+            const uchar* above = window + (y > 0 ? y - 1 : 1) * step;
+            const uchar* below = window + (y < WindowSize - 1 ? y + 1 : WindowSize - 2) * step;
+            padRow<WindowSize>(window + y * step, padded_row);
+
+            for (int x = 0; x < WindowSize; x++)
+            {
+                binGradient<NumBins>(static_cast<float>(padded_row[x + 2]) - static_cast<float>(padded_row[x]),
+                    static_cast<float>(below[x]) - static_cast<float>(above[x]),
+                    band.low_weights[i][x], band.high_weights[i][x], band.low_bins[i][x]);
+            }
+        }
+    }
+
+    template<int WindowSize, int CellSize, int NumBins>
+    void cellHistogramsScalar(const GradientBand<WindowSize, CellSize>& band, int band_index, float* descriptor)
+    {
+        constexpr int cells_per_side = WindowSize / CellSize;
+        const auto& weights = cellWeights<CellSize>().values;
+
+        for (int cell_x = 0; cell_x < cells_per_side; cell_x++)
+        {
+            float* histogram = descriptor + (cell_x * cells_per_side + band_index) * NumBins;
+            std::fill(histogram, histogram + NumBins, 0.0f);
+            for (int i = 0; i < CellSize; i++)
+            {
+                for (int j = 0; j < CellSize; j++)
+                {
+                    const int x = cell_x * CellSize + j;
+                    const int low_bin = static_cast<int>(band.low_bins[i][x]);
+                    histogram[low_bin] += band.low_weights[i][x] * weights[i][j];
+                    histogram[low_bin + 1 < NumBins ? low_bin + 1 : 0] += band.high_weights[i][x] * weights[i][j];
+                }
+            }
+            normalizeHogHistogram<NumBins>(histogram);
+        }
+    }
+
+#ifdef HOG_KERNEL_X86
+    // Loads 8 pixels as floats
+    HOG_KERNEL_TARGET("avx2")
+    __m256 loadPixels(const uchar* pixels)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels))));
+    }
+
+    template<int WindowSize, int CellSize, int NumBins>
+    HOG_KERNEL_TARGET("avx2")
+    void gradientBandAvx2(const uchar* window, size_t step, int first_row, GradientBand<WindowSize, CellSize>& band)
+    {
+        static_assert(WindowSize % 8 == 0, "The AVX2 kernel processes the rows by groups of 8 pixels.");
+
+        const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 num_bins = _mm256_set1_ps(static_cast<float>(NumBins));
+        const __m256 bin_scale = _mm256_set1_ps(NumBins / 180.0f);
+
+        uchar padded_row[WindowSize + 2];
+        for (int i = 0; i < CellSize; i++)
+        {
+            const int y = first_row + i;
+            const uchar* above = window + (y > 0 ? y - 1 : 1) * step;
+            const uchar* below = window + (y < WindowSize - 1 ? y + 1 : WindowSize - 2) * step;
+            padRow<WindowSize>(window + y * step, padded_row);
+
+            for (int x = 0; x < WindowSize; x += 8)
+            {
+                const __m256 dx = _mm256_sub_ps(loadPixels(padded_row + x + 2), loadPixels(padded_row + x));
+                const __m256 dy = _mm256_sub_ps(loadPixels(below + x), loadPixels(above + x));
+                const __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+
+                // Same polynomial and octant reduction as binGradient, without branches
+                const __m256 ax = _mm256_andnot_ps(sign_mask, dx);
+                const __m256 ay = _mm256_andnot_ps(sign_mask, dy);
+                const __m256 c = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_add_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(atan_epsilon)));
+                const __m256 c2 = _mm256_mul_ps(c, c);
+                __m256 degrees = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(atan_p7), c2), _mm256_set1_ps(atan_p5));
+                degrees = _mm256_add_ps(_mm256_mul_ps(degrees, c2), _mm256_set1_ps(atan_p3));
+                degrees = _mm256_add_ps(_mm256_mul_ps(degrees, c2), _mm256_set1_ps(atan_p1));
+                degrees = _mm256_mul_ps(degrees, c);
+                degrees = _mm256_blendv_ps(degrees, _mm256_sub_ps(_mm256_set1_ps(90.0f), degrees), _mm256_cmp_ps(ax, ay, _CMP_LT_OQ));
+                degrees = _mm256_blendv_ps(degrees, _mm256_sub_ps(_mm256_set1_ps(180.0f), degrees), _mm256_cmp_ps(dx, zero, _CMP_LT_OQ));
+                degrees = _mm256_blendv_ps(degrees, _mm256_sub_ps(_mm256_set1_ps(360.0f), degrees), _mm256_cmp_ps(dy, zero, _CMP_LT_OQ));
+
+                __m256 position = _mm256_sub_ps(_mm256_mul_ps(degrees, bin_scale), _mm256_set1_ps(0.5f));
+                __m256 bin = _mm256_floor_ps(position);
+                position = _mm256_sub_ps(position, bin);
+                bin = _mm256_add_ps(bin, _mm256_and_ps(_mm256_cmp_ps(bin, zero, _CMP_LT_OQ), num_bins));
+                bin = _mm256_sub_ps(bin, _mm256_and_ps(_mm256_cmp_ps(bin, num_bins, _CMP_GE_OQ), num_bins));
+
+                _mm256_storeu_ps(band.low_weights[i] + x, _mm256_mul_ps(magnitude, _mm256_sub_ps(_mm256_set1_ps(1.0f), position)));
+                _mm256_storeu_ps(band.high_weights[i] + x, _mm256_mul_ps(magnitude, position));
+                _mm256_storeu_ps(band.low_bins[i] + x, bin);
+            }
+        }
+    }
+
+    HOG_KERNEL_TARGET("avx2")
+    float horizontalSum(__m256 values)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        return _mm_cvtss_f32(sum);
+    }
+
+    /*
+     * Bins the pixels of every cell of a band, 8 pixels at a time: instead of scattering them into the
+     * histogram, every bin accumulates the weights of the lanes whose lower or upper bin it is. With the bin
+     * count known at compile time, the loop over the bins is fully unrolled and the sums stay in registers.
+     */
+    template<int WindowSize, int CellSize, int NumBins>
+    HOG_KERNEL_TARGET("avx2")
+    void cellHistogramsAvx2(const GradientBand<WindowSize, CellSize>& band, int band_index, float* descriptor)
+    {
+        static_assert(CellSize % 8 == 0, "The AVX2 kernel bins the cells by groups of 8 pixels.");
+        constexpr int cells_per_side = WindowSize / CellSize;
+        const auto& weights = cellWeights<CellSize>().values;
+
+        for (int cell_x = 0; cell_x < cells_per_side; cell_x++)
+        {
+            __m256 sums[NumBins];
+            for (int bin = 0; bin < NumBins; bin++)
+                sums[bin] = _mm256_setzero_ps();
+
+            for (int i = 0; i < CellSize; i++)
+            {
+                for (int j = 0; j < CellSize; j += 8)
+                {
+                    const int x = cell_x * CellSize + j;
+                    const __m256 pixel_weights = _mm256_loadu_ps(weights[i] + j);
+                    const __m256 low_weights = _mm256_mul_ps(_mm256_loadu_ps(band.low_weights[i] + x), pixel_weights);
+                    const __m256 high_weights = _mm256_mul_ps(_mm256_loadu_ps(band.high_weights[i] + x), pixel_weights);
+                    const __m256 low_bins = _mm256_loadu_ps(band.low_bins[i] + x);
+
+                    // The lanes whose lower bin is `bin` give their upper weight to the next bin
+                    for (int bin = 0; bin < NumBins; bin++)
+                    {
+                        const int next_bin = bin + 1 < NumBins ? bin + 1 : 0;
+                        const __m256 in_bin = _mm256_cmp_ps(low_bins, _mm256_set1_ps(static_cast<float>(bin)), _CMP_EQ_OQ);
+                        sums[bin] = _mm256_add_ps(sums[bin], _mm256_and_ps(in_bin, low_weights));
+                        sums[next_bin] = _mm256_add_ps(sums[next_bin], _mm256_and_ps(in_bin, high_weights));
+                    }
+                }
+            }
+
+            float* histogram = descriptor + (cell_x * cells_per_side + band_index) * NumBins;
+            for (int bin = 0; bin < NumBins; bin++)
+                histogram[bin] = horizontalSum(sums[bin]);
+            normalizeHogHistogram<NumBins>(histogram);
+        }
+    }
+#endif
+
+    /*
+     * Checks for AVX2 once: the kernel is called for every ROI, so the check must not be repeated per call.
+     */
+    bool useAvx2()
+    {
+#ifdef HOG_KERNEL_X86
+        static const bool supported = cv::checkHardwareSupport(CV_CPU_AVX2);
+        return supported;
+#else
+        return false;
+#endif
+    }
+}
+
+
+
+/**
+ * @brief Computes the HOG descriptor of one window, with its geometry fixed at compile time.
+ *
+ * The descriptor is the one of `cv::HOGDescriptor` with blocks, block strides and cells of `CellSize` pixels and
+ * the default parameters (Gaussian block weighting, L2-Hys normalization, unsigned gradients): the same
+ * centered-difference gradients with reflected borders, the same orientation approximation as
+ * `cv::cartToPolar`, the same bin and spatial interpolation, and the same layout (cells column by column). Only the
+ * order of the floating-point sums differs, so the values agree to within about 1e-6.
+ *
+ * With every size a compile-time constant, the loops have fixed trip counts and the compiler can unroll them.
+ * The window is processed one band of `CellSize` rows at a time, with AVX2 kernels for the gradients and the
+ * binning when the CPU supports them (detected once at runtime), and scalar code otherwise.
+ *
+ * @param[in] window The `WindowSize` x `WindowSize` 8-bit grayscale window.
+ * @param[in] step The distance, in bytes, between two rows of the window.
+ * @param[out] descriptor The `descriptor_size` features of the window.
+ *
+ * @see cv::HOGDescriptor::compute
+ * @see hogCellWeight
+ * @see normalizeHogHistogram
+ */
+template<int WindowSize, int CellSize, int NumBins>
+void HogKernel<WindowSize, CellSize, NumBins>::compute(const uchar* window, size_t step, float* descriptor)
+{
+    static_assert(WindowSize % CellSize == 0, "The window must be made of whole cells.");
+    static_assert(CellSize >= 2 && CellSize % 2 == 0, "The spatial interpolation needs an even cell size.");
+
+    GradientBand<WindowSize, CellSize> band;
+    for (int band_index = 0; band_index < cells_per_side; band_index++)
+    {
+#ifdef HOG_KERNEL_X86
+        if constexpr (WindowSize % 8 == 0 && CellSize % 8 == 0)
+        {
+            if (useAvx2())
+            {
+                gradientBandAvx2<WindowSize, CellSize, NumBins>(window, step, band_index * CellSize, band);
+                cellHistogramsAvx2<WindowSize, CellSize, NumBins>(band, band_index, descriptor);
+                continue;
+            }
+        }
+#endif
+        gradientBandScalar<WindowSize, CellSize, NumBins>(window, step, band_index * CellSize, band);
+        cellHistogramsScalar<WindowSize, CellSize, NumBins>(band, band_index, descriptor);
+    }
+}
+
+template struct HogKernel<hog_window_size, hog_cell_size, hog_num_bins>;
+
+/**
+ * @brief Returns the printable name of the HOG kernel selected for this CPU.
+ */
+std::string hogKernelName()
+{
+    if constexpr (hog_window_size % 8 == 0 && hog_cell_size % 8 == 0)
+    {
+        if (useAvx2())
+            return "AVX2";
+    }
+    return "scalar";
+}
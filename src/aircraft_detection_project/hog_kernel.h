@@ -0,0 +1,22 @@
+#pragma once
+
+#include "hog_features_extraction.h"
+#include <opencv2/opencv.hpp>
+#include <string>
+
+
+// HOG descriptor of one window whose geometry is fixed at compile time: blocks, block strides and cells of
+// CellSize pixels (one normalized histogram per cell), laid out like cv::HOGDescriptor. It is defined and
+// instantiated in hog_kernel.cpp for the geometry of the SVM features only
+template<int WindowSize, int CellSize, int NumBins>
+struct HogKernel
+{
+    static constexpr int cells_per_side = WindowSize / CellSize;
+    static constexpr int descriptor_size = cells_per_side * cells_per_side * NumBins;
+
+    static void compute(const uchar* window, size_t step, float* descriptor);
+};
+
+using SvmHogKernel = HogKernel<hog_window_size, hog_cell_size, hog_num_bins>;
+
+std::string hogKernelName();
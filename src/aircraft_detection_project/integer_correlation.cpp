@@ -0,0 +1,370 @@
+#include "integer_correlation.h"
+
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define INTEGER_CORRELATION_X86
+#include <immintrin.h>
+#endif
+
+// GCC and Clang only emit the instructions of the functions compiled for them, so the rest of the
+// program keeps the baseline instruction set; MSVC accepts the intrinsics without any flag
+#if defined(__GNUC__) || defined(__clang__)
+#define INTEGER_CORRELATION_TARGET(isa) __attribute__((target(isa)))
+#else
+#define INTEGER_CORRELATION_TARGET(isa)
+#endif
+
+
+namespace
+{
+    // Every product is at most 255 * 128, so 32-bit accumulators are exact up to this window area
+    constexpr int max_template_area = 65535;
+
+    // The direct kernels cost one product per template pixel and map position, while cv::matchTemplate switches
+    // to a DFT whose cost barely depends on the template. Single-threaded, with 16 to 64 px templates, the kernels
+    // are faster up to about this many products (e.g. a 32x32 template over a 17x17 map); on whole 512x512 and
+    // 1024x1024 scenes they are never faster, and up to 10 times slower
+    constexpr double max_direct_products = 1 << 19;
+
+    /*
+     * All the kernels compute, for every valid position, the sum of scene * (template - 128): the scene is
+     * unsigned, the shifted template fits in a signed byte, which is the operand layout of vpdpbusd. The
+     * widening kernels use the same values, so every kernel gives the same integers.
+     */
+
+    void correlateScalar(const cv::Mat& scene, const cv::Mat& templ_s8, cv::Mat& result)
+    {
+        for (int y = 0; y < result.rows; y++)
+        {
+            int32_t* result_row = result.ptr<int32_t>(y);
+            for (int x = 0; x < result.cols; x++)
+            {
+                int32_t sum = 0;
+                for (int r = 0; r < templ_s8.rows; r++)
+                {
+                    const uint8_t* scene_row = scene.ptr<uint8_t>(y + r) + x;
+                    const int8_t* templ_row = templ_s8.ptr<int8_t>(r);
+                    for (int c = 0; c < templ_s8.cols; c++)
+                        sum += scene_row[c] * templ_row[c];
+                }
+                result_row[x] = sum;
+            }
+        }
+    }
+
+#ifdef INTEGER_CORRELATION_X86
+    INTEGER_CORRELATION_TARGET("avx2")
+    void correlateAvx2(const cv::Mat& scene, const cv::Mat& templ_s16, cv::Mat& result)
+    {
+        const int width = templ_s16.cols;
+        for (int y = 0; y < result.rows; y++)
+        {
+            int32_t* result_row = result.ptr<int32_t>(y);
+            for (int x = 0; x < result.cols; x++)
+            {
+                __m256i accumulator = _mm256_setzero_si256();
+                int32_t tail_sum = 0;
+                for (int r = 0; r < templ_s16.rows; r++)
+                {
+                    const uint8_t* scene_row = scene.ptr<uint8_t>(y + r) + x;
+                    const int16_t* templ_row = templ_s16.ptr<int16_t>(r);
+
+                    int c = 0;
+                    for (; c + 16 <= width; c += 16)
+                    {
+                        const __m256i scene_values = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(scene_row + c)));
+                        const __m256i templ_values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(templ_row + c));
+                        accumulator = _mm256_add_epi32(accumulator, _mm256_madd_epi16(scene_values, templ_values));
+                    }
+                    for (; c < width; c++)
+                        tail_sum += scene_row[c] * templ_row[c];
+                }
+
+                const __m128i half_sum = _mm_add_epi32(_mm256_castsi256_si128(accumulator), _mm256_extracti128_si256(accumulator, 1));
+                const __m128i quarter_sum = _mm_add_epi32(half_sum, _mm_shuffle_epi32(half_sum, _MM_SHUFFLE(1, 0, 3, 2)));
+                const __m128i total_sum = _mm_add_epi32(quarter_sum, _mm_shuffle_epi32(quarter_sum, _MM_SHUFFLE(2, 3, 0, 1)));
+                result_row[x] = _mm_cvtsi128_si32(total_sum) + tail_sum;
+            }
+        }
+    }
+
+    INTEGER_CORRELATION_TARGET("avx512f,avx512bw")
+    void correlateAvx512Bw(const cv::Mat& scene, const cv::Mat& templ_s16, cv::Mat& result)
+    {
+        const int width = templ_s16.cols;
+        for (int y = 0; y < result.rows; y++)
+        {
+            int32_t* result_row = result.ptr<int32_t>(y);
+            for (int x = 0; x < result.cols; x++)
+            {
+                __m512i accumulator = _mm512_setzero_si512();
+                for (int r = 0; r < templ_s16.rows; r++)
+                {
+                    const uint8_t* scene_row = scene.ptr<uint8_t>(y + r) + x;
+                    const int16_t* templ_row = templ_s16.ptr<int16_t>(r);
+
+                    // The last, partial block is read with a mask, so no scalar tail is needed
+                    for (int c = 0; c < width; c += 32)
+                    {
+                        const int remaining = width - c;
+                        const __mmask32 lanes = remaining >= 32 ? ~__mmask32(0) : (__mmask32(1) << remaining) - 1;
+                        const __m256i scene_bytes = _mm512_castsi512_si256(_mm512_maskz_loadu_epi8(lanes, scene_row + c));
+                        const __m512i scene_values = _mm512_cvtepu8_epi16(scene_bytes);
+                        const __m512i templ_values = _mm512_maskz_loadu_epi16(lanes, templ_row + c);
+                        accumulator = _mm512_add_epi32(accumulator, _mm512_madd_epi16(scene_values, templ_values));
+                    }
+                }
+                result_row[x] = _mm512_reduce_add_epi32(accumulator);
+            }
+        }
+    }
+
+    INTEGER_CORRELATION_TARGET("avx512f,avx512bw,avx512vnni")
+    void correlateAvx512Vnni(const cv::Mat& scene, const cv::Mat& templ_s8, cv::Mat& result)
+    {
+        const int width = templ_s8.cols;
+        for (int y = 0; y < result.rows; y++)
+        {
+            int32_t* result_row = result.ptr<int32_t>(y);
+            for (int x = 0; x < result.cols; x++)
+            {
+                __m512i accumulator = _mm512_setzero_si512();
+                for (int r = 0; r < templ_s8.rows; r++)
+                {
+                    const uint8_t* scene_row = scene.ptr<uint8_t>(y + r) + x;
+                    const int8_t* templ_row = templ_s8.ptr<int8_t>(r);
+
+                    for (int c = 0; c < width; c += 64)
+                    {
+                        const int remaining = width - c;
+                        const __mmask64 lanes = remaining >= 64 ? ~__mmask64(0) : (__mmask64(1) << remaining) - 1;
+                        const __m512i scene_values = _mm512_maskz_loadu_epi8(lanes, scene_row + c);
+                        const __m512i templ_values = _mm512_maskz_loadu_epi8(lanes, templ_row + c);
+                        accumulator = _mm512_dpbusd_epi32(accumulator, scene_values, templ_values);
+                    }
+                }
+                result_row[x] = _mm512_reduce_add_epi32(accumulator);
+            }
+        }
+    }
+#endif
+}
+
+
+
+/**
+ * @brief Checks whether the CPU (and the build) can run an integer correlation kernel.
+ *
+ * @param[in] kernel The kernel.
+ * @return `true` if the kernel can run on this machine.
+ *
+ * @see cv::checkHardwareSupport
+ */
+bool isIntegerKernelSupported(IntegerKernel kernel)
+{
+    switch (kernel)
+    {
+    case IntegerKernel::Scalar:
+        return true;
+#ifdef INTEGER_CORRELATION_X86
+    case IntegerKernel::Avx2:
+        return cv::checkHardwareSupport(CV_CPU_AVX2);
+    case IntegerKernel::Avx512Bw:
+        return cv::checkHardwareSupport(CV_CPU_AVX_512F) && cv::checkHardwareSupport(CV_CPU_AVX_512BW);
+    case IntegerKernel::Avx512Vnni:
+        return cv::checkHardwareSupport(CV_CPU_AVX_512F) && cv::checkHardwareSupport(CV_CPU_AVX_512BW) && cv::checkHardwareSupport(CV_CPU_AVX_512VNNI);
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Returns the fastest integer correlation kernel supported by the CPU, detected once at runtime.
+ *
+ * @return The fastest supported `IntegerKernel`.
+ *
+ * @see isIntegerKernelSupported
+ */
+IntegerKernel bestIntegerKernel()
+{
+    static const IntegerKernel best_kernel = []()
+    {
+        for (auto kernel : { IntegerKernel::Avx512Vnni, IntegerKernel::Avx512Bw, IntegerKernel::Avx2 })
+        {
+            if (isIntegerKernelSupported(kernel))
+                return kernel;
+        }
+        return IntegerKernel::Scalar;
+    }();
+    return best_kernel;
+}
+
+/**
+ * @brief Returns the printable name of an integer correlation kernel.
+ */
+std::string integerKernelName(IntegerKernel kernel)
+{
+    switch (kernel)
+    {
+    case IntegerKernel::Avx2:
+        return "AVX2";
+    case IntegerKernel::Avx512Bw:
+        return "AVX-512BW";
+    case IntegerKernel::Avx512Vnni:
+        return "AVX-512 VNNI";
+    default:
+        return "scalar";
+    }
+}
+
+/**
+ * @brief Tells whether the direct integer correlation is faster than `cv::matchTemplate` for a correlation.
+ *
+ * The integer kernels compute the correlation directly, so their cost grows with the template area times the
+ * number of map positions; they only beat the DFT-based `cv::matchTemplate` on small maps, such as the local
+ * searches around candidates, and never on whole scenes.
+ *
+ * @param[in] scene_size The size of the scene (or of the searched window).
+ * @param[in] template_size The size of the template.
+ * @return `true` if the integer correlation is expected to be faster, and the template is small enough for it.
+ */
+bool isIntegerCorrelationFaster(cv::Size scene_size, cv::Size template_size)
+{
+    const double positions = static_cast<double>(scene_size.width - template_size.width + 1) * (scene_size.height - template_size.height + 1);
+    return template_size.area() <= max_template_area && positions * template_size.area() <= max_direct_products;
+}
+
+/**
+ * @brief Computes the raw integer correlation of an 8-bit template over an 8-bit scene.
+ *
+ * The result at every valid position is the sum of scene * (template - 128) over the template window, computed
+ * exactly with 32-bit integer accumulation. Shifting the template makes it a signed byte, so the products can
+ * be accumulated by vpdpbusd; the shift is undone by `integerNormalizedCorrelation` with the window sums.
+ *
+ * @param[in] scene The `CV_8U` scene.
+ * @param[in] templ The `CV_8U` template, at most 65535 pixels.
+ * @param[in] kernel The kernel to use. It must be supported by the CPU.
+ * @return A `CV_32S` map of size (W - w + 1) x (H - h + 1), as returned by `cv::matchTemplate`.
+ *
+ * @throws std::invalid_argument If the inputs are not `CV_8U`, if the template is larger than the scene or than
+ *         65535 pixels, or if the kernel is not supported.
+ */
+cv::Mat correlateIntegers(const cv::Mat& scene, const cv::Mat& templ, IntegerKernel kernel)
+{
+    if (scene.type() != CV_8UC1 || templ.type() != CV_8UC1)
+        throw std::invalid_argument("The integer correlation needs 8-bit grayscale images.");
+    if (templ.cols > scene.cols || templ.rows > scene.rows)
+        throw std::invalid_argument("The template is larger than the scene.");
+    if (templ.total() > static_cast<size_t>(max_template_area))
+        throw std::invalid_argument("The template is too large for 32-bit integer accumulation.");
+    if (!isIntegerKernelSupported(kernel))
+        throw std::invalid_argument("The " + integerKernelName(kernel) + " integer kernel is not supported on this machine.");
+
+    cv::Mat result(scene.rows - templ.rows + 1, scene.cols - templ.cols + 1, CV_32S);
+
+    cv::Mat templ_s8;
+    templ.convertTo(templ_s8, CV_8S, 1.0, -128.0);
+
+#ifdef INTEGER_CORRELATION_X86
+    if (kernel == IntegerKernel::Avx2 || kernel == IntegerKernel::Avx512Bw)
+    {
+        // The widening kernels read the template already widened, once per template instead of once per position
+        cv::Mat templ_s16;
+        templ_s8.convertTo(templ_s16, CV_16S);
+
+        if (kernel == IntegerKernel::Avx2)
+            correlateAvx2(scene, templ_s16, result);
+        else
+            correlateAvx512Bw(scene, templ_s16, result);
+        return result;
+    }
+    if (kernel == IntegerKernel::Avx512Vnni)
+    {
+        correlateAvx512Vnni(scene, templ_s8, result);
+        return result;
+    }
+#endif
+
+    correlateScalar(scene, templ_s8, result);
+    return result;
+}
+
+/**
+ * @brief Computes the correlation of a prepared template with an 8-bit scene, with the fastest integer kernel.
+ *
+ * The 8-bit template is recovered from the prepared kernel (kernel plus mean) and its pixels outside the mask
+ * are set to 128, which the kernels shift to 0. As in `integerNormalizedCorrelation`, the correlation of the
+ * zero-mean kernel is then the integer correlation plus (128 - template mean) times the window sum of the scene.
+ *
+ * @param[in] scene The `CV_8U` scene, e.g. the window of a local search.
+ * @param[in] prepared_template The template, prepared from an 8-bit template (e.g. a template of the bank).
+ * @param[in] window_sum The sum of the scene over the template window, under the mask if any, at every position.
+ * @return The `CV_32F` correlation map, as returned by `cv::matchTemplate` with `cv::TM_CCORR` and the kernel.
+ *
+ * @see correlateIntegers
+ * @see correlateLocally
+ */
+cv::Mat integerKernelCorrelation(const cv::Mat& scene, const PreparedTemplate& prepared_template, const cv::Mat& window_sum)
+{
+    cv::Mat templ;
+    prepared_template.kernel.convertTo(templ, CV_8U, 1.0, prepared_template.mean);
+    if (!prepared_template.mask.empty())
+        templ.setTo(128, prepared_template.mask == 0);
+
+    cv::Mat correlation, scene_sum;
+    correlateIntegers(scene, templ, bestIntegerKernel()).convertTo(correlation, CV_64F);
+    window_sum.convertTo(scene_sum, CV_64F);
+    correlation += scene_sum * (128.0 - prepared_template.mean);
+    correlation.convertTo(correlation, CV_32F);
+    return correlation;
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of an 8-bit template with the fastest integer kernel.
+ *
+ * @param[in] scene The `CV_8U` scene.
+ * @param[in] templ The `CV_8U` template.
+ * @return The `CV_32F` normalized cross-correlation map, as returned by `cv::matchTemplate` with `cv::TM_CCOEFF_NORMED`.
+ *
+ * @see bestIntegerKernel
+ */
+cv::Mat integerNormalizedCorrelation(const cv::Mat& scene, const cv::Mat& templ)
+{
+    return integerNormalizedCorrelation(scene, templ, bestIntegerKernel());
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of an 8-bit template with an integer kernel.
+ *
+ * The numerator of the normalized cross-correlation is the correlation of the zero-mean template with the scene,
+ * i.e. the integer correlation with the shifted template plus (128 - template mean) times the window sum of the
+ * scene. The window sums and the normalization come from the integral images of the scene, as for the FFT engine.
+ *
+ * @param[in] scene The `CV_8U` scene.
+ * @param[in] templ The `CV_8U` template.
+ * @param[in] kernel The integer kernel to use.
+ * @return The `CV_32F` normalized cross-correlation map, as returned by `cv::matchTemplate` with `cv::TM_CCOEFF_NORMED`.
+ *
+ * @see correlateIntegers
+ * @see prepareTemplate
+ * @see windowSums
+ * @see normalizeCorrelation
+ */
+cv::Mat integerNormalizedCorrelation(const cv::Mat& scene, const cv::Mat& templ, IntegerKernel kernel)
+{
+    const cv::Mat raw_correlation = correlateIntegers(scene, templ, kernel);
+    const PreparedTemplate prepared_template = prepareTemplate(templ);
+
+    cv::Mat integral_sum, integral_sqsum;
+    cv::integral(scene, integral_sum, integral_sqsum, CV_64F, CV_64F);
+
+    cv::Mat correlation;
+    raw_correlation.convertTo(correlation, CV_64F);
+    correlation += windowSums(integral_sum, templ.size(), raw_correlation.size()) * (128.0 - prepared_template.mean);
+    correlation.convertTo(correlation, CV_32F);
+
+    return normalizeCorrelation(correlation, integral_sum, integral_sqsum, templ.size(), prepared_template.norm);
+}
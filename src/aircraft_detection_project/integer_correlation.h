@@ -0,0 +1,30 @@
+#pragma once
+
+#include "fft_correlation.h"
+#include <opencv2/opencv.hpp>
+#include <string>
+
+
+enum class IntegerKernel
+{
+    Scalar,     // portable C++ loops
+    Avx2,       // 16 products per instruction, 8-bit inputs widened to 16-bit (vpmaddwd)
+    Avx512Bw,   // 32 products per instruction, 8-bit inputs widened to 16-bit (vpmaddwd)
+    Avx512Vnni  // 64 products per instruction, straight on 8-bit inputs (vpdpbusd)
+};
+
+IntegerKernel bestIntegerKernel();
+
+bool isIntegerKernelSupported(IntegerKernel kernel);
+
+std::string integerKernelName(IntegerKernel kernel);
+
+bool isIntegerCorrelationFaster(cv::Size scene_size, cv::Size template_size);
+
+cv::Mat correlateIntegers(const cv::Mat& scene, const cv::Mat& templ, IntegerKernel kernel);
+
+cv::Mat integerKernelCorrelation(const cv::Mat& scene, const PreparedTemplate& prepared_template, const cv::Mat& window_sum);
+
+cv::Mat integerNormalizedCorrelation(const cv::Mat& scene, const cv::Mat& templ);
+
+cv::Mat integerNormalizedCorrelation(const cv::Mat& scene, const cv::Mat& templ, IntegerKernel kernel);
@@ -0,0 +1,361 @@
+#include "linear_svm.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LINEAR_SVM_X86
+#include <immintrin.h>
+#endif
+
+// As in integer_correlation.cpp, only the kernels are compiled for the wider instruction sets
+#if defined(__GNUC__) || defined(__clang__)
+#define LINEAR_SVM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define LINEAR_SVM_TARGET(isa)
+#endif
+
+
+namespace
+{
+    using DotProductKernel = float (*)(const float*, const float*, size_t);
+
+    float dotProductScalar(const float* first, const float* second, size_t length)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < length; i++)
+            sum += first[i] * second[i];
+        return sum;
+    }
+
+#ifdef LINEAR_SVM_X86
+    LINEAR_SVM_TARGET("avx2,fma")
+    float dotProductAvx2(const float* first, const float* second, size_t length)
+    {
+        // Two accumulators hide the latency of the fused multiply-adds
+        __m256 first_sum = _mm256_setzero_ps();
+        __m256 second_sum = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= length; i += 16)
+        {
+            first_sum = _mm256_fmadd_ps(_mm256_loadu_ps(first + i), _mm256_loadu_ps(second + i), first_sum);
+            second_sum = _mm256_fmadd_ps(_mm256_loadu_ps(first + i + 8), _mm256_loadu_ps(second + i + 8), second_sum);
+        }
+        for (; i + 8 <= length; i += 8)
+            first_sum = _mm256_fmadd_ps(_mm256_loadu_ps(first + i), _mm256_loadu_ps(second + i), first_sum);
+
+        const __m256 sum = _mm256_add_ps(first_sum, second_sum);
+        __m128 half_sum = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        half_sum = _mm_add_ps(half_sum, _mm_movehl_ps(half_sum, half_sum));
+        half_sum = _mm_add_ss(half_sum, _mm_movehdup_ps(half_sum));
+
+        float tail_sum = 0.0f;
+        for (; i < length; i++)
+            tail_sum += first[i] * second[i];
+        return _mm_cvtss_f32(half_sum) + tail_sum;
+    }
+
+    LINEAR_SVM_TARGET("avx512f")
+    float dotProductAvx512(const float* first, const float* second, size_t length)
+    {
+        __m512 sum = _mm512_setzero_ps();
+
+        // The last, partial block is read with a mask, so no scalar tail is needed
+        for (size_t i = 0; i < length; i += 16)
+        {
+            const size_t remaining = length - i;
+            const __mmask16 lanes = remaining >= 16 ? __mmask16(0xFFFF) : static_cast<__mmask16>((1u << remaining) - 1);
+            sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(lanes, first + i), _mm512_maskz_loadu_ps(lanes, second + i), sum);
+        }
+        return _mm512_reduce_add_ps(sum);
+    }
+#endif
+
+    struct DotProductDispatch
+    {
+        DotProductKernel kernel;
+        const char* name;
+    };
+
+    /*
+     * Selects the widest kernel supported by the CPU, once: the dot product is called for every candidate
+     * window, so the check must not be repeated per call.
+     */
+    const DotProductDispatch& dotProductDispatch()
+    {
+        static const DotProductDispatch dispatch = []() -> DotProductDispatch
+        {
+#ifdef LINEAR_SVM_X86
+            if (cv::checkHardwareSupport(CV_CPU_AVX_512F))
+                return { dotProductAvx512, "AVX-512" };
+            if (cv::checkHardwareSupport(CV_CPU_AVX2) && cv::checkHardwareSupport(CV_CPU_FMA3))
+                return { dotProductAvx2, "AVX2" };
+#endif
+            return { dotProductScalar, "scalar" };
+        }();
+        return dispatch;
+    }
+}
+
+
+
+/**
+ * @brief Returns the process-wide SVM training options, set from the command line.
+ */
+LinearSvmTrainingOptions& svmTrainingOptions()
+{
+    static LinearSvmTrainingOptions options;
+    return options;
+}
+
+/**
+ * @brief Trains a linear SVM (hinge loss) with dual coordinate descent.
+ *
+ * The solver is the dual coordinate descent of LIBLINEAR, without shrinking: every pass visits the samples in
+ * random order and solves the dual problem for one sample at a time in closed form, updating the weights
+ * incrementally. The bias is learned as the weight of an extra feature equal to 1. The cost of each class is
+ * scaled by the inverse of its frequency, so that the rare true positives weigh as much as the many false
+ * positives. Training stops when the projected gradient is within the tolerance, or after the maximum number
+ * of passes.
+ *
+ * @param[in] samples The `CV_32F` training samples, one per row.
+ * @param[in] labels The label of every sample: +1 (positive) or -1 (negative).
+ * @param[in] options The training options (cost, tolerance, maximum number of passes).
+ * @return The trained linear SVM.
+ *
+ * @throws std::invalid_argument If the samples are not `CV_32F`, if the labels do not match them, or if a class
+ *         has no sample.
+ *
+ * @see dotProduct
+ */
+LinearSvm trainLinearSvm(const cv::Mat& samples, const std::vector<int>& labels, const LinearSvmTrainingOptions& options)
+{
+    std::vector<int> sample_indices(samples.rows);
+    std::iota(sample_indices.begin(), sample_indices.end(), 0);
+    return trainLinearSvm(samples, labels, sample_indices, options);
+}
+
+/**
+ * @brief Trains a linear SVM on a subset of the samples, without copying them.
+ *
+ * The solver reads the rows of the subset in place, so the cross-validation folds share the training
+ * matrix instead of each gathering its own copy.
+ *
+ * @param[in] samples The `CV_32F` samples, one per row.
+ * @param[in] labels The label of every sample: +1 (positive) or -1 (negative).
+ * @param[in] sample_indices The rows of the samples to train on.
+ * @param[in] options The training options (cost, tolerance, maximum number of passes).
+ * @return The trained linear SVM.
+ *
+ * @throws std::invalid_argument If the samples are not `CV_32F`, if the labels do not match them, if an index is
+ *         out of range, or if a class has no sample in the subset.
+ *
+ * @see dotProduct
+ */
+LinearSvm trainLinearSvm(const cv::Mat& samples, const std::vector<int>& labels, const std::vector<int>& sample_indices, const LinearSvmTrainingOptions& options)
+{
+    if (samples.type() != CV_32F || samples.rows != static_cast<int>(labels.size()))
+        throw std::invalid_argument("The SVM training needs one CV_32F sample per label.");
+    if (std::any_of(sample_indices.begin(), sample_indices.end(), [&samples](int index) { return index < 0 || index >= samples.rows; }))
+        throw std::invalid_argument("The SVM training samples are out of range.");
+
+    const auto num_positives = std::count_if(sample_indices.begin(), sample_indices.end(), [&labels](int index) { return labels[index] == 1; });
+    const auto num_negatives = static_cast<std::ptrdiff_t>(sample_indices.size()) - num_positives;
+    if (num_positives == 0 || num_negatives == 0)
+        throw std::invalid_argument("The SVM training needs both positive and negative samples.");
+
+    const int num_samples = static_cast<int>(sample_indices.size());
+    const size_t num_features = static_cast<size_t>(samples.cols);
+    const double positive_cost = options.c * num_samples / (2.0 * num_positives);
+    const double negative_cost = options.c * num_samples / (2.0 * num_negatives);
+
+    // Diagonal of the dual Hessian, including the constant bias feature
+    std::vector<double> squared_norms(num_samples);
+    for (int i = 0; i < num_samples; i++)
+        squared_norms[i] = dotProduct(samples.ptr<float>(sample_indices[i]), samples.ptr<float>(sample_indices[i]), num_features) + 1.0;
+
+    LinearSvm svm;
+    svm.weights.assign(num_features, 0.0f);
+    std::vector<double> alphas(num_samples, 0.0);
+    std::vector<int> order(num_samples);
+    std::iota(order.begin(), order.end(), 0);
+
+    // A fixed seed keeps the training reproducible
+    std::mt19937 generator(0);
+    for (int iteration = 0; iteration < options.max_iterations; iteration++)
+    {
+        std::shuffle(order.begin(), order.end(), generator);
+
+        double max_projected_gradient = -std::numeric_limits<double>::infinity();
+        double min_projected_gradient = std::numeric_limits<double>::infinity();
+        for (const int i : order)
+        {
+            const float* sample = samples.ptr<float>(sample_indices[i]);
+            const int label = labels[sample_indices[i]];
+            const double cost = label > 0 ? positive_cost : negative_cost;
+
+            const double gradient = label * (dotProduct(svm.weights.data(), sample, num_features) + svm.bias) - 1.0;
+            double projected_gradient = gradient;
+            if (alphas[i] == 0.0)
+                projected_gradient = std::min(gradient, 0.0);
+            else if (alphas[i] == cost)
+                projected_gradient = std::max(gradient, 0.0);
+
+            max_projected_gradient = std::max(max_projected_gradient, projected_gradient);
+            min_projected_gradient = std::min(min_projected_gradient, projected_gradient);
+            if (projected_gradient == 0.0)
+                continue;
+
+            const double previous_alpha = alphas[i];
+            alphas[i] = std::clamp(alphas[i] - gradient / squared_norms[i], 0.0, cost);
+            const float step = static_cast<float>((alphas[i] - previous_alpha) * label);
+            for (size_t j = 0; j < num_features; j++)
+                svm.weights[j] += step * sample[j];
+            svm.bias += step;
+        }
+
+        if (max_projected_gradient - min_projected_gradient <= options.tolerance)
+            break;
+    }
+    return svm;
+}
+
+/**
+ * @brief Estimates the memory used by the training of a linear SVM, besides the samples it reads in place.
+ *
+ * @param[in] num_samples The number of training samples.
+ * @param[in] num_features The number of features of a sample.
+ * @return The estimated memory, in bytes, of the solver state: the dual variables, the squared norms and the
+ *         visit order of the samples, and the weights.
+ *
+ * @see trainLinearSvm
+ */
+size_t linearSvmTrainingMemory(size_t num_samples, size_t num_features)
+{
+    return num_samples * (2 * sizeof(double) + 2 * sizeof(int)) + num_features * sizeof(float);
+}
+
+/**
+ * @brief Loads a linear SVM model.
+ *
+ * The model is a `cv::FileStorage` file (YAML or XML) holding the weights as a 1 x N `CV_32F` matrix named
+ * "weights" and the bias as a real number named "bias", as written by `saveLinearSvm`.
+ *
+ * @param[in] path The path of the model file.
+ * @return The linear SVM.
+ *
+ * @throws std::runtime_error If the file cannot be opened or does not hold a valid model.
+ *
+ * @see saveLinearSvm
+ */
+LinearSvm loadLinearSvm(const std::filesystem::path& path)
+{
+    cv::FileStorage file(path.string(), cv::FileStorage::READ);
+    if (!file.isOpened())
+        throw std::runtime_error("Cannot open the SVM model " + path.string());
+
+    cv::Mat weights;
+    file["weights"] >> weights;
+    if (weights.empty() || weights.type() != CV_32F || (weights.rows != 1 && weights.cols != 1))
+        throw std::runtime_error("The SVM model " + path.string() + " has no valid weight vector.");
+
+    LinearSvm svm;
+    svm.weights.assign(weights.ptr<float>(), weights.ptr<float>() + weights.total());
+    svm.bias = static_cast<float>(static_cast<double>(file["bias"]));
+    return svm;
+}
+
+/**
+ * @brief Saves a linear SVM model, in the format read by `loadLinearSvm`.
+ *
+ * @param[in] svm The linear SVM.
+ * @param[in] path The path of the model file; its extension (.yml or .xml) selects the format.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ *
+ * @see loadLinearSvm
+ */
+void saveLinearSvm(const LinearSvm& svm, const std::filesystem::path& path)
+{
+    cv::FileStorage file(path.string(), cv::FileStorage::WRITE);
+    if (!file.isOpened())
+        throw std::runtime_error("Cannot write the SVM model " + path.string());
+
+    file << "weights" << cv::Mat(1, static_cast<int>(svm.weights.size()), CV_32F, const_cast<float*>(svm.weights.data()));
+    file << "bias" << static_cast<double>(svm.bias);
+}
+
+/**
+ * @brief Returns the default path of the linear SVM model.
+ */
+std::filesystem::path linearSvmPath()
+{
+    return std::filesystem::path(SRC_DIR_PATH) / "svm_model" / "linear_svm.yml";
+}
+
+/**
+ * @brief Returns the printable name of the dot product kernel selected for this CPU.
+ */
+std::string dotProductKernelName()
+{
+    return dotProductDispatch().name;
+}
+
+/**
+ * @brief Computes the dot product of two float vectors with the widest SIMD kernel supported by the CPU.
+ *
+ * The kernel (AVX-512, AVX2 with FMA or scalar) is detected once at runtime, so the binary runs on any x86 CPU.
+ *
+ * @param[in] first The first vector.
+ * @param[in] second The second vector.
+ * @param[in] length The number of elements of both vectors.
+ * @return The dot product.
+ */
+float dotProduct(const float* first, const float* second, size_t length)
+{
+    return dotProductDispatch().kernel(first, second, length);
+}
+
+/**
+ * @brief Computes the decision value of a linear SVM on a feature vector.
+ *
+ * @param[in] svm The linear SVM.
+ * @param[in] features The feature vector, with as many features as the SVM has weights.
+ * @return The decision value, positive on the side of the positive class.
+ *
+ * @throws std::invalid_argument If the number of features does not match the SVM.
+ *
+ * @see dotProduct
+ */
+float svmScore(const LinearSvm& svm, const std::vector<float>& features)
+{
+    if (features.size() != svm.weights.size())
+        throw std::invalid_argument("The feature vector has " + std::to_string(features.size()) + " features, the SVM expects " + std::to_string(svm.weights.size()) + ".");
+
+    return dotProduct(svm.weights.data(), features.data(), features.size()) + svm.bias;
+}
+
+/**
+ * @brief Computes the decision values of a linear SVM on a matrix of samples.
+ *
+ * @param[in] svm The linear SVM.
+ * @param[in] samples The `CV_32F` samples, one per row, with as many columns as the SVM has weights.
+ * @return The decision value of every sample.
+ *
+ * @throws std::invalid_argument If the samples do not match the SVM.
+ *
+ * @see dotProduct
+ */
+std::vector<float> svmScores(const LinearSvm& svm, const cv::Mat& samples)
+{
+    if (samples.type() != CV_32F || samples.cols != static_cast<int>(svm.weights.size()))
+        throw std::invalid_argument("The samples do not match the SVM.");
+
+    std::vector<float> scores(samples.rows);
+    for (int i = 0; i < samples.rows; i++)
+        scores[i] = dotProduct(svm.weights.data(), samples.ptr<float>(i), svm.weights.size()) + svm.bias;
+    return scores;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+struct LinearSvm
+{
+    std::vector<float> weights; // one weight per feature
+    float bias = 0.0f;          // score = weights . features + bias
+};
+
+struct LinearSvmTrainingOptions
+{
+    double c = 1.0;            // cost of the margin violations
+    double tolerance = 0.1;    // stopping tolerance on the projected gradient
+    int max_iterations = 1000; // passes over the training samples
+    int num_folds = 5;         // folds of the cross-validation
+};
+
+LinearSvmTrainingOptions& svmTrainingOptions();
+
+LinearSvm trainLinearSvm(const cv::Mat& samples, const std::vector<int>& labels, const LinearSvmTrainingOptions& options);
+
+LinearSvm trainLinearSvm(const cv::Mat& samples, const std::vector<int>& labels, const std::vector<int>& sample_indices, const LinearSvmTrainingOptions& options);
+
+size_t linearSvmTrainingMemory(size_t num_samples, size_t num_features);
+
+LinearSvm loadLinearSvm(const std::filesystem::path& path);
+
+void saveLinearSvm(const LinearSvm& svm, const std::filesystem::path& path);
+
+std::filesystem::path linearSvmPath();
+
+std::string dotProductKernelName();
+
+float dotProduct(const float* first, const float* second, size_t length);
+
+float svmScore(const LinearSvm& svm, const std::vector<float>& features);
+
+std::vector<float> svmScores(const LinearSvm& svm, const cv::Mat& samples);
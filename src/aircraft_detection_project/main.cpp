@@ -8,7 +8,16 @@ int main(int argc, char** argv)
 {
     // Parse the command line arguments into steps
     std::vector<std::string> steps;
-    parseArguments(argc, argv, steps);
+    try
+    {
+        parseArguments(argc, argv, steps);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error parsing arguments: " << e.what() << "\n";
+        printHelp();
+        return 1;
+    }
 
     // If no steps are provided, print the help message and exit
     if (steps.empty())
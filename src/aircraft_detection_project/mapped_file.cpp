@@ -0,0 +1,102 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+
+/**
+ * @brief Maps a whole file in memory.
+ *
+ * The mapping is private (copy-on-write): the mapped pages can be written, but the changes are never
+ * written back to the file. The pages are only read from disk when first accessed, so opening a large
+ * file is immediate.
+ *
+ * @param[in] path The path of the file to map.
+ *
+ * @throws std::runtime_error If the file cannot be opened or mapped.
+ */
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        file_handle = nullptr;
+        throw std::runtime_error("Could not open file " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_handle, &size))
+    {
+        CloseHandle(file_handle);
+        throw std::runtime_error("Could not read the size of file " + path);
+    }
+    file_size = static_cast<size_t>(size.QuadPart);
+    if (file_size == 0)
+        return;
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (mapping_handle != nullptr)
+        address = MapViewOfFile(mapping_handle, FILE_MAP_COPY, 0, 0, 0);
+
+    if (address == nullptr)
+    {
+        if (mapping_handle != nullptr)
+            CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        throw std::runtime_error("Could not map file " + path);
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Could not open file " + path);
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Could not read the size of file " + path);
+    }
+    file_size = static_cast<size_t>(file_stat.st_size);
+    if (file_size == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    void* mapped = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Could not map file " + path);
+
+    address = mapped;
+#endif
+}
+
+/**
+ * @brief Unmaps the file.
+ */
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (address != nullptr)
+        UnmapViewOfFile(address);
+    if (mapping_handle != nullptr)
+        CloseHandle(mapping_handle);
+    if (file_handle != nullptr)
+        CloseHandle(file_handle);
+#else
+    if (address != nullptr)
+        munmap(address, file_size);
+#endif
+}
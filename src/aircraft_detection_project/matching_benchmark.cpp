@@ -0,0 +1,625 @@
+#include "matching_benchmark.h"
+
+#include "dense_hog.h"
+#include "detection.h"
+#include "hog_features_extraction.h"
+#include "hog_kernel.h"
+#include "fft_correlation.h"
+#include "integer_correlation.h"
+#include "rotation_cache.h"
+#include "separable_correlation.h"
+#include "template_bank.h"
+#include "template_matching.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+
+
+/**
+ * @brief Measures the wall-clock time of a callable.
+ *
+ * @param[in] function The callable to run, without arguments.
+ * @return The elapsed time, in milliseconds.
+ */
+template<typename F>
+double elapsedMs(F&& function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Computes the fraction of reference matches recovered by another set of matches.
+ *
+ * The reference matches are sorted by descending score and only the best ones are considered, as many as
+ * the matches under test: a reference match is recovered if a match under test lies within `tolerance`
+ * pixels of it.
+ *
+ * @param[in] reference_matches The matches of the exhaustive search.
+ * @param[in] matches The matches under test.
+ * @param[in] tolerance The maximum distance, in pixels, between two matches to be considered the same.
+ * @return The fraction of the best reference matches that are recovered, in [0, 1].
+ */
+double matchAgreement(std::vector<TemplateMatch> reference_matches, const std::vector<TemplateMatch>& matches, double tolerance)
+{
+    std::sort(reference_matches.begin(), reference_matches.end(), [](const TemplateMatch& a, const TemplateMatch& b)
+    {
+        return a.score > b.score;
+    });
+
+    const size_t num_compared = std::min(reference_matches.size(), matches.size());
+    if (num_compared == 0)
+        return matches.empty() && reference_matches.empty() ? 1.0 : 0.0;
+
+    size_t recovered = 0;
+    for (size_t i = 0; i < num_compared; i++)
+    {
+        const auto& reference_center = reference_matches[i].center;
+        const bool found = std::any_of(matches.begin(), matches.end(), [&](const TemplateMatch& match)
+        {
+            return cv::norm(match.center - reference_center) <= tolerance;
+        });
+
+        if (found)
+            recovered++;
+    }
+    return static_cast<double>(recovered) / num_compared;
+}
+
+/**
+ * @brief Validates the integer correlation kernels against `cv::matchTemplate` on a scene.
+ *
+ * Every upright template is correlated with the scene by `cv::matchTemplate` (`cv::TM_CCOEFF_NORMED`, float)
+ * and by every integer kernel supported by the CPU. The function reports, for every kernel, the total time,
+ * the speedup over the float correlation and the largest score difference. The same timings are reported on
+ * windows of the scene giving 17x17 maps, as the local searches do, where the direct kernels can win. Finally,
+ * the local searches themselves (`correlateLocally`) are run on such windows with every rotated template of the
+ * bank, with the float and with the integer correlation.
+ *
+ * @param[in] img The grayscale scene.
+ *
+ * @see integerNormalizedCorrelation
+ * @see isIntegerKernelSupported
+ * @see isIntegerCorrelationFaster
+ * @see correlateLocally
+ */
+void validateIntegerCorrelation(const cv::Mat& img)
+{
+    const auto& templates = sharedTemplateBank(templateMatchingOptions().angle_step)->templates();
+
+    std::vector<cv::Mat> float_results(templates.size());
+    double float_ms = 0.0;
+    for (size_t i = 0; i < templates.size(); i++)
+        float_ms += elapsedMs([&]() { cv::matchTemplate(img, templates[i], float_results[i], cv::TM_CCOEFF_NORMED); });
+
+    // Windows centered in the scene, 16 pixels larger than the templates
+    constexpr int window_margin = 16;
+    std::vector<cv::Mat> windows(templates.size());
+    double float_window_ms = 0.0;
+    for (size_t i = 0; i < templates.size(); i++)
+    {
+        const cv::Size window_size(templates[i].cols + window_margin, templates[i].rows + window_margin);
+        if (window_size.width > img.cols || window_size.height > img.rows)
+            continue;
+
+        windows[i] = img(cv::Rect(cv::Point((img.cols - window_size.width) / 2, (img.rows - window_size.height) / 2), window_size));
+        cv::Mat window_result;
+        float_window_ms += elapsedMs([&]() { cv::matchTemplate(windows[i], templates[i], window_result, cv::TM_CCOEFF_NORMED); });
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "float correlation (cv::matchTemplate): " << float_ms << " ms, "
+        << std::setprecision(3) << float_window_ms << " ms on the local windows\n";
+
+    for (auto kernel : { IntegerKernel::Scalar, IntegerKernel::Avx2, IntegerKernel::Avx512Bw, IntegerKernel::Avx512Vnni })
+    {
+        if (!isIntegerKernelSupported(kernel))
+            continue;
+
+        double kernel_ms = 0.0;
+        double max_difference = 0.0;
+        for (size_t i = 0; i < templates.size(); i++)
+        {
+            cv::Mat integer_result;
+            kernel_ms += elapsedMs([&]() { integer_result = integerNormalizedCorrelation(img, templates[i], kernel); });
+            max_difference = std::max(max_difference, cv::norm(integer_result, float_results[i], cv::NORM_INF));
+        }
+
+        double kernel_window_ms = 0.0;
+        for (size_t i = 0; i < templates.size(); i++)
+        {
+            if (!windows[i].empty())
+                kernel_window_ms += elapsedMs([&]() { integerNormalizedCorrelation(windows[i], templates[i], kernel); });
+        }
+
+        std::cout << std::fixed << std::setprecision(2)
+            << integerKernelName(kernel) << " integer correlation: " << kernel_ms << " ms, "
+            << "speedup " << float_ms / std::max(kernel_ms, 1e-3) << "x, "
+            << std::setprecision(3) << kernel_window_ms << " ms on the local windows, "
+            << std::setprecision(2) << "speedup " << float_window_ms / std::max(kernel_window_ms, 1e-3) << "x, "
+            << std::setprecision(6) << "max score difference " << max_difference << "\n";
+    }
+
+    const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(templateMatchingOptions().angle_step);
+    double local_float_ms = 0.0, local_integer_ms = 0.0, local_max_difference = 0.0;
+    for (size_t i = 0; i < bank->rotatedTemplates().size(); i++)
+    {
+        const cv::Size template_size = bank->rotatedTemplates()[i].image.size();
+        const cv::Size window_size(template_size.width + window_margin, template_size.height + window_margin);
+        if (window_size.width > img.cols || window_size.height > img.rows)
+            continue;
+
+        const cv::Mat window = img(cv::Rect(cv::Point((img.cols - window_size.width) / 2, (img.rows - window_size.height) / 2), window_size));
+        cv::Mat float_result, integer_result;
+        local_float_ms += elapsedMs([&]() { float_result = correlateLocally(window, bank->preparedTemplates()[i]); });
+        local_integer_ms += elapsedMs([&]() { integer_result = correlateLocally(window, bank->preparedTemplates()[i], true); });
+        local_max_difference = std::max(local_max_difference, cv::norm(integer_result, float_result, cv::NORM_INF));
+    }
+
+    std::cout << std::fixed << std::setprecision(3) << "local searches of the rotated templates: float " << local_float_ms << " ms, "
+        << integerKernelName(bestIntegerKernel()) << " integer " << local_integer_ms << " ms, "
+        << std::setprecision(2) << "speedup " << local_float_ms / std::max(local_integer_ms, 1e-3) << "x, "
+        << std::setprecision(6) << "max score difference " << local_max_difference << "\n";
+}
+
+/**
+ * @brief Reports the accuracy and the speed of the separable approximation of every template.
+ *
+ * Every upright template is decomposed with the energy threshold of the process-wide options. For every template
+ * the function reports the number of separable components, the relative reconstruction error, the time of the
+ * dense correlation (`cv::matchTemplate`) and of the separable one on the scene, the speedup and the largest
+ * score difference.
+ *
+ * @param[in] img The grayscale scene.
+ *
+ * @see decomposeTemplate
+ * @see separableNormalizedCorrelation
+ */
+void reportSeparableApproximation(const cv::Mat& img)
+{
+    const auto& templates = sharedTemplateBank(templateMatchingOptions().angle_step)->templates();
+    const double energy_threshold = templateMatchingOptions().separable_energy;
+
+    for (size_t i = 0; i < templates.size(); i++)
+    {
+        const SeparableTemplate separable_template = decomposeTemplate(templates[i], energy_threshold);
+
+        cv::Mat dense_result, separable_result;
+        const double dense_ms = elapsedMs([&]() { cv::matchTemplate(img, templates[i], dense_result, cv::TM_CCOEFF_NORMED); });
+        const double separable_ms = elapsedMs([&]() { separable_result = separableNormalizedCorrelation(img, separable_template); });
+
+        std::cout << std::fixed << std::setprecision(2)
+            << "template " << i << " (" << templates[i].cols << "x" << templates[i].rows << "): "
+            << separable_template.row_filters.size() << " separable components, "
+            << std::setprecision(4) << "reconstruction error " << 100.0 * separable_template.reconstruction_error << "%, "
+            << std::setprecision(2) << "dense " << dense_ms << " ms, separable " << separable_ms << " ms, "
+            << "speedup " << dense_ms / std::max(separable_ms, 1e-3) << "x, "
+            << std::setprecision(6) << "max score difference " << cv::norm(separable_result, dense_result, cv::NORM_INF) << "\n";
+    }
+}
+
+/**
+ * @brief Validates the FFT engine against masked `cv::matchTemplate` on a scene, and times it for one angle.
+ *
+ * The rotated templates of the bank at one angle off the quarter turns (masked) are correlated with the scene
+ * by the FFT engine, mask group by mask group as the matching tasks do, and by `cv::matchTemplate` with their
+ * mask. The function reports the largest score difference on the non-flat windows, then the time of the angle
+ * for the FFT engine (with the spectrum cache empty and filled), for the rotate-templates correlation and for
+ * the rotate-scene correlation (scene warp and upright templates).
+ *
+ * @param[in] img The grayscale scene.
+ *
+ * @note The scene transforms of the FFT engine, shared by all the angles, are timed separately.
+ *
+ * @see FftCorrelator
+ * @see TemplateBank::maskGroups
+ * @see TemplateBank::useSpectrumCache
+ */
+void validateFftCorrelation(const cv::Mat& img)
+{
+    const TemplateMatchingOptions& options = templateMatchingOptions();
+    const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(options.angle_step);
+    const auto& rotated_templates = bank->rotatedTemplates();
+    const auto& prepared_templates = bank->preparedTemplates();
+
+    // First angle of the bank (of at least 45 degrees) that is not a quarter turn, so the templates are masked
+    int degree_angle = rotated_templates.front().degree_angle;
+    for (const auto& rotated_template : rotated_templates)
+    {
+        if (rotated_template.degree_angle >= 45 && rotated_template.degree_angle % 90 != 0)
+        {
+            degree_angle = rotated_template.degree_angle;
+            break;
+        }
+    }
+
+    std::vector<size_t> angle_groups;
+    for (size_t group = 0; group < bank->maskGroups().size(); group++)
+    {
+        const size_t first_index = bank->maskGroups()[group].front();
+        const cv::Mat& rotated_image = rotated_templates[first_index].image;
+        if (rotated_templates[first_index].degree_angle == degree_angle && rotated_image.cols <= img.cols && rotated_image.rows <= img.rows)
+            angle_groups.push_back(group);
+    }
+
+    std::unique_ptr<FftCorrelator> correlator;
+    const double scene_ms = elapsedMs([&]() { correlator = std::make_unique<FftCorrelator>(img); });
+    const cv::Size dft_size = correlator->dftSize();
+
+    std::vector<cv::Mat> fft_results(rotated_templates.size());
+    auto fft_angle = [&]()
+    {
+        for (auto group : angle_groups)
+        {
+            const std::vector<size_t>& bank_indices = bank->maskGroups()[group];
+            const size_t first_index = bank_indices.front();
+            const cv::Size window_size = rotated_templates[first_index].image.size();
+            const cv::Mat& mask = prepared_templates[first_index].mask;
+            const cv::Mat window_norms = mask.empty()
+                ? correlator->windowNorms(window_size)
+                : correlator->windowNorms(window_size, bank->maskSpectrum(group, dft_size), cv::sum(mask)[0]);
+
+            for (auto bank_index : bank_indices)
+                fft_results[bank_index] = correlator->correlate(bank->kernelSpectrum(bank_index, dft_size), window_size, window_norms, prepared_templates[bank_index].norm);
+        }
+    };
+    bank->useSpectrumCache(dft_size, options.spectrum_cache_mb << 20);
+    const double fft_ms = elapsedMs(fft_angle);
+    const double fft_cached_ms = elapsedMs(fft_angle);
+
+    double templates_ms = 0.0;
+    double max_difference = 0.0;
+    for (auto group : angle_groups)
+    {
+        for (auto bank_index : bank->maskGroups()[group])
+        {
+            const RotatedTemplate& rotated_template = rotated_templates[bank_index];
+            cv::Mat masked_result;
+            templates_ms += elapsedMs([&]() { cv::matchTemplate(img, rotated_template.image, masked_result, cv::TM_CCOEFF_NORMED, rotated_template.mask); });
+
+            // cv::matchTemplate leaves the flat windows undefined, the FFT engine scores them 0
+            const cv::Mat valid = (cv::abs(masked_result) <= 1.5) & (fft_results[bank_index] != 0);
+            cv::Mat difference;
+            cv::absdiff(masked_result, fft_results[bank_index], difference);
+            double bank_max_difference = 0.0;
+            cv::minMaxLoc(difference, nullptr, &bank_max_difference, nullptr, nullptr, valid);
+            max_difference = std::max(max_difference, bank_max_difference);
+        }
+    }
+
+    double scene_rotation_ms = 0.0;
+    {
+        const auto& templates = bank->templates();
+        scene_rotation_ms = elapsedMs([&]() {
+            const cv::Mat rotated_img = rotateImage(img, degree_angle);
+            for (const auto& upright_template : templates)
+            {
+                cv::Mat result;
+                cv::matchTemplate(rotated_img, upright_template, result, cv::TM_CCOEFF_NORMED);
+            }
+            });
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << "fft correlation at " << degree_angle << " degrees: "
+        << fft_ms << " ms (" << fft_cached_ms << " ms with the cached spectra, plus " << scene_ms << " ms of scene transforms shared by all the angles), "
+        << "rotate-templates " << templates_ms << " ms, rotate-scene " << scene_rotation_ms << " ms, "
+        << std::setprecision(6) << "max score difference to masked cv::matchTemplate " << max_difference << "\n";
+}
+
+/**
+ * @brief Benchmarks the selected template matching mode against the exhaustive FFT search.
+ *
+ * This function runs both the exhaustive search (`MatchingMode::Fft`, full resolution, untiled, every angle, no
+ * proposals, no deadline, no pruning) and the mode selected by the process-wide options on the first training images. For
+ * every image it reports the matching times, the speedup and the fraction of the best exhaustive matches
+ * recovered within `match_tolerance` pixels, and, with a deadline, the coverage of the anytime search. The
+ * integer correlation kernels and the separable approximations are also compared to the float correlation, and
+ * the FFT engine to the masked one, on the first image.
+ *
+ * @param[in] num_images The number of training images to use.
+ *
+ * @see findTemplateMatches
+ * @see anytimeTemplateMatching
+ * @see matchAgreement
+ * @see validateIntegerCorrelation
+ * @see reportSeparableApproximation
+ * @see validateFftCorrelation
+ */
+void benchmarkTemplateMatching(int num_images)
+{
+    std::vector<std::string> dataset_img_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.jpg", dataset_img_paths);
+    if (dataset_img_paths.size() > static_cast<size_t>(num_images))
+        dataset_img_paths.resize(num_images);
+
+    const TemplateMatchingOptions& options = templateMatchingOptions();
+    TemplateMatchingOptions reference_options = options;
+    reference_options.mode = MatchingMode::Fft;
+    reference_options.tile_size = 0;
+    reference_options.proposal_method = ProposalMethod::None;
+    reference_options.deadline_ms = 0.0;
+    reference_options.pruning_recall = 0.0;
+
+    auto timed_matching = [](const cv::Mat& img, const TemplateMatchingOptions& matching_options, double& elapsed_ms)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<TemplateMatch> matches = findTemplateMatches(img, matching_options);
+        elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return matches;
+    };
+
+    bool backends_validated = false;
+    for (const auto& img_path : dataset_img_paths)
+    {
+        const cv::Mat img = cv::imread(img_path, cv::IMREAD_GRAYSCALE);
+        if (img.empty())
+            continue;
+
+        if (!backends_validated)
+        {
+            validateIntegerCorrelation(img);
+            reportSeparableApproximation(img);
+            validateFftCorrelation(img);
+            backends_validated = true;
+        }
+
+        double reference_ms = 0.0, mode_ms = 0.0;
+        const auto reference_matches = timed_matching(img, reference_options, reference_ms);
+
+        // With a deadline, the selected run is the anytime search, whose coverage is reported as well
+        std::vector<TemplateMatch> matches;
+        MatchingCoverage coverage;
+        if (options.deadline_ms > 0)
+        {
+            mode_ms = elapsedMs([&]() {
+                AnytimeMatchingResult result = anytimeTemplateMatching(img, options.deadline_ms, options);
+                matches = std::move(result.matches);
+                coverage = result.coverage;
+                });
+        }
+        else
+        {
+            matches = timed_matching(img, options, mode_ms);
+        }
+
+        std::cout << std::fixed << std::setprecision(2)
+            << std::filesystem::path(img_path).filename().string() << ": "
+            << "exhaustive " << reference_ms << " ms (" << reference_matches.size() << " matches), "
+            << "selected mode " << mode_ms << " ms (" << matches.size() << " matches), "
+            << "speedup " << reference_ms / std::max(mode_ms, 1e-3) << "x, "
+            << "agreement within " << options.match_tolerance << " px: "
+            << 100.0 * matchAgreement(reference_matches, matches, options.match_tolerance) << "%\n";
+
+        if (options.deadline_ms > 0)
+        {
+            std::cout << "  anytime coverage: " << coverage.searched_pairs << "/" << coverage.total_pairs << " (template, angle) pairs, "
+                << coverage.completed_levels << "/" << coverage.total_levels << " angle levels, "
+                << "max angle gap " << coverage.max_angle_gap << " deg"
+                << (coverage.deadline_expired ? ", deadline expired\n" : "\n");
+        }
+    }
+}
+
+/**
+ * @brief Evaluates the proposal stage against the YOLO labels of the first training images.
+ *
+ * For every image and proposal method, this function reports the recall of the proposal mask (the fraction
+ * of the YOLO boxes centered in the mask, see `proposalRecall`), the fraction of the image the mask keeps and
+ * the time taken to build it, then the totals over all the images. The method selected by the process-wide
+ * options is evaluated; if no method is selected, all of them are, so they can be compared.
+ *
+ * @param[in] num_images The maximum number of training images to use.
+ *
+ * @see proposeRegions
+ * @see proposalRecall
+ * @see readYoloBoxes
+ */
+void evaluateProposals(int num_images)
+{
+    std::vector<std::string> dataset_img_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.jpg", dataset_img_paths);
+    std::vector<std::string> yolo_labels_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.txt", yolo_labels_paths);
+
+    const size_t evaluated_images = std::min({ dataset_img_paths.size(), yolo_labels_paths.size(), static_cast<size_t>(num_images) });
+
+    const TemplateMatchingOptions& options = templateMatchingOptions();
+    const std::vector<std::pair<std::string, ProposalMethod>> methods = options.proposal_method != ProposalMethod::None
+        ? std::vector<std::pair<std::string, ProposalMethod>>{ { "selected", options.proposal_method } }
+        : std::vector<std::pair<std::string, ProposalMethod>>{
+            { "dog", ProposalMethod::DifferenceOfGaussians },
+            { "brightness", ProposalMethod::Brightness },
+            { "variance", ProposalMethod::Variance } };
+
+    // The proposals are scaled to the smallest template, as in the matching
+    const auto& avg_planes = sharedTemplateBank(options.angle_step)->templates();
+    if (avg_planes.empty())
+        throw std::runtime_error("No average plane to evaluate the proposals with.");
+
+    cv::Size min_template_size = avg_planes.front().size();
+    for (const auto& avg_plane : avg_planes)
+    {
+        min_template_size.width = std::min(min_template_size.width, avg_plane.cols);
+        min_template_size.height = std::min(min_template_size.height, avg_plane.rows);
+    }
+
+    for (const auto& [method_name, method] : methods)
+    {
+        size_t total_boxes = 0;
+        double total_kept_boxes = 0.0, total_kept_area = 0.0, total_ms = 0.0;
+        for (size_t i = 0; i < evaluated_images; i++)
+        {
+            const cv::Mat img = cv::imread(dataset_img_paths[i], cv::IMREAD_GRAYSCALE);
+            if (img.empty())
+                continue;
+
+            const std::vector<cv::Rect> yolo_boxes = readYoloBoxes(yolo_labels_paths[i], img);
+
+            cv::Mat proposal_mask;
+            const double proposal_ms = elapsedMs([&]() {
+                proposal_mask = proposeRegions(img, method, options.proposal_fraction, min_template_size);
+                });
+
+            const double recall = proposalRecall(proposal_mask, yolo_boxes);
+            const double kept_area = static_cast<double>(cv::countNonZero(proposal_mask)) / proposal_mask.total();
+
+            total_boxes += yolo_boxes.size();
+            total_kept_boxes += recall * yolo_boxes.size();
+            total_kept_area += kept_area;
+            total_ms += proposal_ms;
+
+            std::cout << std::fixed << std::setprecision(2)
+                << method_name << " proposals, " << std::filesystem::path(dataset_img_paths[i]).filename().string() << ": "
+                << "recall " << 100.0 * recall << "% of " << yolo_boxes.size() << " boxes, "
+                << "searched area " << 100.0 * kept_area << "%, " << proposal_ms << " ms\n";
+        }
+
+        if (evaluated_images > 0)
+        {
+            std::cout << std::fixed << std::setprecision(2)
+                << method_name << " proposals, overall: "
+                << "recall " << 100.0 * total_kept_boxes / std::max<size_t>(total_boxes, 1) << "% of " << total_boxes << " boxes, "
+                << "mean searched area " << 100.0 * total_kept_area / evaluated_images << "%, "
+                << "mean time " << total_ms / evaluated_images << " ms\n";
+        }
+    }
+}
+
+/**
+ * @brief Compares the compile-time specialized HOG kernel with `cv::HOGDescriptor` on the same windows.
+ *
+ * The ROIs are resized to the HOG window once, then the descriptors of all the windows are computed on the
+ * calling thread by both implementations, so that only the descriptor computation is timed.
+ *
+ * @param[in] img The grayscale image.
+ * @param[in] rois The ROIs whose windows are used, at most `max_windows` of them.
+ * @param[in] max_windows The maximum number of windows.
+ *
+ * @see HogKernel::compute
+ * @see cv::HOGDescriptor::compute
+ */
+void benchmarkHogKernel(const cv::Mat& img, const std::vector<cv::Rect>& rois, size_t max_windows)
+{
+    std::vector<cv::Mat> windows;
+    for (size_t i = 0; i < std::min(rois.size(), max_windows); i++)
+    {
+        cv::Mat window;
+        cv::resize(img(rois[i]), window, cv::Size(hog_window_size, hog_window_size), 0, 0, cv::INTER_AREA);
+        windows.push_back(window);
+    }
+    if (windows.empty())
+        return;
+
+    cv::HOGDescriptor hog(cv::Size(hog_window_size, hog_window_size),
+        cv::Size(hog_cell_size, hog_cell_size),
+        cv::Size(hog_cell_size, hog_cell_size),
+        cv::Size(hog_cell_size, hog_cell_size), hog_num_bins);
+    cv::Mat opencv_features(static_cast<int>(windows.size()), hog_descriptor_size, CV_32F);
+    std::vector<float> descriptor;
+    const double opencv_ms = elapsedMs([&]()
+    {
+        for (size_t i = 0; i < windows.size(); i++)
+        {
+            hog.compute(windows[i], descriptor);
+            std::copy(descriptor.begin(), descriptor.end(), opencv_features.ptr<float>(static_cast<int>(i)));
+        }
+    });
+
+    cv::Mat kernel_features(static_cast<int>(windows.size()), hog_descriptor_size, CV_32F);
+    const double kernel_ms = elapsedMs([&]()
+    {
+        for (size_t i = 0; i < windows.size(); i++)
+            SvmHogKernel::compute(windows[i].data, windows[i].step, kernel_features.ptr<float>(static_cast<int>(i)));
+    });
+
+    const double window_us = 1000.0 / static_cast<double>(windows.size());
+    std::cout << std::fixed << std::setprecision(2)
+        << "  HOG kernel (" << hogKernelName() << ") " << kernel_ms * window_us << " us/window, "
+        << "cv::HOGDescriptor " << opencv_ms * window_us << " us/window, "
+        << "speedup " << opencv_ms / std::max(kernel_ms, 1e-3) << "x, "
+        << std::defaultfloat << std::setprecision(4) << "max difference " << cv::norm(opencv_features, kernel_features, cv::NORM_INF) << "\n";
+}
+
+/**
+ * @brief Validates the dense HOG engine against the per-ROI descriptors, and compares their speed.
+ *
+ * On the first training images, ROIs of the SVM training sizes are placed on a regular grid, so that there are
+ * as many overlapping candidates as in a dense scene. Their descriptors are computed per ROI, one at a time
+ * (`hog_features_extraction`) and in one parallel batch (`computeHogDescriptors`), and by the dense engine
+ * (`DenseHog`, with the cell stride of the process-wide detection options). For every image the function reports
+ * the three times, the speedups over the sequential extraction, the largest difference between the sequential
+ * and batched descriptors (about 1e-6, the batch using the specialized kernel) and the cosine similarity (mean
+ * and minimum) between the per-ROI and dense descriptors of every ROI. A single-threaded microbenchmark of the
+ * specialized kernel against `cv::HOGDescriptor` follows (see `benchmarkHogKernel`).
+ *
+ * @param[in] num_images The number of training images to use.
+ *
+ * @see hog_features_extraction
+ * @see computeHogDescriptors
+ * @see benchmarkHogKernel
+ * @see DenseHog
+ * @see svmRoiSizes
+ */
+void benchmarkHog(int num_images)
+{
+    // Distance between two neighboring ROI centers
+    constexpr int roi_spacing = 16;
+    // Number of windows of the kernel microbenchmark
+    constexpr size_t kernel_windows = 2000;
+
+    std::vector<std::string> dataset_img_paths;
+    globFiles(TRAINING_DATASET_PATH, "/*.jpg", dataset_img_paths);
+    if (dataset_img_paths.size() > static_cast<size_t>(num_images))
+        dataset_img_paths.resize(num_images);
+
+    const std::vector<cv::Size> roi_sizes = svmRoiSizes();
+    const int cell_stride = detectionOptions().hog_cell_stride;
+
+    for (const auto& img_path : dataset_img_paths)
+    {
+        const cv::Mat img = cv::imread(img_path, cv::IMREAD_GRAYSCALE);
+        if (img.empty())
+            continue;
+
+        std::vector<cv::Point> roi_centers;
+        for (int y = roi_spacing / 2; y < img.rows; y += roi_spacing)
+        {
+            for (int x = roi_spacing / 2; x < img.cols; x += roi_spacing)
+                roi_centers.emplace_back(x, y);
+        }
+        const std::vector<cv::Rect> rois = generateRoisFromPoints(roi_centers, roi_sizes, img.size());
+
+        std::vector<std::vector<float>> roi_features;
+        const double roi_ms = elapsedMs([&]() { roi_features = hog_features_extraction(rois, img); });
+
+        cv::Mat batch_features;
+        const double batch_ms = elapsedMs([&]() { computeHogDescriptors(rois, img, batch_features); });
+
+        cv::Mat dense_features;
+        const double dense_ms = elapsedMs([&]() { dense_features = DenseHog(img, roi_sizes, cell_stride).descriptors(rois); });
+
+        double similarity_sum = 0.0, min_similarity = 1.0, max_batch_difference = 0.0;
+        for (size_t i = 0; i < rois.size(); i++)
+        {
+            const cv::Mat roi_descriptor(1, hog_descriptor_size, CV_32F, roi_features[i].data());
+            max_batch_difference = std::max(max_batch_difference, cv::norm(roi_descriptor, batch_features.row(static_cast<int>(i)), cv::NORM_INF));
+            const cv::Mat dense_descriptor = dense_features.row(static_cast<int>(i));
+            const double similarity = roi_descriptor.dot(dense_descriptor) / std::max(cv::norm(roi_descriptor) * cv::norm(dense_descriptor), 1e-12);
+            similarity_sum += similarity;
+            min_similarity = std::min(min_similarity, similarity);
+        }
+
+        std::cout << std::fixed << std::setprecision(2)
+            << std::filesystem::path(img_path).filename().string() << ": " << rois.size() << " ROIs, "
+            << "per ROI " << roi_ms << " ms, batch " << batch_ms << " ms (" << roi_ms / std::max(batch_ms, 1e-3) << "x), "
+            << "dense " << dense_ms << " ms (" << roi_ms / std::max(dense_ms, 1e-3) << "x), "
+            << std::setprecision(4) << "cosine similarity mean " << similarity_sum / std::max<size_t>(rois.size(), 1)
+            << ", min " << min_similarity << ", batch difference " << std::defaultfloat << max_batch_difference << "\n";
+
+        benchmarkHogKernel(img, rois, kernel_windows);
+    }
+}
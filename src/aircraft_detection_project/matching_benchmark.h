@@ -0,0 +1,8 @@
+#pragma once
+
+
+void benchmarkTemplateMatching(int num_images);
+
+void evaluateProposals(int num_images);
+
+void benchmarkHog(int num_images);
\ No newline at end of file
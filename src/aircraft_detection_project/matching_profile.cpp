@@ -0,0 +1,268 @@
+#include "matching_profile.h"
+
+#include "utils.h"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+
+
+/**
+ * @brief Starts recording the matching statistics, discarding the previous ones.
+ *
+ * @param[in] num_templates The number of templates of the bank.
+ * @param[in] angle_step The angle step, in degrees, of the bank.
+ *
+ * @note It must not be called while matching runs.
+ */
+void MatchingProfiler::start(int num_templates, int angle_step)
+{
+    this->num_templates = num_templates;
+    this->angle_step = angle_step;
+    num_angles = (360 + angle_step - 1) / angle_step;
+    counters = std::make_unique<PairCounters[]>(static_cast<size_t>(num_templates) * num_angles);
+    recording.store(true);
+}
+
+/**
+ * @brief Stops recording the matching statistics. The recorded ones are kept.
+ */
+void MatchingProfiler::stop()
+{
+    recording.store(false);
+}
+
+/**
+ * @brief Returns the index of the counters of a (template, angle) pair.
+ *
+ * @throws std::out_of_range If the pair is not in the recorded bank.
+ */
+size_t MatchingProfiler::pairIndex(int template_index, int degree_angle) const
+{
+    const int angle_index = degree_angle / angle_step;
+    if (template_index < 0 || template_index >= num_templates || degree_angle < 0 || angle_index >= num_angles)
+        throw std::out_of_range("The (template, angle) pair is not in the profiled template bank.");
+
+    return static_cast<size_t>(template_index) * num_angles + angle_index;
+}
+
+/**
+ * @brief Adds the time spent correlating a (template, angle) pair.
+ *
+ * This is called from the matching tasks, concurrently: the counters are atomic, so recording costs one
+ * relaxed atomic addition.
+ *
+ * @param[in] template_index The index of the template.
+ * @param[in] degree_angle The rotation angle, in degrees.
+ * @param[in] time_ns The time spent, in nanoseconds.
+ */
+void MatchingProfiler::recordTime(int template_index, int degree_angle, uint64_t time_ns)
+{
+    if (!isRecording())
+        return;
+
+    counters[pairIndex(template_index, degree_angle)].time_ns.fetch_add(time_ns, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Counts the matches of an image, and those centered inside a ground truth box, per (template, angle) pair.
+ *
+ * @param[in] matches The matches of the image.
+ * @param[in] boxes The ground truth boxes of the image (e.g. the YOLO boxes).
+ */
+void MatchingProfiler::recordMatches(const std::vector<TemplateMatch>& matches, const std::vector<cv::Rect>& boxes)
+{
+    if (!isRecording())
+        return;
+
+    for (const auto& match : matches)
+    {
+        PairCounters& pair_counters = counters[pairIndex(match.template_index, match.degree_angle)];
+        pair_counters.matches.fetch_add(1, std::memory_order_relaxed);
+
+        const bool is_hit = std::any_of(boxes.begin(), boxes.end(), [&](const cv::Rect& box) { return box.contains(match.center); });
+        if (is_hit)
+            pair_counters.hits.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Returns a snapshot of the recorded statistics.
+ *
+ * @return The statistics of every (template, angle) pair, templates first.
+ */
+std::vector<PairStatistics> MatchingProfiler::statistics() const
+{
+    const size_t num_pairs = static_cast<size_t>(num_templates) * num_angles;
+    std::vector<PairStatistics> pair_statistics(num_pairs);
+    for (size_t i = 0; i < num_pairs; i++)
+    {
+        pair_statistics[i].matches = counters[i].matches.load(std::memory_order_relaxed);
+        pair_statistics[i].hits = counters[i].hits.load(std::memory_order_relaxed);
+        pair_statistics[i].time_ns = counters[i].time_ns.load(std::memory_order_relaxed);
+    }
+    return pair_statistics;
+}
+
+/**
+ * @brief Returns the process-wide matching profiler.
+ *
+ * @return A reference to the process-wide `MatchingProfiler`, not recording until started.
+ */
+MatchingProfiler& matchingProfiler()
+{
+    static MatchingProfiler profiler;
+    return profiler;
+}
+
+/**
+ * @brief Saves the recorded statistics as a pruning profile.
+ *
+ * The profile is a CSV file with a header line and one line per (template, angle) pair:
+ * `template,angle,matches,hits,time_ms`.
+ *
+ * @param[in] profiler The profiler holding the statistics.
+ * @param[in] file_path The path of the CSV file.
+ *
+ * @see openFile
+ */
+void savePruningProfile(const MatchingProfiler& profiler, const std::filesystem::path& file_path)
+{
+    auto file = openFile(file_path.string());
+    file << "template,angle,matches,hits,time_ms\n";
+
+    const std::vector<PairStatistics> pair_statistics = profiler.statistics();
+    const size_t num_angles = pair_statistics.size() / std::max(profiler.numTemplates(), 1);
+    for (size_t i = 0; i < pair_statistics.size(); i++)
+    {
+        file << i / num_angles << "," << (i % num_angles) * profiler.angleStep() << ","
+            << pair_statistics[i].matches << "," << pair_statistics[i].hits << ","
+            << pair_statistics[i].time_ns / 1e6 << "\n";
+    }
+}
+
+/**
+ * @brief Loads a pruning profile and selects the (template, angle) pairs worth correlating.
+ *
+ * The pairs are ranked by recorded hits per millisecond, and the best ones are kept until they hold
+ * `target_recall` of all the recorded hits: the pairs that almost never produce a hit, or only at a high
+ * cost, are pruned. The expected recall and speedup are those of the kept pairs on the recorded run.
+ *
+ * @param[in] file_path The path of the CSV file written by `savePruningProfile`.
+ * @param[in] target_recall The fraction of the recorded hits to keep, in (0, 1].
+ * @return The `PruningProfile` holding the kept pairs and the expected recall and speedup.
+ *
+ * @throws std::runtime_error If the file cannot be opened, is malformed (a template index or an angle out of
+ *                            range, an angle off the step, a repeated pair) or does not hold a full bank.
+ */
+PruningProfile loadPruningProfile(const std::filesystem::path& file_path, double target_recall)
+{
+    std::ifstream file(file_path);
+    if (!file.is_open())
+        throw std::runtime_error("Could not open file: " + file_path.string());
+
+    struct ProfiledPair
+    {
+        int template_index;
+        int degree_angle;
+        uint64_t hits;
+        double time_ms;
+    };
+
+    std::vector<ProfiledPair> pairs;
+    std::vector<std::string> lines;
+    std::string line;
+    std::getline(file, line); // header
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line == "\r")
+            continue;
+
+        std::istringstream line_stream(line);
+        ProfiledPair pair{};
+        uint64_t matches = 0;
+        char separator;
+        if (!(line_stream >> pair.template_index >> separator >> pair.degree_angle >> separator >> matches >> separator >> pair.hits >> separator >> pair.time_ms)
+            || pair.template_index < 0 || pair.degree_angle < 0 || pair.degree_angle >= 360)
+            throw std::runtime_error("Malformed pruning profile line: " + line);
+
+        pairs.push_back(pair);
+        lines.push_back(line);
+    }
+
+    PruningProfile profile;
+    for (const auto& pair : pairs)
+        profile.num_templates = std::max(profile.num_templates, pair.template_index + 1);
+
+    if (pairs.size() < 2 || profile.num_templates == 0 || pairs.size() % profile.num_templates != 0)
+        throw std::runtime_error("The pruning profile does not hold a full template bank: " + file_path.string());
+
+    const size_t num_angles = pairs.size() / profile.num_templates;
+    profile.angle_step = pairs[1].degree_angle - pairs[0].degree_angle;
+    if (num_angles < 2 || profile.angle_step <= 0)
+        throw std::runtime_error("The pruning profile does not hold a full template bank: " + file_path.string());
+
+    // Every (template, angle) slot of the bank has to be filled by exactly one line
+    std::vector<bool> seen_pairs(pairs.size(), false);
+    for (size_t i = 0; i < pairs.size(); i++)
+    {
+        const ProfiledPair& pair = pairs[i];
+        if (pair.degree_angle % profile.angle_step != 0 || static_cast<size_t>(pair.degree_angle / profile.angle_step) >= num_angles)
+            throw std::runtime_error("Malformed pruning profile line: " + lines[i]);
+
+        const size_t pair_index = static_cast<size_t>(pair.template_index) * num_angles + pair.degree_angle / profile.angle_step;
+        if (seen_pairs[pair_index])
+            throw std::runtime_error("Malformed pruning profile line: " + lines[i]);
+        seen_pairs[pair_index] = true;
+    }
+
+    // Best hits per millisecond first; pairs without hits are only kept if nothing was ever hit
+    std::vector<size_t> order(pairs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+    {
+        return pairs[a].hits / std::max(pairs[a].time_ms, 1e-3) > pairs[b].hits / std::max(pairs[b].time_ms, 1e-3);
+    });
+
+    uint64_t total_hits = 0;
+    double total_time_ms = 0.0;
+    for (const auto& pair : pairs)
+    {
+        total_hits += pair.hits;
+        total_time_ms += pair.time_ms;
+    }
+
+    profile.kept_pairs.assign(pairs.size(), total_hits == 0);
+    uint64_t kept_hits = 0;
+    double kept_time_ms = 0.0;
+    for (size_t i = 0; i < order.size() && total_hits > 0 && kept_hits < target_recall * total_hits; i++)
+    {
+        const ProfiledPair& pair = pairs[order[i]];
+        profile.kept_pairs[static_cast<size_t>(pair.template_index) * num_angles + pair.degree_angle / profile.angle_step] = true;
+        kept_hits += pair.hits;
+        kept_time_ms += pair.time_ms;
+    }
+
+    if (total_hits > 0)
+    {
+        profile.expected_recall = static_cast<double>(kept_hits) / total_hits;
+        profile.expected_speedup = total_time_ms / std::max(kept_time_ms, 1e-3);
+    }
+    return profile;
+}
+
+/**
+ * @brief Checks whether a (template, angle) pair is kept by the profile.
+ *
+ * @param[in] template_index The index of the template.
+ * @param[in] degree_angle The rotation angle, in degrees, a multiple of the profile angle step.
+ * @return `true` if the pair has to be correlated.
+ */
+bool PruningProfile::keeps(int template_index, int degree_angle) const
+{
+    const size_t num_angles = kept_pairs.size() / std::max(num_templates, 1);
+    const size_t pair_index = static_cast<size_t>(template_index) * num_angles + degree_angle / angle_step;
+    return pair_index >= kept_pairs.size() || kept_pairs[pair_index];
+}
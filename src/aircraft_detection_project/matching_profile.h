@@ -0,0 +1,69 @@
+#pragma once
+
+#include "template_matching.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+
+struct PairStatistics
+{
+    uint64_t matches = 0; // matches produced by the (template, angle) pair
+    uint64_t hits = 0;    // matches centered inside a ground truth box
+    uint64_t time_ns = 0; // time spent correlating the pair
+};
+
+class MatchingProfiler
+{
+public:
+    void start(int num_templates, int angle_step);
+
+    void stop();
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    void recordTime(int template_index, int degree_angle, uint64_t time_ns);
+
+    void recordMatches(const std::vector<TemplateMatch>& matches, const std::vector<cv::Rect>& boxes);
+
+    std::vector<PairStatistics> statistics() const;
+
+    int numTemplates() const { return num_templates; }
+
+    int angleStep() const { return angle_step; }
+
+private:
+    struct PairCounters
+    {
+        std::atomic<uint64_t> matches = 0;
+        std::atomic<uint64_t> hits = 0;
+        std::atomic<uint64_t> time_ns = 0;
+    };
+
+    size_t pairIndex(int template_index, int degree_angle) const;
+
+    std::atomic<bool> recording = false;
+    int num_templates = 0;
+    int angle_step = 1;
+    int num_angles = 0;
+    std::unique_ptr<PairCounters[]> counters;
+};
+
+struct PruningProfile
+{
+    int num_templates = 0;
+    int angle_step = 0;
+    std::vector<bool> kept_pairs;   // one flag per (template, angle) pair, templates first
+    double expected_recall = 1.0;   // fraction of the recorded hits of the kept pairs
+    double expected_speedup = 1.0;  // total recorded time over the recorded time of the kept pairs
+
+    bool keeps(int template_index, int degree_angle) const;
+};
+
+MatchingProfiler& matchingProfiler();
+
+void savePruningProfile(const MatchingProfiler& profiler, const std::filesystem::path& file_path);
+
+PruningProfile loadPruningProfile(const std::filesystem::path& file_path, double target_recall);
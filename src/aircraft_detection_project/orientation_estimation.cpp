@@ -0,0 +1,92 @@
+#include "orientation_estimation.h"
+
+#include "fft_correlation.h"
+#include <cmath>
+#include <numbers>
+
+
+
+/**
+ * @brief Builds a circular mask.
+ *
+ * A circular support makes the orientation estimate independent of the rotation of the patch: a square one
+ * would let its corners, which come in and out of the support as the content rotates, bias the estimate.
+ *
+ * @param[in] diameter The diameter of the disk, in pixels.
+ * @return A `CV_8U` square mask of side `diameter`, set to 255 inside the inscribed disk.
+ */
+cv::Mat diskMask(int diameter)
+{
+    cv::Mat mask = cv::Mat::zeros(diameter, diameter, CV_8U);
+    cv::circle(mask, cv::Point(diameter / 2, diameter / 2), diameter / 2, cv::Scalar(255), cv::FILLED);
+    return mask;
+}
+
+/**
+ * @brief Estimates the dominant gradient orientation of a patch with the structure tensor.
+ *
+ * The structure tensor J = [Jxx Jxy; Jxy Jyy] sums the outer products of the Sobel gradients over the mask.
+ * The orientation of its main eigenvector is 0.5 * atan2(2 Jxy, Jxx - Jyy), and its coherence is
+ * (l1 - l2) / (l1 + l2), l1 >= l2 being the eigenvalues.
+ *
+ * The orientation is only defined modulo 180 degrees, and it is not the heading of an aircraft: it is an
+ * angle that rotates with the content of the patch. The rotation between two patches holding the same object
+ * is therefore the difference of their orientations, modulo 180 degrees.
+ *
+ * @param[in] patch The grayscale patch.
+ * @param[in] mask The `CV_8U` mask of the pixels taken into account, of the size of the patch.
+ * @return The orientation (counter-clockwise, as the rotation angles of OpenCV) and its coherence.
+ *
+ * @see cv::Sobel
+ */
+Orientation estimateOrientation(const cv::Mat& patch, const cv::Mat& mask)
+{
+    cv::Mat grad_x, grad_y;
+    cv::Sobel(patch, grad_x, CV_32F, 1, 0);
+    cv::Sobel(patch, grad_y, CV_32F, 0, 1);
+
+    const double jxx = cv::mean(grad_x.mul(grad_x), mask)[0];
+    const double jyy = cv::mean(grad_y.mul(grad_y), mask)[0];
+    const double jxy = cv::mean(grad_x.mul(grad_y), mask)[0];
+
+    Orientation orientation;
+    const double trace = jxx + jyy;
+    if (trace <= 0.0)
+        return orientation;
+
+    orientation.coherence = std::sqrt((jxx - jyy) * (jxx - jyy) + 4.0 * jxy * jxy) / trace;
+
+    // The y axis of the image points down, so the angle is negated to be counter-clockwise
+    const double image_angle = 0.5 * std::atan2(2.0 * jxy, jxx - jyy) * 180.0 / std::numbers::pi;
+    orientation.degree_angle = std::fmod(360.0 - image_angle, 180.0);
+    return orientation;
+}
+
+/**
+ * @brief Computes the variance of an image over all the windows of a given size.
+ *
+ * Windows holding an object are more textured than the tarmac or the grass around it, so the local maxima
+ * of this map are cheap candidate locations. The map is computed from the integral images of the image and
+ * of its square, in a few vectorized matrix operations.
+ *
+ * @param[in] img The grayscale image.
+ * @param[in] window_size The size of the windows.
+ * @return A `CV_32F` map of size (W - w + 1) x (H - h + 1): the value at (x, y) is the variance of the window
+ *         whose top-left corner is (x, y).
+ *
+ * @see windowSums
+ */
+cv::Mat localVariance(const cv::Mat& img, cv::Size window_size)
+{
+    cv::Mat integral_sum, integral_sqsum;
+    cv::integral(img, integral_sum, integral_sqsum, CV_64F, CV_64F);
+
+    const cv::Size result_size(img.cols - window_size.width + 1, img.rows - window_size.height + 1);
+    const double window_area = static_cast<double>(window_size.area());
+    const cv::Mat mean = windowSums(integral_sum, window_size, result_size) / window_area;
+    const cv::Mat variance = windowSums(integral_sqsum, window_size, result_size) / window_area - mean.mul(mean);
+
+    cv::Mat variance_32f;
+    variance.convertTo(variance_32f, CV_32F);
+    return variance_32f;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+
+struct Orientation
+{
+    double degree_angle = 0.0; // dominant gradient orientation, counter-clockwise, in [0, 180)
+    double coherence = 0.0;    // anisotropy of the gradients, from 0 (isotropic) to 1 (a single orientation)
+};
+
+cv::Mat diskMask(int diameter);
+
+Orientation estimateOrientation(const cv::Mat& patch, const cv::Mat& mask);
+
+cv::Mat localVariance(const cv::Mat& img, cv::Size window_size);
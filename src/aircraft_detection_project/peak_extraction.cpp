@@ -0,0 +1,79 @@
+#include "peak_extraction.h"
+
+#include <algorithm>
+
+
+
+/**
+ * @brief Extracts the highest local maxima of a response map, with radius-based suppression.
+ *
+ * This function finds the local maxima of the response map with a grayscale dilation: a pixel is a local maximum
+ * if it equals the maximum of the (2 * radius + 1) x (2 * radius + 1) window centered on it. Dilation, comparison
+ * and thresholding are whole-matrix (vectorized) operations, so only the few surviving pixels are visited one
+ * by one: they are sorted by descending score and greedily accepted, each accepted peak suppressing the others
+ * within `radius` pixels (this also removes the duplicates of flat maxima).
+ *
+ * For `max_peaks == 1` the global maximum is returned directly, as `cv::minMaxLoc` would.
+ *
+ * @param[in] response The `CV_32F` response map (e.g. a normalized cross-correlation map).
+ * @param[in] max_peaks The maximum number of peaks to return.
+ * @param[in] threshold The minimum score of a peak.
+ * @param[in] radius The suppression radius, in pixels: no two returned peaks are closer than this.
+ * @return The peaks, sorted by descending score.
+ *
+ * @see cv::dilate
+ * @see cv::findNonZero
+ * @see cv::minMaxLoc
+ */
+std::vector<Peak> extractPeaks(const cv::Mat& response, int max_peaks, float threshold, int radius)
+{
+    std::vector<Peak> peaks;
+    if (response.empty() || max_peaks <= 0)
+        return peaks;
+
+    if (max_peaks == 1)
+    {
+        double maxVal;
+        cv::Point maxP;
+        cv::minMaxLoc(response, nullptr, &maxVal, nullptr, &maxP);
+        if (maxVal >= threshold)
+            peaks.push_back({ maxP, static_cast<float>(maxVal) });
+        return peaks;
+    }
+
+    radius = std::max(radius, 1);
+    cv::Mat local_max;
+    cv::dilate(response, local_max, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * radius + 1, 2 * radius + 1)));
+
+    const cv::Mat peak_mask = (response >= local_max) & (response >= threshold);
+    std::vector<cv::Point> locations;
+    cv::findNonZero(peak_mask, locations);
+
+    std::vector<Peak> candidates;
+    candidates.reserve(locations.size());
+    for (const auto& location : locations)
+        candidates.push_back({ location, response.at<float>(location) });
+
+    std::sort(candidates.begin(), candidates.end(), [](const Peak& a, const Peak& b)
+    {
+        return a.score > b.score;
+    });
+
+    const int squared_radius = radius * radius;
+    for (const auto& candidate : candidates)
+    {
+        const bool suppressed = std::any_of(peaks.begin(), peaks.end(), [&](const Peak& peak)
+        {
+            const cv::Point offset = candidate.location - peak.location;
+            return offset.dot(offset) < squared_radius;
+        });
+
+        if (suppressed)
+            continue;
+
+        peaks.push_back(candidate);
+        if (static_cast<int>(peaks.size()) == max_peaks)
+            break;
+    }
+    return peaks;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+struct Peak
+{
+    cv::Point location; // position of the peak in the response map
+    float score = 0.0f; // value of the response map at the peak
+};
+
+std::vector<Peak> extractPeaks(const cv::Mat& response, int max_peaks, float threshold, int radius);
@@ -8,6 +8,9 @@
 #include "python_script.h"
 #include "svm_training.h"
 #include "straight_airplanes_extraction.h"
+#include "matching_benchmark.h"
+#include "thread_pool.h"
+#include "detection.h"
 
 
 
@@ -187,9 +190,12 @@ void resizeImgsSingleCluster(const std::string& cluster_input_path, const std::f
  * @note This function assumes that the directory `SRC_DIR_PATH/kmeans_by_intensity` exists and contains
  *       the images clustered by intensity.
  *
+ * @note The clusters are processed in parallel on the shared thread pool.
+ *
  * @see listDirectories
  * @see resizeImgsSingleCluster
  * @see createDirectory
+ * @see sharedThreadPool
  */
 void resizeImagesAcrossClusters()
 {
@@ -198,8 +204,14 @@ void resizeImagesAcrossClusters()
     std::vector<std::string> intensity_cluster_paths;
     listDirectories(std::filesystem::path(SRC_DIR_PATH) / "kmeans_by_intensity", intensity_cluster_paths);
 
+    std::vector<std::future<void>> futures;
     for (size_t i = 0; i < intensity_cluster_paths.size(); ++i)
-        resizeImgsSingleCluster(intensity_cluster_paths[i], output_folder_path, i);
+    {
+        futures.emplace_back(sharedThreadPool().submit([&cluster_path = intensity_cluster_paths[i], &output_folder_path, i]() {
+            resizeImgsSingleCluster(cluster_path, output_folder_path, i);
+            }));
+    }
+    sharedThreadPool().waitAll(futures);
 }
 // =============================================================================
 
@@ -219,13 +231,18 @@ void resizeImagesAcrossClusters()
  * 2. For each resized cluster:
  *    a. Reads the images in grayscale.
  *    b. Computes the average plane (eigenplane) using PCA.
- *    c. Saves the average plane image into the `avg_airplanes` directory.
+ *    c. Saves the average plane image into the `avg_airplanes` directory, and the mean plane and
+ *       principal components of the cluster into its `eigen_basis` subdirectory.
+ * 3. Saves the template bank (the average planes with their rotated variants) into the same directory.
  *
  * @note This function assumes that the directory `SRC_DIR_PATH/resized_clusters` exists and contains
  *       the images that have been resized and clustered.
+ * @note The clusters are processed in parallel on the shared thread pool.
  *
  * @see readImages
  * @see eigenPlanes
+ * @see saveEigenBasis
+ * @see saveTemplateBank
  * @see calculateAvgDims
  * @see createDirectory
  * @see cv::glob
@@ -243,18 +260,27 @@ void generateEigenplanes()
     }
 
     const auto avg_airplanes_dir = createDirectory(std::filesystem::path(SRC_DIR_PATH),"avg_airplanes");
+    const auto eigen_basis_dir = createDirectory(avg_airplanes_dir, "eigen_basis");
 
+    std::vector<std::future<void>> futures;
     for (size_t i = 0; i < single_resized_cluster_dir_paths.size(); i++)
     {
-        std::vector<std::string> img_paths_in_single_resized_cluster;
-        cv::glob(single_resized_cluster_dir_paths[i] + "/*.png", img_paths_in_single_resized_cluster);
-
-        std::vector<cv::Mat> intensities_img;
-        readImages(img_paths_in_single_resized_cluster, intensities_img, cv::IMREAD_GRAYSCALE);
-
-        cv::Mat avg_airplane = eigenPlanes(intensities_img, calculateAvgDims(single_resized_cluster_dir_paths[i]));
-        cv::imwrite((avg_airplanes_dir / ("avg_airplane" + std::to_string(i) + ".png")).string(), avg_airplane);
+        futures.emplace_back(sharedThreadPool().submit([&cluster_dir_path = single_resized_cluster_dir_paths[i], &avg_airplanes_dir, &eigen_basis_dir, i]() {
+            std::vector<std::string> img_paths_in_single_resized_cluster;
+            cv::glob(cluster_dir_path + "/*.png", img_paths_in_single_resized_cluster);
+
+            std::vector<cv::Mat> intensities_img;
+            readImages(img_paths_in_single_resized_cluster, intensities_img, cv::IMREAD_GRAYSCALE);
+
+            EigenBasis eigen_basis;
+            cv::Mat avg_airplane = eigenPlanes(intensities_img, calculateAvgDims(cluster_dir_path), eigen_basis);
+            cv::imwrite((avg_airplanes_dir / ("avg_airplane" + std::to_string(i) + ".png")).string(), avg_airplane);
+            saveEigenBasis(eigen_basis, eigen_basis_dir / ("avg_airplane" + std::to_string(i) + ".yml"));
+            }));
     }
+    sharedThreadPool().waitAll(futures);
+
+    saveTemplateBank();
 }
 // =============================================================================
 
@@ -282,6 +308,16 @@ void evaluatePerformance()
 
 
 
+// Number of training images used by the matching and proposal benchmarks
+int benchmarkImages = 3;
+
+// Similarity from which compactTemplateBank drops a template as redundant
+double dedupSimilarity = 0.95;
+
+// Type the HOG features of the SVM training are stored as
+FeatureType featureType = FeatureType::Float32;
+
+
 // Path for step completion files
 const std::filesystem::path stepStatePath = std::filesystem::path(SRC_DIR_PATH)/ "steps_completed";
 
@@ -303,15 +339,24 @@ void createCompletionFile(const std::string& step)
  * @brief Defines the dependencies between steps.
  *
  * This unordered map defines the dependencies between different steps in the process.
- * Each entry maps a step to its required preceding step.
+ * Each entry maps a step to the preceding steps that can provide its input: any one of them is enough
+ * (e.g. the feature store read by trainSVM is written by extract_SVM_Training_Data or importFeaturesFromCsv).
  */
-const std::unordered_map<std::string, std::string> stepDependencies = {
-    {"KMeansBySize", "extractStraightAirplanes"},
-    {"KMeansByIntensity", "KMeansBySize"},
-    {"resizeImagesInClusters", "KMeansByIntensity"},
-    {"generateEigenplanes", "resizeImagesInClusters"},
-    {"extract_SVM_Training_Data", "generateEigenplanes"},
-    {"Performance_evaluation", "extract_SVM_Training_Data"}
+const std::unordered_map<std::string, std::vector<std::string>> stepDependencies = {
+    {"KMeansBySize", {"extractStraightAirplanes"}},
+    {"KMeansByIntensity", {"KMeansBySize"}},
+    {"resizeImagesInClusters", {"KMeansByIntensity"}},
+    {"generateEigenplanes", {"resizeImagesInClusters"}},
+    {"extract_SVM_Training_Data", {"generateEigenplanes"}},
+    {"trainSVM", {"extract_SVM_Training_Data", "importFeaturesFromCsv"}},
+    {"Performance_evaluation", {"trainSVM"}},
+    {"exportFeaturesToCsv", {"extract_SVM_Training_Data", "importFeaturesFromCsv"}},
+    {"benchmarkMatching", {"generateEigenplanes"}},
+    {"evaluateProposals", {"generateEigenplanes"}},
+    {"compactTemplateBank", {"generateEigenplanes"}},
+    {"detect", {"generateEigenplanes"}},
+    {"benchmarkHOG", {"KMeansBySize"}},
+    {"evaluateDetectors", {"generateEigenplanes"}}
 };
 
 /**
@@ -343,52 +388,290 @@ std::unordered_map<std::string, std::function<void()>> stepFunctions = {
         createCompletionFile("generateEigenplanes");
     }},
     {"extract_SVM_Training_Data", []() {
-        generateSvmTrainingData();
+        generateSvmTrainingData(featureType);
         createCompletionFile("extract_SVM_Training_Data");
     }},
+    {"trainSVM", []() {
+        trainSvm();
+        createCompletionFile("trainSVM");
+    }},
     {"Performance_evaluation", []() {
         evaluatePerformance();
         createCompletionFile("Performance_evaluation");
     }},
+    {"exportFeaturesToCsv", []() {
+        exportFeaturesToCsv();
+        createCompletionFile("exportFeaturesToCsv");
+    }},
+    {"importFeaturesFromCsv", []() {
+        importFeaturesFromCsv(featureType);
+        createCompletionFile("importFeaturesFromCsv");
+    }},
+    {"benchmarkMatching", []() {
+        benchmarkTemplateMatching(benchmarkImages);
+    }},
+    {"evaluateProposals", []() {
+        evaluateProposals(benchmarkImages);
+    }},
+    {"compactTemplateBank", []() {
+        compactTemplateBank(dedupSimilarity);
+    }},
+    {"detect", []() {
+        runDetector();
+    }},
+    {"benchmarkHOG", []() {
+        benchmarkHog(benchmarkImages);
+    }},
+    {"evaluateDetectors", []() {
+        evaluateDetectors(benchmarkImages);
+    }},
     {"--help", printHelp}
 };
 
 /**
- * @brief Checks if the previous step required for the current step has been executed.
+ * @brief Checks if a previous step required for the current step has been executed.
  *
- * This function verifies if the step that the current step depends on has been executed
- * by checking for the existence of a corresponding ".done" file. If the previous step has
- * not been executed, it throws a runtime error.
+ * This function verifies if one of the steps that the current step depends on has been executed
+ * by checking for the existence of a corresponding ".done" file. If none of them has been
+ * executed, it throws a runtime error.
  *
  * @param[in] current_step The name of the current step to be executed.
  *
- * @throws std::runtime_error If the previous step required for the current step has not been executed.
+ * @throws std::runtime_error If no previous step required for the current step has been executed.
  */
 void checkPreviousStep(const std::string& current_step)
 {
     auto it = stepDependencies.find(current_step);
     if (it != stepDependencies.end())
     {
-        const auto& previous_step = it->second;
-        auto previous_step_file = stepStatePath / (previous_step + ".done");
-        if (!std::filesystem::exists(previous_step_file))
-            throw std::runtime_error("The step " + previous_step + " has not been executed yet. Cannot execute " + current_step + ".");
+        std::string previous_steps;
+        for (const auto& previous_step : it->second)
+        {
+            if (std::filesystem::exists(stepStatePath / (previous_step + ".done")))
+                return;
+            previous_steps += (previous_steps.empty() ? "" : " or ") + previous_step;
+        }
+        throw std::runtime_error("The step " + previous_steps + " has not been executed yet. Cannot execute " + current_step + ".");
     }
 }
 
+/**
+ * @brief Parses the value of an integer option, checking its lower bound.
+ *
+ * @param[in] name The name of the option, used in error messages.
+ * @param[in] value The value of the option as given on the command line.
+ * @param[in] min_value The minimum accepted value.
+ * @return The parsed value.
+ *
+ * @throws std::invalid_argument If the value is not an integer or is lower than `min_value`.
+ */
+int parseIntOption(const std::string& name, const std::string& value, int min_value)
+{
+    size_t parsed_chars = 0;
+    int parsed_value = 0;
+    try
+    {
+        parsed_value = std::stoi(value, &parsed_chars);
+    }
+    catch (const std::exception&)
+    {
+        parsed_chars = 0;
+    }
+
+    if (parsed_chars != value.size() || value.empty() || parsed_value < min_value)
+        throw std::invalid_argument("Invalid value for option " + name + ": " + value);
+
+    return parsed_value;
+}
+
+/**
+ * @brief Parses the value of a floating-point option, checking its lower bound.
+ *
+ * @param[in] name The name of the option, used in error messages.
+ * @param[in] value The value of the option as given on the command line.
+ * @param[in] min_value The minimum accepted value.
+ * @return The parsed value.
+ *
+ * @throws std::invalid_argument If the value is not a number or is lower than `min_value`.
+ */
+double parseDoubleOption(const std::string& name, const std::string& value, double min_value)
+{
+    size_t parsed_chars = 0;
+    double parsed_value = 0.0;
+    try
+    {
+        parsed_value = std::stod(value, &parsed_chars);
+    }
+    catch (const std::exception&)
+    {
+        parsed_chars = 0;
+    }
+
+    if (parsed_chars != value.size() || value.empty() || !(parsed_value >= min_value))
+        throw std::invalid_argument("Invalid value for option " + name + ": " + value);
+
+    return parsed_value;
+}
+
+/**
+ * @brief Maps option names to the functions applying them.
+ *
+ * This unordered map defines the options that can be given on the command line in the
+ * form `--name=value`. Each entry maps an option name to a function that parses the value
+ * and stores it in the options of the module it configures.
+ */
+const std::unordered_map<std::string, std::function<void(const std::string&)>> optionSetters = {
+    {"--matching-mode", [](const std::string& value) {
+        templateMatchingOptions().mode = parseMatchingMode(value);
+    }},
+    {"--correlation-backend", [](const std::string& value) {
+        templateMatchingOptions().correlation_backend = parseCorrelationBackend(value);
+    }},
+    {"--separable-energy", [](const std::string& value) {
+        templateMatchingOptions().separable_energy = std::min(parseDoubleOption("--separable-energy", value, 0.01), 1.0);
+    }},
+    {"--eigen-energy", [](const std::string& value) {
+        templateMatchingOptions().eigen_energy = std::min(parseDoubleOption("--eigen-energy", value, 0.01), 1.0);
+    }},
+    {"--deadline-ms", [](const std::string& value) {
+        templateMatchingOptions().deadline_ms = parseDoubleOption("--deadline-ms", value, 0.0);
+    }},
+    {"--pruning-recall", [](const std::string& value) {
+        templateMatchingOptions().pruning_recall = std::min(parseDoubleOption("--pruning-recall", value, 0.0), 1.0);
+    }},
+    {"--angle-step", [](const std::string& value) {
+        templateMatchingOptions().angle_step = parseIntOption("--angle-step", value, 1);
+    }},
+    {"--pyramid-levels", [](const std::string& value) {
+        templateMatchingOptions().pyramid_levels = parseIntOption("--pyramid-levels", value, 0);
+    }},
+    {"--pyramid-candidates", [](const std::string& value) {
+        templateMatchingOptions().pyramid_candidates = parseIntOption("--pyramid-candidates", value, 1);
+    }},
+    {"--orientation-candidates", [](const std::string& value) {
+        templateMatchingOptions().orientation_candidates = parseIntOption("--orientation-candidates", value, 1);
+    }},
+    {"--orientation-window", [](const std::string& value) {
+        templateMatchingOptions().orientation_window = parseIntOption("--orientation-window", value, 0);
+    }},
+    {"--proposals", [](const std::string& value) {
+        templateMatchingOptions().proposal_method = parseProposalMethod(value);
+    }},
+    {"--proposal-fraction", [](const std::string& value) {
+        templateMatchingOptions().proposal_fraction = std::min(parseDoubleOption("--proposal-fraction", value, 0.001), 1.0);
+    }},
+    {"--match-tolerance", [](const std::string& value) {
+        templateMatchingOptions().match_tolerance = parseDoubleOption("--match-tolerance", value, 0.0);
+    }},
+    {"--peaks-per-map", [](const std::string& value) {
+        templateMatchingOptions().peaks_per_map = parseIntOption("--peaks-per-map", value, 1);
+    }},
+    {"--peak-threshold", [](const std::string& value) {
+        templateMatchingOptions().peak_threshold = static_cast<float>(parseDoubleOption("--peak-threshold", value, -1.0));
+    }},
+    {"--peak-radius", [](const std::string& value) {
+        templateMatchingOptions().peak_radius = parseIntOption("--peak-radius", value, 0);
+    }},
+    {"--tile-size", [](const std::string& value) {
+        templateMatchingOptions().tile_size = parseIntOption("--tile-size", value, 0);
+    }},
+    {"--spectrum-cache-mb", [](const std::string& value) {
+        templateMatchingOptions().spectrum_cache_mb = static_cast<size_t>(parseIntOption("--spectrum-cache-mb", value, 0));
+    }},
+    {"--memory-budget-mb", [](const std::string& value) {
+        sharedThreadPool().setMemoryBudget(static_cast<size_t>(parseIntOption("--memory-budget-mb", value, 0)) << 20);
+    }},
+    {"--benchmark-images", [](const std::string& value) {
+        benchmarkImages = parseIntOption("--benchmark-images", value, 1);
+    }},
+    {"--dedup-similarity", [](const std::string& value) {
+        dedupSimilarity = std::min(parseDoubleOption("--dedup-similarity", value, 0.01), 1.0);
+    }},
+    {"--detect-input", [](const std::string& value) {
+        detectionOptions().input_path = value;
+    }},
+    {"--svm-model", [](const std::string& value) {
+        detectionOptions().model_path = value;
+    }},
+    {"--detection-threshold", [](const std::string& value) {
+        detectionOptions().score_threshold = static_cast<float>(parseDoubleOption("--detection-threshold", value, -1e9));
+    }},
+    {"--nms-iou", [](const std::string& value) {
+        detectionOptions().nms_iou = std::min(parseDoubleOption("--nms-iou", value, 0.0), 1.0);
+    }},
+    {"--svm-c", [](const std::string& value) {
+        svmTrainingOptions().c = parseDoubleOption("--svm-c", value, 1e-6);
+    }},
+    {"--svm-folds", [](const std::string& value) {
+        svmTrainingOptions().num_folds = parseIntOption("--svm-folds", value, 2);
+    }},
+    {"--svm-iterations", [](const std::string& value) {
+        svmTrainingOptions().max_iterations = parseIntOption("--svm-iterations", value, 1);
+    }},
+    {"--detector", [](const std::string& value) {
+        detectionOptions().engine = parseDetectorEngine(value);
+    }},
+    {"--window-angle-step", [](const std::string& value) {
+        detectionOptions().window_angle_step = parseIntOption("--window-angle-step", value, 0);
+    }},
+    {"--hog-engine", [](const std::string& value) {
+        detectionOptions().hog_engine = parseHogEngine(value);
+    }},
+    {"--hog-cell-stride", [](const std::string& value) {
+        const int cell_stride = parseIntOption("--hog-cell-stride", value, 1);
+        if (hog_cell_size % cell_stride != 0)
+            throw std::invalid_argument("Invalid value for option --hog-cell-stride: " + value);
+        detectionOptions().hog_cell_stride = cell_stride;
+    }},
+    {"--feature-type", [](const std::string& value) {
+        featureType = parseFeatureType(value);
+    }}
+};
+
+/**
+ * @brief Applies a command-line option.
+ *
+ * @param[in] name The name of the option (including the leading "--").
+ * @param[in] value The value of the option.
+ *
+ * @throws std::invalid_argument If the option is unknown or its value is not valid.
+ */
+void applyOption(const std::string& name, const std::string& value)
+{
+    auto it = optionSetters.find(name);
+    if (it == optionSetters.end())
+        throw std::invalid_argument("Unknown option: " + name);
+
+    it->second(value);
+}
+
 /**
  * @brief Parses command-line arguments to extract the list of steps to be executed.
  *
  * This function reads command-line arguments and stores them in a vector of steps.
+ * Arguments in the form `--name=value` are options: they are applied immediately
+ * and are not added to the steps.
  *
  * @param[in] argc The number of command-line arguments.
  * @param[in] argv The array of command-line argument strings.
  * @param[out] steps A vector of strings where the parsed steps will be stored.
+ *
+ * @throws std::invalid_argument If an option is unknown or its value is not valid.
+ *
+ * @see applyOption
  */
 void parseArguments(int argc, char** argv, std::vector<std::string>& steps)
 {
     for (int i = 1; i < argc; ++i)
-        steps.emplace_back(argv[i]);
+    {
+        const std::string argument(argv[i]);
+        const auto equal_pos = argument.find('=');
+
+        if (argument.starts_with("--") && equal_pos != std::string::npos)
+            applyOption(argument.substr(0, equal_pos), argument.substr(equal_pos + 1));
+        else
+            steps.emplace_back(argument);
+    }
 }
 
 
@@ -430,7 +713,7 @@ void printHelp()
                Aircraft Detection Project - HELP
 ==============================================================
 
-Usage: program_name [step or option]
+Usage: program_name [--option=value ...] [step or option]
 
 Steps:
 ------
@@ -468,20 +751,285 @@ Steps:
       corresponding YOLO labels to generate training data for an 
       SVM. It performs template matching, classifies points, 
       extracts HOG features for true positives and false 
-      positives, and saves the features to CSV files for SVM 
-      training.
+      positives, and saves the features for SVM training to 
+      the binary feature store svm_training_input/
+      hog_features.bin (see --feature-type). It also records which templates and angles 
+      produce true positives, and their matching time, in a 
+      pruning profile (see --pruning-recall), unless the 
+      matching is itself pruned.
+
+  trainSVM
+    - This step trains a linear SVM on the HOG features saved 
+      by extract_SVM_Training_Data or importFeaturesFromCsv, 
+      with a multithreaded k-fold cross-validation (see 
+      --svm-folds). It saves the SVM used by the detect step 
+      to svm_model/linear_svm.yml and the cross-validated 
+      scores read by Performance_evaluation to 
+      svm_cv_outputs/positive.sco and 
+      svm_cv_outputs/negative.sco.
 
   Performance_evaluation
     - This step evaluates the performance of the SVM model by 
       running a Python script. It checks the accuracy and other 
       performance metrics of the model.
 
+  exportFeaturesToCsv
+    - This step converts the feature store written by 
+      extract_SVM_Training_Data or importFeaturesFromCsv to 
+      the CSV files read by ucasML: svm_training_input/
+      tp_training.csv for the true positives and 
+      svm_training_input/fp_training.csv for the false 
+      positives.
+
+  importFeaturesFromCsv
+    - This step converts the CSV files svm_training_input/
+      tp_training.csv and fp_training.csv (e.g. written by an 
+      earlier version) to the feature store read by trainSVM.
+
+  benchmarkMatching
+    - This step runs the selected template matching mode and 
+      the exhaustive FFT search on the first training images, 
+      and reports their times and how many of the best 
+      exhaustive matches the selected mode recovers.
+
+  evaluateProposals
+    - This step builds the proposal masks (see --proposals) of 
+      the first training images and reports how many YOLO 
+      boxes they keep and how much of the images they keep. 
+      All the proposal methods are compared if none is 
+      selected.
+
+  compactTemplateBank
+    - This step compares the templates of the template bank 
+      two by two, up to a rotation and a small scaling, drops 
+      those redundant with another one (see 
+      --dedup-similarity) and saves the smaller bank in place 
+      of the former. It reports the dropped templates and the 
+      expected saving of matching time. A pruning profile 
+      has to be recorded again afterwards.
+
+  detect
+    - This step detects the airplanes of the images given by 
+      --detect-input: the template matches (or the sliding 
+      windows, see --detector) propose boxes of the SVM 
+      training sizes, the linear SVM (see --svm-model) 
+      scores their HOG features, and non-maximum suppression 
+      removes the overlapping boxes. The detections of every 
+      image are written to detections/<image name>.txt, in 
+      the YOLO label format followed by the SVM score.
+
+  benchmarkHOG
+    - This step computes the HOG descriptors of a dense grid 
+      of ROIs on the first training images, one ROI at a 
+      time, in one parallel batch and with the dense engine 
+      (see --hog-engine), and reports their times and the 
+      similarity of the descriptors. It also times the 
+      specialized HOG kernel against cv::HOGDescriptor.
+
+  evaluateDetectors
+    - This step runs the template matching and the sliding- 
+      window detectors on the first training images, and 
+      reports their times, recall and precision against the 
+      YOLO boxes.
+
 Options:
 --------
 
   --help
     - Show this message and exit.
 
+  --matching-mode=<rotate-scene|rotate-templates|fft|pyramid|oriented|eigen>
+    - Selects how template matching handles rotations: 
+      rotate-scene rotates the whole image once per angle, 
+      rotate-templates correlates pre-rotated, 
+      masked templates against the unrotated image, fft does 
+      the same with an FFT engine that transforms the image 
+      only once and shares the window statistics of the 
+      templates with the same mask, pyramid sweeps the angles on a downsampled 
+      image and refines the best candidates at finer levels, 
+      oriented estimates the rotation around candidate 
+      locations and only correlates there, at that rotation, 
+      eigen correlates the few principal components shared 
+      by the templates and combines their responses. 
+      Default: fft.
+
+  --correlation-backend=<float|int8|separable>
+    - Correlation used by the rotate-scene mode and by the 
+      local searches of the pyramid and oriented modes: 
+      float runs cv::matchTemplate, int8 runs an 8-bit 
+      integer kernel (AVX2, AVX-512 or VNNI, chosen at 
+      runtime) with the same scores in the local searches, 
+      where it is faster than float (whole images stay on 
+      float), separable approximates every template with 
+      a few separable filters in the rotate-scene mode 
+      (see --separable-energy). Default: float.
+
+  --separable-energy=<fraction>
+    - Fraction of the template energy kept by the separable 
+      backend, which sets the number of separable filters. 
+      Default: 0.99.
+
+  --eigen-energy=<fraction>
+    - Fraction of the template energy kept by the eigen mode, 
+      which sets the number of principal components. 
+      Default: 0.99.
+
+  --deadline-ms=<milliseconds>
+    - Time budget of template matching. The (template, angle) 
+      pairs are searched from coarse to fine angles and from 
+      the most to the least contrasted template, until the 
+      deadline expires; the search then returns the matches 
+      found so far. 0 disables the deadline. Default: 0.
+
+  --pruning-recall=<fraction>
+    - Skips the (template, angle) pairs that rarely produce 
+      true positives, according to the profile recorded by 
+      extract_SVM_Training_Data: the pairs with the most hits 
+      per millisecond are kept until they hold this fraction 
+      of the recorded hits. The expected recall loss and 
+      speedup are reported; benchmarkMatching measures them. 
+      Applies to the untiled rotate-scene, rotate-templates 
+      and fft modes. 0 disables pruning. Default: 0.
+
+  --angle-step=<degrees>
+    - Angle step used to sweep the template rotations. 
+      Default: 5.
+
+  --pyramid-levels=<n>
+    - Number of downsampling levels of the pyramid mode 
+      (2 means 1/4 of the resolution). Default: 2.
+
+  --pyramid-candidates=<n>
+    - Number of candidates kept at every pyramid level. 
+      Default: 200.
+
+  --orientation-candidates=<n>
+    - Maximum number of candidate locations searched in 
+      oriented mode. Default: 500.
+
+  --orientation-window=<degrees>
+    - Angles searched on each side of the rotation estimated 
+      in oriented mode. Default: 10.
+
+  --proposals=<none|dog|brightness|variance>
+    - Restricts template matching to the regions proposed by 
+      a cheap prefilter: dog keeps blobs of the template size, 
+      brightness keeps pixels brighter than their surroundings, 
+      variance keeps textured windows. Default: none.
+
+  --proposal-fraction=<fraction>
+    - Fraction of the (downsampled) image kept by the 
+      proposals, before the dilation to the template size. 
+      Default: 0.1.
+
+  --peaks-per-map=<n>
+    - Number of matches extracted from every correlation map 
+      (local maxima, highest first). Default: 1.
+
+  --peak-threshold=<score>
+    - Minimum correlation score of the extracted matches, 
+      from -1 to 1. Default: -1.
+
+  --peak-radius=<pixels>
+    - Minimum distance between two matches extracted from the 
+      same map. 0 selects half the smaller template side. 
+      Default: 0.
+
+  --match-tolerance=<pixels>
+    - Maximum distance between a match and an exhaustive 
+      match for benchmarkMatching to consider them the same. 
+      Default: 4.
+
+  --tile-size=<pixels>
+    - Splits the image into overlapping tiles of this side, 
+      matched in parallel, so that the memory used depends 
+      on the tile size rather than on the image size (large 
+      orthomosaics). Applies to the rotate-templates and fft 
+      modes; 0 disables tiling. Default: 0.
+
+  --spectrum-cache-mb=<megabytes>
+    - Memory of the template spectra kept by the fft mode 
+      for the following images (or tiles) of the same size. 
+      Spectra beyond it are recomputed for every image. 
+      0 disables the cache. Default: 1024.
+
+  --memory-budget-mb=<megabytes>
+    - Memory the parallel tasks (e.g. the template matching 
+      tasks) may allocate at once; tasks wait for admission 
+      when the budget is exhausted. 0 disables the limit. 
+      Default: 4096.
+
+  --benchmark-images=<n>
+    - Number of training images used by benchmarkMatching, 
+      evaluateProposals, benchmarkHOG and evaluateDetectors. 
+      Default: 3.
+
+  --dedup-similarity=<score>
+    - Correlation from which compactTemplateBank considers 
+      two templates redundant. Default: 0.95.
+
+  --detect-input=<path>
+    - Image, or directory of .jpg and .png images, processed 
+      by the detect step.
+
+  --svm-model=<path>
+    - Linear SVM model used by the detect step: a YAML file 
+      holding the "weights" vector and the "bias". 
+      Default: svm_model/linear_svm.yml.
+
+  --detection-threshold=<score>
+    - Minimum SVM score of a detection. Default: 0.
+
+  --nms-iou=<fraction>
+    - Intersection over union from which the weaker of two 
+      detections is suppressed. Default: 0.3.
+
+  --detector=<matching|sliding-window>
+    - Selects how the detect step proposes boxes: matching 
+      centers them on the template matches, sliding-window 
+      scores every window of the dense HOG cells (see 
+      --hog-cell-stride) at the SVM training sizes and at 
+      several rotations, without template matching. 
+      Default: matching.
+
+  --window-angle-step=<degrees>
+    - Angle step of the image rotations, from 0 to 90 
+      degrees, scanned by the sliding-window detector. 0 
+      scans the unrotated image only. Default: 30.
+
+  --hog-engine=<roi|dense>
+    - How the detect step computes the HOG descriptors: roi 
+      resizes every ROI to the HOG window, dense computes the 
+      cell histograms once per image and ROI size and 
+      assembles the descriptors of all the ROIs from them. 
+      Default: roi.
+
+  --hog-cell-stride=<pixels>
+    - Distance between two cells of the dense HOG engine and 
+      of the sliding-window detector: 1, 2, 4 or 8. Smaller 
+      strides place the ROIs more accurately, at a higher 
+      cost. Default: 4.
+
+  --svm-c=<cost>
+    - Cost of the margin violations in trainSVM (larger 
+      values fit the training samples more closely). The cost 
+      of each class is balanced by its frequency. Default: 1.
+
+  --svm-folds=<n>
+    - Number of cross-validation folds of trainSVM. 
+      Default: 5.
+
+  --svm-iterations=<n>
+    - Maximum number of passes of the trainSVM solver over 
+      the samples. Default: 1000.
+
+  --feature-type=<float32|float16|uint8>
+    - Type the HOG features are stored as by 
+      extract_SVM_Training_Data and importFeaturesFromCsv: 
+      float16 halves the size of the feature store, uint8 
+      quantizes the features to 256 levels and quarters it. 
+      Default: float32.
+
 ==============================================================
     )";
 }
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "proposals.h"
+
+#include "orientation_estimation.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+
+
+/**
+ * @brief Parses the name of a proposal method.
+ *
+ * @param[in] method The name of the method: "none", "dog", "brightness" or "variance".
+ * @return The corresponding `ProposalMethod`.
+ *
+ * @throws std::invalid_argument If the name is not a known method.
+ */
+ProposalMethod parseProposalMethod(const std::string& method)
+{
+    if (method == "none")
+        return ProposalMethod::None;
+    if (method == "dog")
+        return ProposalMethod::DifferenceOfGaussians;
+    if (method == "brightness")
+        return ProposalMethod::Brightness;
+    if (method == "variance")
+        return ProposalMethod::Variance;
+
+    throw std::invalid_argument("Unknown proposal method: " + method);
+}
+
+/**
+ * @brief Computes the threshold keeping the highest values of a response map.
+ *
+ * @param[in] response The `CV_32F` response map.
+ * @param[in] keep_fraction The fraction of the values to keep, in (0, 1].
+ * @return The smallest value among the `keep_fraction` highest ones.
+ *
+ * @see std::nth_element
+ */
+float fractionThreshold(const cv::Mat& response, double keep_fraction)
+{
+    std::vector<float> values;
+    values.reserve(response.total());
+    for (int row = 0; row < response.rows; row++)
+    {
+        const float* response_row = response.ptr<float>(row);
+        values.insert(values.end(), response_row, response_row + response.cols);
+    }
+
+    const size_t kept = std::clamp<size_t>(static_cast<size_t>(keep_fraction * values.size()), 1, values.size());
+    std::nth_element(values.begin(), values.begin() + (kept - 1), values.end(), std::greater<float>());
+    return values[kept - 1];
+}
+
+/**
+ * @brief Computes the response map of a proposal method.
+ *
+ * @param[in] img The downsampled grayscale image.
+ * @param[in] method The proposal method.
+ * @param[in] object_size The size of the objects, in pixels of the downsampled image.
+ * @return The `CV_32F` response map, of the size of the image: the higher, the more likely an object.
+ *
+ * @see localVariance
+ */
+cv::Mat proposalResponse(const cv::Mat& img, ProposalMethod method, cv::Size object_size)
+{
+    cv::Mat img_32f;
+    img.convertTo(img_32f, CV_32F);
+
+    cv::Mat response;
+    switch (method)
+    {
+    case ProposalMethod::DifferenceOfGaussians:
+    {
+        // A blob of radius r responds the most to a DoG of scale r / sqrt(2)
+        const double sigma = std::max(1.0, std::min(object_size.width, object_size.height) / (2.0 * std::sqrt(2.0)));
+        cv::Mat fine_blur, coarse_blur;
+        cv::GaussianBlur(img_32f, fine_blur, cv::Size(), sigma);
+        cv::GaussianBlur(img_32f, coarse_blur, cv::Size(), 1.6 * sigma);
+        cv::absdiff(fine_blur, coarse_blur, response);
+        break;
+    }
+    case ProposalMethod::Brightness:
+    {
+        // The quantity compared to the constant of cv::adaptiveThreshold with cv::ADAPTIVE_THRESH_GAUSSIAN_C
+        int block_size = std::max(object_size.width, object_size.height);
+        if (block_size % 2 == 0)
+            block_size += 1;
+
+        cv::Mat local_mean;
+        cv::GaussianBlur(img_32f, local_mean, cv::Size(block_size, block_size), 0);
+        response = img_32f - local_mean;
+        break;
+    }
+    case ProposalMethod::Variance:
+    {
+        // The variance map is indexed by the window top-left corners: it is moved to the window centers
+        const cv::Size window_size(std::min(object_size.width, img.cols), std::min(object_size.height, img.rows));
+        const cv::Mat variance = localVariance(img, window_size);
+        const int left = window_size.width / 2, top = window_size.height / 2;
+        cv::copyMakeBorder(variance, response, top, img.rows - variance.rows - top, left, img.cols - variance.cols - left, cv::BORDER_REPLICATE);
+        break;
+    }
+    default:
+        response = cv::Mat::ones(img.size(), CV_32F);
+        break;
+    }
+    return response;
+}
+
+/**
+ * @brief Builds the mask of the regions of an image worth searching for objects.
+ *
+ * The response of the proposal method is computed on a copy of the image downsampled so that the objects are
+ * about 16 pixels wide, which is enough for such coarse cues. The `keep_fraction` highest responses are kept,
+ * then dilated by the object size, so that every window centered on a kept response is in the mask.
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[in] method The proposal method. `ProposalMethod::None` selects the whole image.
+ * @param[in] keep_fraction The fraction of the (downsampled) pixels kept before the dilation, in (0, 1].
+ * @param[in] object_size The size of the smallest objects searched (e.g. of the smallest template).
+ * @return A `CV_8U` mask of the size of the image, set to 255 where objects may be centered.
+ *
+ * @see proposalResponse
+ * @see fractionThreshold
+ */
+cv::Mat proposeRegions(const cv::Mat& gray_img, ProposalMethod method, double keep_fraction, cv::Size object_size)
+{
+    if (method == ProposalMethod::None)
+        return cv::Mat(gray_img.size(), CV_8U, cv::Scalar(255));
+
+    constexpr int proposal_object_side = 16;
+    const int scale = std::max(1, std::min(object_size.width, object_size.height) / proposal_object_side);
+    const cv::Size scaled_object_size(std::max(1, object_size.width / scale), std::max(1, object_size.height / scale));
+
+    cv::Mat small_img;
+    cv::resize(gray_img, small_img, cv::Size(std::max(1, gray_img.cols / scale), std::max(1, gray_img.rows / scale)), 0, 0, cv::INTER_AREA);
+
+    const cv::Mat response = proposalResponse(small_img, method, scaled_object_size);
+    cv::Mat small_mask = response >= fractionThreshold(response, keep_fraction);
+    cv::dilate(small_mask, small_mask, cv::getStructuringElement(cv::MORPH_ELLIPSE, scaled_object_size));
+
+    cv::Mat mask;
+    cv::resize(small_mask, mask, gray_img.size(), 0, 0, cv::INTER_NEAREST);
+    return mask;
+}
+
+/**
+ * @brief Turns a proposal mask into a few rectangular regions to be searched.
+ *
+ * Every connected component of the mask gives its bounding box, enlarged by `margin` on every side so that
+ * the windows centered in the component fit in the region, and at least as large as `min_region_size`.
+ * Overlapping regions are merged, so no part of the image is searched twice.
+ *
+ * @param[in] mask The `CV_8U` proposal mask.
+ * @param[in] margin The margin added around every component, e.g. half the largest template side.
+ * @param[in] min_region_size The minimum size of a region, e.g. the largest template size.
+ * @return The regions, inside the image and pairwise disjoint.
+ *
+ * @see cv::findContours
+ */
+std::vector<cv::Rect> proposalRegions(const cv::Mat& mask, int margin, cv::Size min_region_size)
+{
+    const cv::Rect image_rect(0, 0, mask.cols, mask.rows);
+    auto fit_region = [&](cv::Rect region)
+    {
+        region = cv::Rect(region.x - margin, region.y - margin, region.width + 2 * margin, region.height + 2 * margin) & image_rect;
+
+        // Regions at the image border are grown inwards
+        const int width = std::min(std::max(region.width, min_region_size.width), image_rect.width);
+        const int height = std::min(std::max(region.height, min_region_size.height), image_rect.height);
+        const int x = std::clamp(region.x + region.width / 2 - width / 2, 0, image_rect.width - width);
+        const int y = std::clamp(region.y + region.height / 2 - height / 2, 0, image_rect.height - height);
+        return cv::Rect(x, y, width, height);
+    };
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(mask.clone(), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    std::vector<cv::Rect> regions;
+    for (const auto& contour : contours)
+        regions.push_back(fit_region(cv::boundingRect(contour)));
+
+    // Merging two regions may make the merged one overlap a third one, so merge until nothing changes
+    for (bool merged = true; merged;)
+    {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < regions.size(); j++)
+            {
+                if ((regions[i] & regions[j]).area() > 0)
+                {
+                    regions[i] |= regions[j];
+                    regions.erase(regions.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+    return regions;
+}
+
+/**
+ * @brief Measures the fraction of the objects a proposal mask keeps.
+ *
+ * An object is kept if its center is in the mask, since the matching windows are only searched around the
+ * centers in the mask.
+ *
+ * @param[in] mask The `CV_8U` proposal mask.
+ * @param[in] boxes The ground truth boxes of the objects (e.g. the YOLO boxes).
+ * @return The fraction of the boxes whose center is in the mask, 1 if there is no box.
+ */
+double proposalRecall(const cv::Mat& mask, const std::vector<cv::Rect>& boxes)
+{
+    if (boxes.empty())
+        return 1.0;
+
+    const cv::Rect image_rect(0, 0, mask.cols, mask.rows);
+    size_t kept = 0;
+    for (const auto& box : boxes)
+    {
+        const cv::Point center(box.x + box.width / 2, box.y + box.height / 2);
+        if (image_rect.contains(center) && mask.at<uchar>(center) != 0)
+            kept++;
+    }
+    return static_cast<double>(kept) / boxes.size();
+}
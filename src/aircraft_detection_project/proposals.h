@@ -0,0 +1,22 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+
+enum class ProposalMethod
+{
+    None,                  // no proposal stage: the whole scene is searched
+    DifferenceOfGaussians, // blobs of the size of the templates
+    Brightness,            // pixels brighter than their neighbourhood, as in the adaptive threshold of binarizeAirplanes
+    Variance               // textured windows of the size of the templates
+};
+
+ProposalMethod parseProposalMethod(const std::string& method);
+
+cv::Mat proposeRegions(const cv::Mat& gray_img, ProposalMethod method, double keep_fraction, cv::Size object_size);
+
+std::vector<cv::Rect> proposalRegions(const cv::Mat& mask, int margin, cv::Size min_region_size);
+
+double proposalRecall(const cv::Mat& mask, const std::vector<cv::Rect>& boxes);
@@ -0,0 +1,128 @@
+#include "rotation_cache.h"
+
+#include "thread_pool.h"
+#include "utils.h"
+
+
+
+/**
+ * @brief Computes the affine transformation rotating an image around its center into its bounding box.
+ *
+ * @param[in] src_size The size of the image to be rotated.
+ * @param[in] degree_angle The angle in degrees by which the image should be rotated (counter-clockwise).
+ * @param[out] rotated_size The size of the bounding box of the rotated image.
+ * @return The `CV_64F` 2x3 affine transformation from the image to the rotated one.
+ *
+ * @see cv::getRotationMatrix2D
+ * @see cv::RotatedRect
+ */
+cv::Mat rotationMatrix(cv::Size src_size, int degree_angle, cv::Size& rotated_size)
+{
+    cv::Point rot_center = cv::Point(src_size.width / 2.0f, src_size.height / 2.0f);
+    cv::Mat rotation_mat = cv::getRotationMatrix2D(rot_center, degree_angle, 1);
+    cv::Rect2f bbox = cv::RotatedRect(cv::Point2f(), src_size, degree_angle).boundingRect2f();
+    rotation_mat.at<double>(0, 2) += bbox.width / 2.0f - rot_center.x;
+    rotation_mat.at<double>(1, 2) += bbox.height / 2.0f - rot_center.y;
+
+    rotated_size = bbox.size();
+    return rotation_mat;
+}
+
+/**
+ * @brief Rotates an image by a specified angle.
+ *
+ * This function rotates the given image by a specified angle around its center.
+ * It adjusts the bounding box to ensure the entire rotated image fits within the resulting image.
+ *
+ * @param[in] src_img The source image to be rotated.
+ * @param[in] degree_angle The angle in degrees by which the image should be rotated.
+ * @param[in] interpolation The interpolation method passed to `cv::warpAffine` (bilinear by default).
+ * @return A `cv::Mat` object containing the rotated image.
+ *
+ * @note The function uses the center of the image as the rotation point and adjusts the translation
+ *       to ensure the entire rotated image fits within the new bounding box.
+ *
+ * @see rotationMatrix
+ * @see cv::warpAffine
+ */
+cv::Mat rotateImage(const cv::Mat& src_img, int degree_angle, int interpolation)
+{
+    cv::Size rotated_size;
+    const cv::Mat rotation_mat = rotationMatrix(src_img.size(), degree_angle, rotated_size);
+
+    cv::Mat dst;
+    cv::warpAffine(src_img, dst, rotation_mat, rotated_size, interpolation);
+    return dst;
+}
+
+/**
+ * @brief Warps the scene once for every distinct angle modulo 90 degrees.
+ *
+ * Only the angles in [0, 90) are interpolated: every other angle is a lossless 90, 180 or 270 degree rotation
+ * of one of them (see `rotated`). The warps run in parallel on the shared thread pool.
+ *
+ * @param[in] src_img The source image.
+ * @param[in] degree_angles The angles, in degrees, the scene will be rotated by.
+ *
+ * @see rotationMatrix
+ * @see sharedThreadPool
+ */
+RotationCache::RotationCache(const cv::Mat& src_img, const std::vector<int>& degree_angles)
+{
+    for (int degree_angle : degree_angles)
+        base_rotations[((degree_angle % 90) + 90) % 90];
+
+    std::vector<std::future<void>> futures;
+    for (auto& [base_angle, base_rotation] : base_rotations)
+    {
+        futures.emplace_back(sharedThreadPool().submit([&src_img, base_angle = base_angle, &base_rotation = base_rotation]() {
+            cv::Size rotated_size;
+            base_rotation.rotation_mat = rotationMatrix(src_img.size(), base_angle, rotated_size);
+            cv::warpAffine(src_img, base_rotation.image, base_rotation.rotation_mat, rotated_size, cv::INTER_LINEAR);
+            }));
+    }
+    sharedThreadPool().waitAll(futures);
+}
+
+/**
+ * @brief Returns the scene rotated by an angle, derived from the cached warp of the same quadrant.
+ *
+ * The cached warp of the angle modulo 90 is turned by the remaining multiple of 90 degrees with `rotate90`
+ * (transpose and flip, no interpolation), and its affine transformation is composed with the one of the
+ * quarter turn, so the points found in the rotated scene can still be mapped back to the source image.
+ *
+ * @param[in] degree_angle The angle in degrees (counter-clockwise). Its value modulo 90 must be among the
+ *                         angles the cache was built for.
+ * @return The rotated scene and its affine transformation from the source image.
+ *
+ * @throws std::out_of_range If the cache has no warp for the angle modulo 90.
+ *
+ * @see rotate90
+ */
+RotatedScene RotationCache::rotated(int degree_angle) const
+{
+    const int wrapped_angle = ((degree_angle % 360) + 360) % 360;
+    const RotatedScene& base_rotation = base_rotations.at(wrapped_angle % 90);
+
+    // A counter-clockwise quarter turn is a clockwise turn of three quarters
+    const int clockwise_steps = (4 - wrapped_angle / 90) % 4;
+    if (clockwise_steps == 0)
+        return base_rotation;
+
+    const double last_col = base_rotation.image.cols - 1;
+    const double last_row = base_rotation.image.rows - 1;
+    cv::Mat quarter_turn;
+    if (clockwise_steps == 1)
+        quarter_turn = (cv::Mat_<double>(2, 3) << 0, -1, last_row, 1, 0, 0);
+    else if (clockwise_steps == 2)
+        quarter_turn = (cv::Mat_<double>(2, 3) << -1, 0, last_col, 0, -1, last_row);
+    else
+        quarter_turn = (cv::Mat_<double>(2, 3) << 0, 1, 0, -1, 0, last_col);
+
+    RotatedScene rotated_scene;
+    rotated_scene.image = rotate90(base_rotation.image, clockwise_steps);
+    rotated_scene.rotation_mat = quarter_turn.colRange(0, 2) * base_rotation.rotation_mat;
+    rotated_scene.rotation_mat.at<double>(0, 2) += quarter_turn.at<double>(0, 2);
+    rotated_scene.rotation_mat.at<double>(1, 2) += quarter_turn.at<double>(1, 2);
+    return rotated_scene;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <vector>
+
+
+struct RotatedScene
+{
+    cv::Mat image;        // the rotated scene, enlarged to its bounding box
+    cv::Mat rotation_mat; // CV_64F 2x3 affine transformation from the source to the rotated scene
+};
+
+cv::Mat rotationMatrix(cv::Size src_size, int degree_angle, cv::Size& rotated_size);
+
+cv::Mat rotateImage(const cv::Mat& src_img, int degree_angle, int interpolation = cv::INTER_LINEAR);
+
+class RotationCache
+{
+public:
+    RotationCache(const cv::Mat& src_img, const std::vector<int>& degree_angles);
+
+    RotatedScene rotated(int degree_angle) const;
+
+    size_t numWarps() const { return base_rotations.size(); }
+
+private:
+    std::map<int, RotatedScene> base_rotations;
+};
@@ -0,0 +1,105 @@
+#include "separable_correlation.h"
+
+#include "fft_correlation.h"
+
+
+
+/**
+ * @brief Decomposes a template into a sum of separable (rank-1) filters.
+ *
+ * The zero-mean template is decomposed by SVD, T = sum_k s_k * u_k * v_k^T, and the first r components are kept,
+ * with r the smallest rank whose singular values hold `energy_threshold` of the total energy (sum of s_k^2).
+ * Each component becomes a column filter sqrt(s_k) * u_k and a row filter sqrt(s_k) * v_k^T. The eigenplane
+ * templates are smooth, so a few components usually reach a high energy threshold.
+ *
+ * @param[in] templ The grayscale template.
+ * @param[in] energy_threshold The fraction of the template energy to keep, in (0, 1].
+ * @return A `SeparableTemplate` holding the filters, the statistics of the approximation and its error.
+ *
+ * @see cv::SVD
+ */
+SeparableTemplate decomposeTemplate(const cv::Mat& templ, double energy_threshold)
+{
+    const PreparedTemplate prepared_template = prepareTemplate(templ);
+
+    cv::Mat singular_values, u, vt;
+    cv::SVD::compute(prepared_template.kernel, singular_values, u, vt);
+    singular_values.convertTo(singular_values, CV_64F);
+
+    const double total_energy = cv::sum(singular_values.mul(singular_values))[0];
+
+    SeparableTemplate separable_template;
+    separable_template.size = templ.size();
+
+    double kept_energy = 0.0;
+    cv::Mat approximation = cv::Mat::zeros(templ.size(), CV_32F);
+    for (int k = 0; k < singular_values.rows; k++)
+    {
+        const double singular_value = singular_values.at<double>(k);
+        if (singular_value <= 0.0 || (k > 0 && kept_energy >= energy_threshold * total_energy))
+            break;
+
+        const double scale = std::sqrt(singular_value);
+        separable_template.column_filters.push_back(u.col(k) * scale);
+        separable_template.row_filters.push_back(vt.row(k) * scale);
+        approximation += separable_template.column_filters.back() * separable_template.row_filters.back();
+
+        kept_energy += singular_value * singular_value;
+    }
+
+    separable_template.reconstruction_error = total_energy > 0.0 ? std::sqrt(std::max(total_energy - kept_energy, 0.0) / total_energy) : 0.0;
+
+    // The approximation of a zero-mean template is not exactly zero-mean: its own mean and norm are used for
+    // the normalization, so the scores are the exact normalized cross-correlation of the approximation
+    separable_template.mean = cv::mean(approximation)[0];
+    separable_template.norm = cv::norm(approximation - separable_template.mean, cv::NORM_L2);
+    return separable_template;
+}
+
+/**
+ * @brief Computes the normalized cross-correlation map of a separable template.
+ *
+ * The raw correlation is the sum of one `cv::sepFilter2D` per component, i.e. 2r one-dimensional passes instead
+ * of a dense two-dimensional correlation. It is made zero-mean with the window sums of the scene and normalized
+ * with its integral images, as for the FFT engine.
+ *
+ * @param[in] scene The grayscale scene.
+ * @param[in] separable_template The decomposed template. It must not be larger than the scene.
+ * @return A `CV_32F` map of size (W - w + 1) x (H - h + 1), as returned by `cv::matchTemplate`.
+ *
+ * @throws std::invalid_argument If the template is larger than the scene.
+ *
+ * @see decomposeTemplate
+ * @see cv::sepFilter2D
+ * @see normalizeCorrelation
+ */
+cv::Mat separableNormalizedCorrelation(const cv::Mat& scene, const SeparableTemplate& separable_template)
+{
+    const cv::Size template_size = separable_template.size;
+    if (template_size.width > scene.cols || template_size.height > scene.rows)
+        throw std::invalid_argument("The template is larger than the scene.");
+
+    const cv::Size result_size(scene.cols - template_size.width + 1, scene.rows - template_size.height + 1);
+    const cv::Rect valid_area(cv::Point(0, 0), result_size);
+
+    cv::Mat scene_32f;
+    scene.convertTo(scene_32f, CV_32F);
+
+    // With the anchor in the top-left corner, the filter response at (x, y) covers the template window at (x, y)
+    cv::Mat correlation = cv::Mat::zeros(result_size, CV_32F);
+    cv::Mat component_correlation;
+    for (size_t k = 0; k < separable_template.row_filters.size(); k++)
+    {
+        cv::sepFilter2D(scene_32f, component_correlation, CV_32F, separable_template.row_filters[k], separable_template.column_filters[k], cv::Point(0, 0), 0.0, cv::BORDER_CONSTANT);
+        correlation += component_correlation(valid_area);
+    }
+
+    cv::Mat integral_sum, integral_sqsum;
+    cv::integral(scene, integral_sum, integral_sqsum, CV_64F, CV_64F);
+
+    cv::Mat window_sum;
+    windowSums(integral_sum, template_size, result_size).convertTo(window_sum, CV_32F);
+    correlation -= window_sum * separable_template.mean;
+
+    return normalizeCorrelation(correlation, integral_sum, integral_sqsum, template_size, separable_template.norm);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+struct SeparableTemplate
+{
+    cv::Size size;
+    std::vector<cv::Mat> column_filters;   // CV_32F, h x 1, one per component
+    std::vector<cv::Mat> row_filters;      // CV_32F, 1 x w, one per component
+    double mean = 0.0;                     // mean of the low-rank approximation
+    double norm = 0.0;                     // L2 norm of the zero-mean low-rank approximation
+    double reconstruction_error = 0.0;     // relative Frobenius error of the approximation of the zero-mean template
+};
+
+SeparableTemplate decomposeTemplate(const cv::Mat& templ, double energy_threshold);
+
+cv::Mat separableNormalizedCorrelation(const cv::Mat& scene, const SeparableTemplate& separable_template);
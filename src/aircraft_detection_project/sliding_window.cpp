@@ -0,0 +1,205 @@
+#include "sliding_window.h"
+
+#include "dense_hog.h"
+#include "hog_features_extraction.h"
+#include "peak_extraction.h"
+#include "rotation_cache.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <stdexcept>
+
+
+
+/**
+ * @brief Reorders the weights of a HOG SVM so that every row of cells of the window is contiguous.
+ *
+ * The descriptors of `cv::HOGDescriptor` list the blocks in column-major order. The weights are rearranged in
+ * row-major order (the order of the cell grid of `DenseHog`), so that the weights of a row of cells can be
+ * applied to the cells of the grid with a single dot product.
+ *
+ * @param[in] svm The linear SVM trained on the HOG descriptors.
+ * @return The `hog_descriptor_size` weights, row of cells by row of cells.
+ *
+ * @throws std::invalid_argument If the SVM does not have one weight per HOG feature.
+ */
+std::vector<float> rowMajorHogWeights(const LinearSvm& svm)
+{
+    if (svm.weights.size() != static_cast<size_t>(hog_descriptor_size))
+        throw std::invalid_argument("The SVM has " + std::to_string(svm.weights.size()) + " weights, the HOG descriptors " + std::to_string(hog_descriptor_size) + " features.");
+
+    std::vector<float> row_major_weights(hog_descriptor_size);
+    for (int block_x = 0; block_x < hog_cells_per_side; block_x++)
+    {
+        for (int block_y = 0; block_y < hog_cells_per_side; block_y++)
+        {
+            const auto block_weights = svm.weights.begin() + (block_x * hog_cells_per_side + block_y) * hog_num_bins;
+            std::copy(block_weights, block_weights + hog_num_bins, row_major_weights.begin() + (block_y * hog_cells_per_side + block_x) * hog_num_bins);
+        }
+    }
+    return row_major_weights;
+}
+
+/**
+ * @brief Scores every window of a HOG level with a linear SVM.
+ *
+ * The windows are placed on every cell of the grid. The cells of a window are `hog_cell_size / cell_stride`
+ * grid positions apart, so the columns of the grid are first split by phase (column modulo that step): in every
+ * phase, the cells of a row of the window are contiguous, and the score of a window is the sum of one SIMD dot
+ * product per row of cells, i.e. O(blocks) work per window.
+ *
+ * @param[in] level The HOG level.
+ * @param[in] row_major_weights The SVM weights, reordered by `rowMajorHogWeights`.
+ * @param[in] bias The SVM bias.
+ * @param[in] cell_stride The cell stride of the level.
+ * @return A `CV_32F` map with the score of the window whose top-left cell is at each grid position.
+ *
+ * @see dotProduct
+ */
+cv::Mat slidingWindowScores(const HogLevel& level, const std::vector<float>& row_major_weights, float bias, int cell_stride)
+{
+    const int cell_step = hog_cell_size / cell_stride;
+    const int window_span = (hog_cells_per_side - 1) * cell_step + 1;
+    const int grid_cols = level.cells.cols / hog_num_bins;
+    const int grid_rows = level.cells.rows;
+    const int row_length = hog_cells_per_side * hog_num_bins;
+
+    cv::Mat scores(grid_rows - window_span + 1, grid_cols - window_span + 1, CV_32F);
+    for (int phase = 0; phase < cell_step && phase < scores.cols; phase++)
+    {
+        // Columns phase, phase + cell_step, ... of the grid, side by side
+        const int phase_cols = (grid_cols - phase + cell_step - 1) / cell_step;
+        cv::Mat phase_cells(grid_rows, phase_cols * hog_num_bins, CV_32F);
+        for (int col = 0; col < phase_cols; col++)
+        {
+            const int grid_col = phase + col * cell_step;
+            cv::Mat phase_col = phase_cells.colRange(col * hog_num_bins, (col + 1) * hog_num_bins);
+            level.cells.colRange(grid_col * hog_num_bins, (grid_col + 1) * hog_num_bins).copyTo(phase_col);
+        }
+
+        for (int y = 0; y < scores.rows; y++)
+        {
+            float* scores_row = scores.ptr<float>(y);
+            for (int col = 0; phase + col * cell_step < scores.cols; col++)
+            {
+                float score = bias;
+                for (int block_y = 0; block_y < hog_cells_per_side; block_y++)
+                {
+                    const float* cells = phase_cells.ptr<float>(y + block_y * cell_step) + col * hog_num_bins;
+                    score += dotProduct(row_major_weights.data() + block_y * row_length, cells, row_length);
+                }
+                scores_row[phase + col * cell_step] = score;
+            }
+        }
+    }
+    return scores;
+}
+
+/**
+ * @brief Estimates the memory held by the task scanning one rotation of the image, for the admission of the pool tasks.
+ *
+ * The task keeps the rotated image, and the cells and the score map of every level until its detections are
+ * extracted. The temporaries of the HOG levels are charged by the `DenseHog` tasks themselves.
+ *
+ * @param[in] rotated_size The size of the rotated image.
+ * @param[in] window_sizes The window sizes scanned.
+ * @param[in] cell_stride The cell stride of the levels.
+ * @return The estimated number of bytes.
+ *
+ * @see denseHogLevelMemory
+ */
+size_t slidingWindowTaskMemory(cv::Size rotated_size, const std::vector<cv::Size>& window_sizes, int cell_stride)
+{
+    size_t memory = static_cast<size_t>(rotated_size.area()) * sizeof(uchar);
+    for (const auto& window_size : window_sizes)
+    {
+        if (window_size.empty())
+            continue;
+
+        // One histogram and one score per grid position of the level
+        const double level_area = rotated_size.area() * (static_cast<double>(hog_window_size) / window_size.width) * (static_cast<double>(hog_window_size) / window_size.height);
+        memory += static_cast<size_t>(level_area / (cell_stride * cell_stride)) * (hog_num_bins + 1) * sizeof(float);
+    }
+    return memory;
+}
+
+/**
+ * @brief Detects the airplanes of an image by scanning the HOG cells with a linear SVM, without template matching.
+ *
+ * The image is rotated by every angle of [0, 90) with the window angle step (the SVM is trained on upright boxes
+ * of aircraft in any orientation, so quarter turns add no new view). For every rotation, the dense HOG cells are
+ * computed at one scale per window size (see `DenseHog`), every window of every scale is scored (see
+ * `slidingWindowScores`), and the local maxima of the score maps above the score threshold become detections. A
+ * detection is the upright box of its window size centered on the window center mapped back to the image, as the
+ * ROIs of the template matching engine. The rotations are processed in parallel on the shared thread pool, each
+ * task declaring its memory (see `slidingWindowTaskMemory`), and the detections of all the rotations and scales
+ * go through non-maximum suppression.
+ *
+ * @param[in] gray_img The grayscale image.
+ * @param[in] svm The linear SVM trained on the HOG features.
+ * @param[in] window_sizes The window sizes scanned, i.e. the sizes of the SVM training ROIs.
+ * @param[in] options The detection options (score threshold, NMS overlap, cell stride and angle step).
+ * @return The detections, sorted by descending score.
+ *
+ * @see rowMajorHogWeights
+ * @see slidingWindowTaskMemory
+ * @see slidingWindowScores
+ * @see extractPeaks
+ * @see nonMaximumSuppression
+ */
+std::vector<Detection> slidingWindowDetection(const cv::Mat& gray_img, const LinearSvm& svm, const std::vector<cv::Size>& window_sizes, const DetectionOptions& options)
+{
+    // Local maxima kept per score map, before non-maximum suppression
+    constexpr int max_peaks_per_map = 1000;
+
+    const std::vector<float> row_major_weights = rowMajorHogWeights(svm);
+    const int cell_stride = options.hog_cell_stride;
+
+    std::vector<int> degree_angles = { 0 };
+    for (int degree_angle = options.window_angle_step; options.window_angle_step > 0 && degree_angle < 90; degree_angle += options.window_angle_step)
+        degree_angles.push_back(degree_angle);
+
+    std::vector<std::future<std::vector<Detection>>> futures;
+    for (const int degree_angle : degree_angles)
+    {
+        cv::Size rotated_size;
+        const cv::Mat rotation_mat = rotationMatrix(gray_img.size(), degree_angle, rotated_size);
+
+        futures.emplace_back(sharedThreadPool().submit([&gray_img, &svm, &window_sizes, &options, &row_major_weights, cell_stride, degree_angle, rotation_mat, rotated_size]() {
+            cv::Mat inverse_rotation_mat;
+            cv::invertAffineTransform(rotation_mat, inverse_rotation_mat);
+
+            cv::Mat rotated_img;
+            cv::warpAffine(gray_img, rotated_img, rotation_mat, rotated_size, cv::INTER_LINEAR);
+
+            std::vector<Detection> detections;
+            const DenseHog hog(rotated_img, window_sizes, cell_stride);
+            for (const HogLevel& level : hog.levels())
+            {
+                const cv::Mat scores = slidingWindowScores(level, row_major_weights, svm.bias, cell_stride);
+                const int radius = hog_cells_per_side * (hog_cell_size / cell_stride) / 2;
+                for (const Peak& peak : extractPeaks(scores, max_peaks_per_map, options.score_threshold, radius))
+                {
+                    // Window center in the rotated image, then in the source image
+                    const double center_x = (peak.location.x * cell_stride + hog_window_size / 2.0) / level.scale_x;
+                    const double center_y = (peak.location.y * cell_stride + hog_window_size / 2.0) / level.scale_y;
+                    const double* inverse_row0 = inverse_rotation_mat.ptr<double>(0);
+                    const double* inverse_row1 = inverse_rotation_mat.ptr<double>(1);
+                    const cv::Point center(
+                        cvRound(inverse_row0[0] * center_x + inverse_row0[1] * center_y + inverse_row0[2]),
+                        cvRound(inverse_row1[0] * center_x + inverse_row1[1] * center_y + inverse_row1[2]));
+
+                    // The windows centered in the corners added by the rotation are not in the image
+                    const cv::Rect box(center.x - level.window_size.width / 2, center.y - level.window_size.height / 2, level.window_size.width, level.window_size.height);
+                    if (isRoiInImage(box, gray_img.size()))
+                        detections.push_back({ box, peak.score, -1, degree_angle });
+                }
+            }
+            return detections;
+            }, slidingWindowTaskMemory(rotated_size, window_sizes, cell_stride)));
+    }
+
+    std::vector<Detection> detections;
+    for (auto& angle_detections : sharedThreadPool().waitAll(futures))
+        detections.insert(detections.end(), angle_detections.begin(), angle_detections.end());
+    return nonMaximumSuppression(std::move(detections), options.nms_iou);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "dense_hog.h"
+#include "detection.h"
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+
+std::vector<float> rowMajorHogWeights(const LinearSvm& svm);
+
+cv::Mat slidingWindowScores(const HogLevel& level, const std::vector<float>& row_major_weights, float bias, int cell_stride);
+
+std::vector<Detection> slidingWindowDetection(const cv::Mat& gray_img, const LinearSvm& svm, const std::vector<cv::Size>& window_sizes, const DetectionOptions& options);
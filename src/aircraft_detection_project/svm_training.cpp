@@ -1,9 +1,19 @@
 #include "svm_training.h"
 
 #include "utils.h"
+#include "feature_store.h"
 #include "hog_features_extraction.h"
 #include "template_matching.h"
+#include "matching_profile.h"
+#include "linear_svm.h"
+#include "thread_pool.h"
+#include "bounded_queue.h"
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <thread>
 #include <random>
+#include <iomanip>
 #include <filesystem>
 #include <iostream>
 #include <vector>
@@ -18,7 +28,7 @@ void classifyPointsByYoloBoxes(const std::vector<cv::Rect>& yolo_boxes, const st
 
 std::vector<cv::Rect> selectROIsWithHighestIoU(const std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>>& yoloBox_roi_pairs);
 
-std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRois(const std::vector<cv::Rect>& yolo_boxes, const std::vector<cv::Point>& max_corr_tp);
+std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRois(const std::vector<cv::Rect>& yolo_boxes, const std::vector<cv::Point>& max_corr_tp, const cv::Size& image_size);
 //==============================================================================
 
 
@@ -31,27 +41,41 @@ std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRo
 // =============================================================================
 
 /**
- * @brief Generates SVM training data by extracting HOG features and saving them to CSV files.
+ * @brief Generates SVM training data by extracting HOG features and saving them to a feature store.
  *
  * This function processes a dataset of images and their corresponding YOLO labels to generate training data for an SVM.
  * It performs template matching, classifies points based on their location relative to YOLO bounding boxes,
- * extracts HOG features for true positives and false positives, and saves the features to CSV files.
+ * extracts HOG features for true positives and false positives, and saves the features to a binary feature store.
  *
  * The function performs the following steps:
  * 1. Lists directories for k-means clustering by size and calculates average dimensions for ROIs.
  * 2. Reads dataset image paths and YOLO label paths.
- * 3. Reads images in grayscale.
- * 4. Iterates through each image in the dataset:
+ * 3. Starts a decoder thread, which reads the images in grayscale ahead of their processing, a few at a time.
+ * 4. Iterates through each image in the dataset, as soon as it is decoded:
  *    a. Performs template matching.
- *    b. Reads YOLO bounding boxes.
+ *    b. Reads YOLO bounding boxes, and records which (template, angle) pairs produced matches inside them.
  *    c. Classifies points inside and outside YOLO boxes.
  *    d. Filters points outside YOLO boxes by minimum distance.
  *    e. Associates each YOLO box with ROIs extracted from points inside it.
  *    f. Selects ROIs with the highest Intersection over Union (IoU) for true positives.
  *    g. Extracts ROIs for false positives.
  *    h. Extracts HOG features for true positives and false positives.
- *    i. Stores the HOG features in vectors, reserving space to minimize reallocations.
- * 5. Saves the HOG features to CSV files for SVM training.
+ *    i. Appends the HOG features to the feature store, labeled 1 for the true positives and -1 for the false
+ *       positives.
+ * 5. Closes the feature store, read by the SVM training (the `exportFeaturesToCsv` step converts it to the
+ *    CSV files of ucasML).
+ * 6. Saves the matching statistics (hits and time per template and angle) as the pruning profile. They are only
+ *    recorded when the matching is not pruned (`pruning_recall` of 0): the pairs skipped by a pruned run would
+ *    get no hits, and the profile would be biased towards the pairs it already keeps.
+ *
+ * The images are streamed: the decoder thread hands them over through a `BoundedQueue` of `prefetch_depth`
+ * images, so decoding the next images overlaps with the matching of the current one, and the features are
+ * written to the store image by image. The memory used is therefore that of a few images, whatever the size
+ * of the dataset (plus 4 bytes per ROI for the labels of the store).
+ *
+ * @param[in] feature_type The type the features are stored as.
+ *
+ * @throws Any exception of the decoder thread or of the processing, once the decoder thread has stopped.
  *
  * @note The function assumes that the dataset images and YOLO label files are in the specified directory.
  * @note The function initializes a random number generator for choosing random ROI sizes to extract false positives.
@@ -59,19 +83,25 @@ std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRo
  * @see listDirectories
  * @see calculateAvgDims
  * @see globFiles
- * @see readImages
- * @see templateMatching
+ * @see BoundedQueue
+ * @see findTemplateMatches
+ * @see startMatchingProfile
+ * @see MatchingProfiler::recordMatches
+ * @see saveMatchingProfile
  * @see readYoloBoxes
  * @see classifyPointsByYoloBoxes
  * @see filterPointsByMinDistance
  * @see associateYoloBoxesWithRois
  * @see selectROIsWithHighestIoU
- * @see hog_features_extraction
- * @see writeHogFeaturesToCsv
+ * @see computeHogDescriptors
+ * @see FeatureStoreWriter
+ * @see hogFeatureStorePath
  */
-void generateSvmTrainingData()
+void generateSvmTrainingData(FeatureType feature_type)
 {
-   
+    // Number of decoded images waiting to be processed
+    constexpr size_t prefetch_depth = 2;
+
     std::vector<std::string> kmeans_by_size_clusters;
     listDirectories(std::filesystem::path(SRC_DIR_PATH) / "kmeans_by_size", kmeans_by_size_clusters);
 
@@ -96,26 +126,78 @@ void generateSvmTrainingData()
     globFiles(TRAINING_DATASET_PATH, "/*.txt", yolo_labels_paths);
 
 
-    // Read images in grayscale
-    std::vector<cv::Mat> src_imgs_gray;
-    readImages(dataset_img_paths, src_imgs_gray, cv::IMREAD_GRAYSCALE);
+    if (yolo_labels_paths.size() < dataset_img_paths.size())
+        throw std::runtime_error("Some images of the training dataset have no YOLO label file.");
 
 
-    // These vectors will contain the HOG features for the true positives and false positives of all training images
-    std::vector<std::vector<float>> true_positive_hog_features;
-    std::vector<std::vector<float>> false_positive_hog_features;
+    // The HOG features of every image are written to the store as soon as they are computed, one row per ROI.
+    // The per-image matrices are reused from one image to the next
+    createDirectory(std::filesystem::path(SRC_DIR_PATH), "svm_training_input");
+    FeatureStoreWriter feature_store(hogFeatureStorePath().string(), hog_descriptor_size, feature_type);
+    cv::Mat new_tp_hog_features;
+    cv::Mat new_fp_hog_features;
 
-    const auto dataset_training_cardinality = dataset_img_paths.size();
-    const auto buffer_size = 100;
-   
-    
-    for (size_t i=0;i< dataset_training_cardinality;i++)
+    // Record which (template, angle) pairs produce true positives, and at which cost, over the full search only
+    const bool record_profile = templateMatchingOptions().pruning_recall <= 0;
+    if (record_profile)
+        startMatchingProfile();
+
+    // Decoder stage: reads the images in grayscale ahead of the processing, holding back when it is too far ahead
+    struct DecodedImage
+    {
+        size_t index;
+        cv::Mat gray;
+    };
+    BoundedQueue<DecodedImage> decoded_images(prefetch_depth);
+    std::exception_ptr decoder_error;
+    std::thread decoder([&dataset_img_paths, &decoded_images, &decoder_error]()
+    {
+        try
+        {
+            for (size_t i = 0; i < dataset_img_paths.size(); i++)
+            {
+                cv::Mat img = cv::imread(dataset_img_paths[i], cv::IMREAD_GRAYSCALE);
+                if (img.empty())
+                    std::cerr << "Could not read image " << dataset_img_paths[i] << ", skipped\n";
+                else if (!decoded_images.push({ i, std::move(img) }))
+                    break;
+            }
+        }
+        catch (...)
+        {
+            decoder_error = std::current_exception();
+        }
+        decoded_images.close();
+    });
+
+    // Stops the decoder on every exit path, including an exception of the processing
+    struct DecoderGuard
+    {
+        BoundedQueue<DecodedImage>& queue;
+        std::thread& thread;
+        ~DecoderGuard()
+        {
+            queue.close();
+            if (thread.joinable())
+                thread.join();
+        }
+    } decoder_guard{ decoded_images, decoder };
+
+    while (std::optional<DecodedImage> decoded_image = decoded_images.pop())
 	{
+        const size_t i = decoded_image->index;
+        const cv::Mat& src_img_gray = decoded_image->gray;
+
         // Perform template matching 
-        std::vector<cv::Point> matched_points = templateMatching(src_imgs_gray[i]);
+        const std::vector<TemplateMatch> matches = findTemplateMatches(src_img_gray, templateMatchingOptions());
+        std::vector<cv::Point> matched_points;
+        matched_points.reserve(matches.size());
+        for (const auto& match : matches)
+            matched_points.push_back(match.center);
 
         // Read YOLO bounding boxes for the current image
-        std::vector<cv::Rect> yolo_boxes = readYoloBoxes(yolo_labels_paths[i], src_imgs_gray[i]);
+        std::vector<cv::Rect> yolo_boxes = readYoloBoxes(yolo_labels_paths[i], src_img_gray);
+        matchingProfiler().recordMatches(matches, yolo_boxes);
 
         // Classify points by their position inside or outside YOLO boxes
         std::vector<cv::Point> max_corr_points_inside_yolo;
@@ -127,7 +209,7 @@ void generateSvmTrainingData()
 
     	// Associate each YOLO box with the ROIs extracted from the points inside it
         // The result is a vector of pairs, where each pair contains a YOLO box and the ROIs associated with it
-        std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> yoloBox_roi_pairs = associateYoloBoxesWithRois(yolo_boxes, max_corr_points_inside_yolo);
+        std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> yoloBox_roi_pairs = associateYoloBoxesWithRois(yolo_boxes, max_corr_points_inside_yolo, src_img_gray.size());
 
         
         std::vector<cv::Rect> tp_rois = selectROIsWithHighestIoU(yoloBox_roi_pairs);
@@ -143,7 +225,7 @@ void generateSvmTrainingData()
             const int x = point.x - roi_size.width / 2;
             const int y = point.y - roi_size.height / 2;
 
-            if (cv::Rect roi(x, y, roi_size.width, roi_size.height); isRoiInImage(roi))
+            if (cv::Rect roi(x, y, roi_size.width, roi_size.height); isRoiInImage(roi, src_img_gray.size()))
             {
                 bool overlapping = false;
 
@@ -175,48 +257,196 @@ void generateSvmTrainingData()
             }
         }
 
-        std::vector<std::vector<float>> new_tp_hog_features = hog_features_extraction(tp_rois, src_imgs_gray[i]);
-        std::vector<std::vector<float>> new_fp_hog_features = hog_features_extraction(fp_rois, src_imgs_gray[i]);
-
-        // N.B buffer_size is an arbitrary buffer chosen to reduce the number of reallocations
-    	// needed when inserting new elements into the vectors. The idea is to reserve 
-    	// slightly more space than necessary to minimize the number of times the vector 
-    	// needs to reallocate memory, which is a costly operation.
-        if (true_positive_hog_features.capacity() < true_positive_hog_features.size() + new_tp_hog_features.size())
-        {
-            true_positive_hog_features.reserve(true_positive_hog_features.size() + new_tp_hog_features.size() + buffer_size);
-        }
-        if (false_positive_hog_features.capacity() < false_positive_hog_features.size() + new_fp_hog_features.size())
-        {
-            false_positive_hog_features.reserve(false_positive_hog_features.size() + new_fp_hog_features.size() + buffer_size);
-        }
+        computeHogDescriptors(tp_rois, src_img_gray, new_tp_hog_features);
+        computeHogDescriptors(fp_rois, src_img_gray, new_fp_hog_features);
 
-        true_positive_hog_features.insert(true_positive_hog_features.end(), new_tp_hog_features.begin(), new_tp_hog_features.end());
-        false_positive_hog_features.insert(false_positive_hog_features.end(), new_fp_hog_features.begin(), new_fp_hog_features.end());
+        feature_store.append(new_tp_hog_features, 1);
+        feature_store.append(new_fp_hog_features, -1);
 	}
 
+    decoder.join();
+    if (decoder_error)
+        std::rethrow_exception(decoder_error);
 
-    //-------------------- SAVING THE HOG FEATURES TO CSV FILES REQUIRED FOR SVM TRAINING ----------------------
+    feature_store.close();
+    std::cout << "Saved the HOG features of " << feature_store.rows() << " ROIs to " << hogFeatureStorePath().string() << "\n";
 
+    if (record_profile)
+        saveMatchingProfile();
+    else
+        std::cout << "The matching was pruned (--pruning-recall), so the pruning profile was not recorded again.\n";
+}
 
-    // Create output directory for SVM training input
-    const std::filesystem::path output_dir = createDirectory(std::filesystem::path(SRC_DIR_PATH), "svm_training_input");
 
-    // Define paths for output CSV files
-    const std::filesystem::path tp_file_path = output_dir / "tp_training.csv";
-    const std::filesystem::path fp_file_path = output_dir / "fp_training.csv";
+/**
+ * @brief Computes the cross-validated SVM scores of the training samples.
+ *
+ * The samples are split into stratified folds (each fold holds the same share of positives and negatives), and
+ * every fold is scored by an SVM trained on the other folds. The folds are trained in parallel on the shared
+ * thread pool, on index views of the samples: no fold copies the training matrix, and each task is admitted with
+ * the memory estimate of its solver.
+ *
+ * @param[in] samples The `CV_32F` training samples, one per row.
+ * @param[in] labels The label of every sample: +1 (positive) or -1 (negative).
+ * @param[in] options The training options, including the number of folds.
+ * @return The score of every sample, given by the SVM that did not see it.
+ *
+ * @throws std::invalid_argument If there are fewer samples of a class than folds.
+ *
+ * @see trainLinearSvm
+ * @see dotProduct
+ */
+std::vector<float> crossValidateSvm(const cv::Mat& samples, const std::vector<int>& labels, const LinearSvmTrainingOptions& options)
+{
+    const int num_folds = options.num_folds;
 
-    // Write HOG features to CSV files
-    try
+    // Stratified fold assignment, with a fixed seed to keep the scores reproducible
+    std::vector<int> folds(labels.size());
+    std::mt19937 generator(0);
+    for (const int label : { 1, -1 })
     {
-        writeHogFeaturesToCsv(true_positive_hog_features, tp_file_path.string());
-        writeHogFeaturesToCsv(false_positive_hog_features, fp_file_path.string());
+        std::vector<size_t> class_indices;
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            if (labels[i] == label)
+                class_indices.push_back(i);
+        }
+        if (class_indices.size() < static_cast<size_t>(num_folds))
+            throw std::invalid_argument("There are fewer samples of a class than cross-validation folds.");
+
+        std::shuffle(class_indices.begin(), class_indices.end(), generator);
+        for (size_t i = 0; i < class_indices.size(); i++)
+            folds[class_indices[i]] = static_cast<int>(i % num_folds);
     }
-    catch (const std::exception& e)
+
+    std::vector<std::future<void>> futures;
+    std::vector<float> scores(labels.size());
+    for (int fold = 0; fold < num_folds; fold++)
     {
-        std::cerr << "Error writing to CSV file: " << e.what() << "\n";
+        std::vector<int> training_indices;
+        for (size_t i = 0; i < labels.size(); i++)
+        {
+            if (folds[i] != fold)
+                training_indices.push_back(static_cast<int>(i));
+        }
+
+        const size_t task_memory = linearSvmTrainingMemory(training_indices.size(), samples.cols);
+        futures.emplace_back(sharedThreadPool().submit([&samples, &labels, &folds, &scores, &options, fold, training_indices = std::move(training_indices)]() {
+            const LinearSvm svm = trainLinearSvm(samples, labels, training_indices, options);
+            for (size_t i = 0; i < labels.size(); i++)
+            {
+                if (folds[i] == fold)
+                    scores[i] = dotProduct(svm.weights.data(), samples.ptr<float>(static_cast<int>(i)), svm.weights.size()) + svm.bias;
+            }
+            }, task_memory));
     }
-    
+    sharedThreadPool().waitAll(futures);
+    return scores;
+}
+
+
+/**
+ * @brief Writes SVM scores to a `.sco` file, as read by the performance evaluation script.
+ *
+ * The file starts with a comment line (starting with '#'), followed by one "<sample index> <score>" line per sample.
+ *
+ * @param[in] scores The scores of the samples.
+ * @param[in] path The path of the `.sco` file.
+ *
+ * @see openFile
+ */
+void writeScoresToSco(const std::vector<float>& scores, const std::filesystem::path& path)
+{
+    auto file = openFile(path.string());
+    file << "# sample score\n";
+    file << std::fixed << std::setprecision(6);
+    for (size_t i = 0; i < scores.size(); i++)
+        file << i << " " << scores[i] << "\n";
+}
+
+
+/**
+ * @brief Trains the linear SVM on the HOG features of the true and false positives, and cross-validates it.
+ *
+ * This function replaces the external SVM training tool. It performs the following steps:
+ * 1. Maps the feature store written by `generateSvmTrainingData` (true positives are the positive class).
+ * 2. Trains the final SVM on all the samples, while the cross-validation folds are trained alongside it on the
+ *    shared thread pool.
+ * 3. Saves the SVM as the model used by the detect step.
+ * 4. Writes the cross-validated scores of the positives and negatives to the `positive.sco` and `negative.sco`
+ *    files read by the performance evaluation step, and reports the cross-validated accuracy.
+ *
+ * @see FeatureStore::load
+ * @see trainLinearSvm
+ * @see crossValidateSvm
+ * @see saveLinearSvm
+ * @see writeScoresToSco
+ */
+void trainSvm()
+{
+    const FeatureStore feature_store = FeatureStore::load(hogFeatureStorePath().string());
+    const cv::Mat samples = feature_store.features();
+    const int* store_labels = feature_store.labels().ptr<int>();
+    const std::vector<int> labels(store_labels, store_labels + feature_store.rows());
+    const auto num_positives = std::count(labels.begin(), labels.end(), 1);
+
+    const LinearSvmTrainingOptions& options = svmTrainingOptions();
+    std::cout << "Training a linear SVM on " << num_positives << " positives and " << labels.size() - num_positives << " negatives ("
+        << samples.cols << " features), " << options.num_folds << "-fold cross-validation\n";
+
+    auto final_svm = sharedThreadPool().submit([&samples, &labels, &options]() {
+        return trainLinearSvm(samples, labels, options);
+        }, linearSvmTrainingMemory(labels.size(), samples.cols));
+    const std::vector<float> scores = crossValidateSvm(samples, labels, options);
+
+    std::vector<std::future<LinearSvm>> final_svm_futures;
+    final_svm_futures.push_back(std::move(final_svm));
+    const LinearSvm svm = std::move(sharedThreadPool().waitAll(final_svm_futures).front());
+
+    createDirectory(std::filesystem::path(SRC_DIR_PATH), "svm_model");
+    saveLinearSvm(svm, linearSvmPath());
+
+    const std::filesystem::path output_dir = createDirectory(std::filesystem::path(SRC_DIR_PATH), "svm_cv_outputs");
+    std::vector<float> positive_scores, negative_scores;
+    for (size_t i = 0; i < scores.size(); i++)
+        (labels[i] > 0 ? positive_scores : negative_scores).push_back(scores[i]);
+    writeScoresToSco(positive_scores, output_dir / "positive.sco");
+    writeScoresToSco(negative_scores, output_dir / "negative.sco");
+
+    size_t correct_samples = 0;
+    for (size_t i = 0; i < scores.size(); i++)
+        correct_samples += (scores[i] > 0) == (labels[i] > 0);
+    std::cout << "Cross-validated accuracy: " << 100.0 * correct_samples / scores.size() << "%\n";
+}
+
+/**
+ * @brief Exports the HOG features of the feature store to the CSV files read by ucasML.
+ *
+ * The true positives are written to `svm_training_input/tp_training.csv` and the false positives to
+ * `svm_training_input/fp_training.csv`, as the earlier versions of `generateSvmTrainingData` did.
+ *
+ * @see convertFeatureStoreToCsv
+ */
+void exportFeaturesToCsv()
+{
+    const std::filesystem::path input_dir = hogFeatureStorePath().parent_path();
+    convertFeatureStoreToCsv(hogFeatureStorePath().string(), (input_dir / "tp_training.csv").string(), (input_dir / "fp_training.csv").string());
+}
+
+/**
+ * @brief Imports the HOG features of the ucasML CSV files into the feature store.
+ *
+ * The CSV files `svm_training_input/tp_training.csv` (true positives) and `svm_training_input/fp_training.csv`
+ * (false positives), e.g. written by an earlier version, replace the feature store read by the SVM training.
+ *
+ * @param[in] feature_type The type the features are stored as.
+ *
+ * @see convertCsvToFeatureStore
+ */
+void importFeaturesFromCsv(FeatureType feature_type)
+{
+    const std::filesystem::path input_dir = hogFeatureStorePath().parent_path();
+    convertCsvToFeatureStore((input_dir / "tp_training.csv").string(), (input_dir / "fp_training.csv").string(), hogFeatureStorePath().string(), feature_type);
 }
 
 
@@ -293,6 +523,7 @@ std::unordered_map<int, std::vector<cv::Point>> groupPointsByYoloBox(const std::
  *
  * @param[in] yolo_boxes A vector of `cv::Rect` objects representing the YOLO bounding boxes.
  * @param[in] max_corr_tp A vector of `cv::Point` objects representing the points to be associated with ROIs.
+ * @param[in] image_size The size of the image the ROIs must lie in.
  * @return A vector of pairs, where each pair consists of a YOLO bounding box (cv::Rect) and a vector of associated ROIs (cv::Rect).
  *
  * @note The function groups points by their corresponding YOLO bounding box and generates ROIs for each group of points.
@@ -303,7 +534,7 @@ std::unordered_map<int, std::vector<cv::Point>> groupPointsByYoloBox(const std::
  * @see calculateAvgDims
  * @see generateRoisFromPoints
  */
-std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRois(const std::vector<cv::Rect>& yolo_boxes, const std::vector<cv::Point>& max_corr_tp)
+std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRois(const std::vector<cv::Rect>& yolo_boxes, const std::vector<cv::Point>& max_corr_tp, const cv::Size& image_size)
 {
     std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> yoloBox_roi_pairs;
     auto points_in_boxes = groupPointsByYoloBox(yolo_boxes, max_corr_tp);
@@ -323,7 +554,7 @@ std::vector<std::pair<cv::Rect, std::vector<cv::Rect>>> associateYoloBoxesWithRo
             roi_sizes.push_back(calculateAvgDims(std::filesystem::path(kmeans_by_size_clusters[i])));
 
 
-        std::vector<cv::Rect> rois = generateRoisFromPoints(points, roi_sizes);
+        std::vector<cv::Rect> rois = generateRoisFromPoints(points, roi_sizes, image_size);
 
         yoloBox_roi_pairs.emplace_back(yolo_box, rois);
     }
@@ -1,3 +1,12 @@
 #pragma once
 
-void generateSvmTrainingData();
\ No newline at end of file
+#include "feature_store.h"
+
+
+void generateSvmTrainingData(FeatureType feature_type);
+
+void exportFeaturesToCsv();
+
+void importFeaturesFromCsv(FeatureType feature_type);
+
+void trainSvm();
\ No newline at end of file
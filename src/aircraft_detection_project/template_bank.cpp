@@ -0,0 +1,378 @@
+#include "template_bank.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+
+
+namespace
+{
+    constexpr char bank_magic[8] = { 'T', 'P', 'L', 'B', 'A', 'N', 'K', '\0' };
+    constexpr uint32_t bank_version = 3;
+
+    // Matrix data is aligned to cache lines in the file, and therefore in the mapping
+    constexpr size_t data_alignment = 64;
+
+    struct BankHeader
+    {
+        char magic[8];
+        uint32_t version;
+        int32_t angle_step;
+        uint32_t num_templates;
+        uint32_t num_rotated_templates;
+    };
+
+    struct RotatedTemplateHeader
+    {
+        int32_t template_index;
+        int32_t degree_angle;
+        double mean;
+        double norm;
+    };
+
+    struct BasisHeader
+    {
+        int32_t frame_width;
+        int32_t frame_height;
+        uint32_t num_components;
+        uint32_t num_template_rects;
+    };
+
+    struct MatHeader
+    {
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        int32_t reserved;
+    };
+
+    template<typename T>
+    void writePod(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeMat(std::ofstream& file, const cv::Mat& mat)
+    {
+        const cv::Mat continuous_mat = mat.isContinuous() ? mat : mat.clone();
+        writePod(file, MatHeader{ continuous_mat.rows, continuous_mat.cols, continuous_mat.type(), 0 });
+
+        const size_t position = static_cast<size_t>(file.tellp());
+        const size_t padding = (data_alignment - position % data_alignment) % data_alignment;
+        const char zeros[data_alignment] = {};
+        file.write(zeros, padding);
+
+        file.write(reinterpret_cast<const char*>(continuous_mat.data), continuous_mat.total() * continuous_mat.elemSize());
+    }
+
+    // Sequential reader over the mapped file, checking every access against the file size
+    class BankReader
+    {
+    public:
+        explicit BankReader(MappedFile& file) : file(file) {}
+
+        template<typename T>
+        T readPod()
+        {
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        cv::Mat readMat()
+        {
+            const MatHeader header = readPod<MatHeader>();
+            if (header.rows < 0 || header.cols < 0)
+                throw std::runtime_error("Corrupted template bank: invalid matrix size.");
+
+            offset += (data_alignment - offset % data_alignment) % data_alignment;
+            const size_t data_size = static_cast<size_t>(header.rows) * header.cols * CV_ELEM_SIZE(header.type);
+            return cv::Mat(header.rows, header.cols, header.type, take(data_size));
+        }
+
+    private:
+        char* take(size_t bytes)
+        {
+            if (offset + bytes > file.size())
+                throw std::runtime_error("Corrupted template bank: unexpected end of file.");
+
+            char* data = file.mutableData() + offset;
+            offset += bytes;
+            return data;
+        }
+
+        MappedFile& file;
+        size_t offset = 0;
+    };
+}
+
+
+
+/**
+ * @brief Builds a template bank from the upright templates and their rotated variants.
+ *
+ * The prepared (zero-mean, masked) kernel of every rotated variant, with its mean and norm, and the
+ * decomposition of the upright templates on shared components are computed here once, so the matching tasks
+ * only read the bank.
+ *
+ * @param[in] templates The upright templates.
+ * @param[in] rotated_templates The rotated variants of the templates, with their masks.
+ * @param[in] angle_step The angle step, in degrees, of the rotated variants.
+ *
+ * @see prepareTemplate
+ * @see decomposeTemplateSet
+ */
+TemplateBank::TemplateBank(const std::vector<cv::Mat>& templates, const std::vector<RotatedTemplate>& rotated_templates, int angle_step)
+    : angle_step(angle_step), upright_templates(templates), rotated_templates(rotated_templates)
+{
+    prepared_templates.reserve(rotated_templates.size());
+    for (const auto& rotated_template : rotated_templates)
+        prepared_templates.push_back(prepareTemplate(rotated_template.image, rotated_template.mask));
+
+    template_basis = decomposeTemplateSet(upright_templates);
+
+    groupMasks();
+}
+
+/**
+ * @brief Saves the template bank to a single binary file.
+ *
+ * The file holds a header (magic, version, angle step, counts), the upright templates and, for every
+ * rotated variant, its template index, angle, mean and norm followed by its image, mask and prepared kernel.
+ * The template basis follows: its frame size and counts, its components, the coordinates of the templates, the
+ * singular values and the positions of the templates in the frame.
+ * The data of every matrix is aligned to 64 bytes, so a mapped bank can use it in place.
+ *
+ * @param[in] path The path of the bank file.
+ *
+ * @throws std::runtime_error If the file cannot be written.
+ *
+ * @see load
+ */
+void TemplateBank::save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Could not open file " + path);
+
+    BankHeader header{};
+    std::memcpy(header.magic, bank_magic, sizeof(bank_magic));
+    header.version = bank_version;
+    header.angle_step = angle_step;
+    header.num_templates = static_cast<uint32_t>(upright_templates.size());
+    header.num_rotated_templates = static_cast<uint32_t>(rotated_templates.size());
+    writePod(file, header);
+
+    for (const auto& upright_template : upright_templates)
+        writeMat(file, upright_template);
+
+    for (size_t i = 0; i < rotated_templates.size(); i++)
+    {
+        writePod(file, RotatedTemplateHeader{ rotated_templates[i].template_index, rotated_templates[i].degree_angle, prepared_templates[i].mean, prepared_templates[i].norm });
+        writeMat(file, rotated_templates[i].image);
+        writeMat(file, rotated_templates[i].mask);
+        writeMat(file, prepared_templates[i].kernel);
+    }
+
+    writePod(file, BasisHeader{ template_basis.frame_size.width, template_basis.frame_size.height,
+        static_cast<uint32_t>(template_basis.components.size()), static_cast<uint32_t>(template_basis.template_rects.size()) });
+    for (const auto& component : template_basis.components)
+        writeMat(file, component);
+    writeMat(file, template_basis.coefficients);
+    writeMat(file, template_basis.singular_values);
+    for (const auto& template_rect : template_basis.template_rects)
+        writePod(file, std::array<int32_t, 4>{ template_rect.x, template_rect.y, template_rect.width, template_rect.height });
+
+    if (!file)
+        throw std::runtime_error("Could not write the template bank to " + path);
+}
+
+/**
+ * @brief Loads a template bank saved by `save`.
+ *
+ * The file is memory-mapped and every matrix of the bank points into the mapping: loading does no decoding,
+ * no copy and no recomputation, and the pages are only read from disk when a matrix is first accessed.
+ *
+ * @param[in] path The path of the bank file.
+ * @return The loaded template bank.
+ *
+ * @throws std::runtime_error If the file cannot be mapped, or is not a template bank of the current version.
+ *
+ * @see MappedFile
+ */
+TemplateBank TemplateBank::load(const std::string& path)
+{
+    TemplateBank bank;
+    bank.mapped_file = std::make_shared<MappedFile>(path);
+    BankReader reader(*bank.mapped_file);
+
+    const BankHeader header = reader.readPod<BankHeader>();
+    if (std::memcmp(header.magic, bank_magic, sizeof(bank_magic)) != 0 || header.version != bank_version)
+        throw std::runtime_error("Not a template bank of version " + std::to_string(bank_version) + ": " + path);
+
+    bank.angle_step = header.angle_step;
+
+    for (uint32_t i = 0; i < header.num_templates; i++)
+        bank.upright_templates.push_back(reader.readMat());
+
+    for (uint32_t i = 0; i < header.num_rotated_templates; i++)
+    {
+        const auto rotated_header = reader.readPod<RotatedTemplateHeader>();
+
+        RotatedTemplate rotated_template;
+        rotated_template.template_index = rotated_header.template_index;
+        rotated_template.degree_angle = rotated_header.degree_angle;
+        rotated_template.image = reader.readMat();
+        rotated_template.mask = reader.readMat();
+        bank.rotated_templates.push_back(rotated_template);
+
+        PreparedTemplate prepared_template;
+        prepared_template.kernel = reader.readMat();
+        prepared_template.mean = rotated_header.mean;
+        prepared_template.norm = rotated_header.norm;
+        prepared_template.mask = windowMask(rotated_template.mask);
+        bank.prepared_templates.push_back(prepared_template);
+    }
+
+    const BasisHeader basis_header = reader.readPod<BasisHeader>();
+    bank.template_basis.frame_size = cv::Size(basis_header.frame_width, basis_header.frame_height);
+    for (uint32_t i = 0; i < basis_header.num_components; i++)
+        bank.template_basis.components.push_back(reader.readMat());
+    bank.template_basis.coefficients = reader.readMat();
+    bank.template_basis.singular_values = reader.readMat();
+    for (uint32_t i = 0; i < basis_header.num_template_rects; i++)
+    {
+        const auto rect = reader.readPod<std::array<int32_t, 4>>();
+        bank.template_basis.template_rects.emplace_back(rect[0], rect[1], rect[2], rect[3]);
+    }
+    if (bank.template_basis.template_rects.size() != header.num_templates
+        || (!bank.template_basis.components.empty() && bank.template_basis.coefficients.rows != static_cast<int>(header.num_templates)))
+        throw std::runtime_error("Corrupted template bank: the template basis does not match the templates.");
+
+    bank.groupMasks();
+    return bank;
+}
+
+/**
+ * @brief Sets the DFT size and the memory bound of the spectrum cache of the bank.
+ *
+ * The spectra of the kernels and of the masks depend on the DFT size of the scene only, so they are cached
+ * across the scenes of the same size, e.g. the training images or the tiles of a large image. A full cache takes
+ * one DFT-sized matrix per rotated template, far more than the memory budget for real scenes, so the cache is
+ * bounded: the spectra computed once it is full are simply not kept. Changing the DFT size empties the cache.
+ *
+ * @param[in] dft_size The DFT size of the scenes to come, e.g. `FftCorrelator::dftSize`.
+ * @param[in] max_bytes The maximum memory of the cached spectra, in bytes. 0 disables the cache.
+ *
+ * @see kernelSpectrum
+ * @see maskSpectrum
+ */
+void TemplateBank::useSpectrumCache(cv::Size dft_size, size_t max_bytes) const
+{
+    std::lock_guard<std::mutex> lock(spectrum_cache->mutex);
+    spectrum_cache->max_bytes = max_bytes;
+    if (spectrum_cache->dft_size == dft_size)
+        return;
+
+    spectrum_cache->dft_size = dft_size;
+    spectrum_cache->cached_bytes = 0;
+    spectrum_cache->kernel_spectra.assign(prepared_templates.size(), cv::Mat());
+    spectrum_cache->mask_spectra.assign(mask_groups.size(), cv::Mat());
+}
+
+/**
+ * @brief Returns the spectrum of the prepared kernel of a rotated template, zero-padded to a DFT size.
+ *
+ * @param[in] index The index of the rotated template in the bank.
+ * @param[in] dft_size The DFT size of the scene.
+ * @return The `CV_32F` spectrum, from the cache when it holds it.
+ *
+ * @see paddedSpectrum
+ * @see useSpectrumCache
+ */
+cv::Mat TemplateBank::kernelSpectrum(size_t index, cv::Size dft_size) const
+{
+    return cachedSpectrum(spectrum_cache->kernel_spectra, index, prepared_templates[index].kernel, dft_size);
+}
+
+/**
+ * @brief Returns the spectrum of the mask shared by the templates of a mask group, zero-padded to a DFT size.
+ *
+ * @param[in] group The index of the mask group (see `maskGroups`).
+ * @param[in] dft_size The DFT size of the scene.
+ * @return The `CV_32F` spectrum, from the cache when it holds it, or an empty matrix when the templates of the
+ *         group are unmasked.
+ *
+ * @see FftCorrelator::windowNorms
+ */
+cv::Mat TemplateBank::maskSpectrum(size_t group, cv::Size dft_size) const
+{
+    const cv::Mat& mask = prepared_templates[mask_groups[group].front()].mask;
+    if (mask.empty())
+        return cv::Mat();
+
+    return cachedSpectrum(spectrum_cache->mask_spectra, group, mask, dft_size);
+}
+
+/**
+ * @brief Groups the rotated templates that share their mask.
+ *
+ * The mask of a rotated template only depends on the size of the upright template and on the angle, so the
+ * templates of a size cluster at the same angle (the intensity clusters) share it. Groups are listed in the
+ * order of their first template in the bank.
+ */
+void TemplateBank::groupMasks()
+{
+    std::map<std::tuple<int, int, int>, size_t> group_indices;
+    mask_groups.clear();
+    template_mask_groups.clear();
+    template_mask_groups.reserve(rotated_templates.size());
+
+    for (size_t i = 0; i < rotated_templates.size(); i++)
+    {
+        const cv::Size size = upright_templates[rotated_templates[i].template_index].size();
+        const auto key = std::make_tuple(size.width, size.height, rotated_templates[i].degree_angle);
+        const auto [group, inserted] = group_indices.emplace(key, mask_groups.size());
+        if (inserted)
+            mask_groups.emplace_back();
+
+        mask_groups[group->second].push_back(i);
+        template_mask_groups.push_back(group->second);
+    }
+}
+
+/**
+ * @brief Looks a spectrum up in the cache, computing and caching it when missing.
+ *
+ * The spectrum is computed outside of the lock, so concurrent tasks do not wait for each other's DFTs; a
+ * spectrum computed twice by concurrent tasks is cached once.
+ *
+ * @param[in,out] spectra The cached spectra of the kind requested.
+ * @param[in] index The index of the spectrum in `spectra`.
+ * @param[in] kernel The matrix to transform.
+ * @param[in] dft_size The DFT size of the scene; a size other than the cached one bypasses the cache.
+ * @return The `CV_32F` spectrum.
+ */
+cv::Mat TemplateBank::cachedSpectrum(std::vector<cv::Mat>& spectra, size_t index, const cv::Mat& kernel, cv::Size dft_size) const
+{
+    {
+        std::lock_guard<std::mutex> lock(spectrum_cache->mutex);
+        if (spectrum_cache->dft_size == dft_size && !spectra[index].empty())
+            return spectra[index];
+    }
+
+    const cv::Mat spectrum = paddedSpectrum(kernel, dft_size);
+    const size_t spectrum_bytes = spectrum.total() * spectrum.elemSize();
+
+    std::lock_guard<std::mutex> lock(spectrum_cache->mutex);
+    if (spectrum_cache->dft_size == dft_size && spectra[index].empty() && spectrum_cache->cached_bytes + spectrum_bytes <= spectrum_cache->max_bytes)
+    {
+        spectra[index] = spectrum;
+        spectrum_cache->cached_bytes += spectrum_bytes;
+    }
+    return spectrum;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "eigenplanes.h"
+#include "fft_correlation.h"
+#include "mapped_file.h"
+#include "template_matching.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+class TemplateBank
+{
+public:
+    TemplateBank() = default;
+
+    TemplateBank(const std::vector<cv::Mat>& templates, const std::vector<RotatedTemplate>& rotated_templates, int angle_step);
+
+    static TemplateBank load(const std::string& path);
+
+    void save(const std::string& path) const;
+
+    const std::vector<cv::Mat>& templates() const { return upright_templates; }
+
+    const std::vector<RotatedTemplate>& rotatedTemplates() const { return rotated_templates; }
+
+    const std::vector<PreparedTemplate>& preparedTemplates() const { return prepared_templates; }
+
+    const TemplateBasis& basis() const { return template_basis; }
+
+    const std::vector<std::vector<size_t>>& maskGroups() const { return mask_groups; }
+
+    size_t maskGroup(size_t index) const { return template_mask_groups[index]; }
+
+    int angleStep() const { return angle_step; }
+
+    bool empty() const { return upright_templates.empty(); }
+
+    void useSpectrumCache(cv::Size dft_size, size_t max_bytes) const;
+
+    cv::Mat kernelSpectrum(size_t index, cv::Size dft_size) const;
+
+    cv::Mat maskSpectrum(size_t group, cv::Size dft_size) const;
+
+private:
+    struct SpectrumCache
+    {
+        std::mutex mutex;
+        cv::Size dft_size;
+        size_t max_bytes = 0;
+        size_t cached_bytes = 0;
+        std::vector<cv::Mat> kernel_spectra; // per rotated template
+        std::vector<cv::Mat> mask_spectra;   // per mask group
+    };
+
+    void groupMasks();
+
+    cv::Mat cachedSpectrum(std::vector<cv::Mat>& spectra, size_t index, const cv::Mat& kernel, cv::Size dft_size) const;
+
+    int angle_step = 0;
+    std::vector<cv::Mat> upright_templates;
+    std::vector<RotatedTemplate> rotated_templates;
+    std::vector<PreparedTemplate> prepared_templates;
+    TemplateBasis template_basis; // all the components of the upright templates, see `decomposeTemplateSet`
+
+    // Rotated templates of the same size at the same angle share their mask, and so their window norms
+    std::vector<std::vector<size_t>> mask_groups;
+    std::vector<size_t> template_mask_groups;
+
+    // Shared by the copies of the bank, which hold the same templates
+    std::shared_ptr<SpectrumCache> spectrum_cache = std::make_shared<SpectrumCache>();
+
+    // Keeps the mapped file alive while the matrices of a loaded bank point into it
+    std::shared_ptr<MappedFile> mapped_file;
+};
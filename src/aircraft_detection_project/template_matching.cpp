@@ -1,7 +1,76 @@
 #include "template_matching.h"
 
+#include "bank_compaction.h"
+#include "eigenplanes.h"
+#include "fft_correlation.h"
+#include "matching_profile.h"
+#include "orientation_estimation.h"
+#include "peak_extraction.h"
+#include "proposals.h"
+#include "rotation_cache.h"
+#include "separable_correlation.h"
+#include "template_bank.h"
+#include "thread_pool.h"
 #include "utils.h"
-#include <future>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <tuple>
+
+
+namespace
+{
+    // The process-wide template bank and pruning profile, dropped when their files are rewritten
+    std::mutex bank_mutex;
+    std::shared_ptr<const TemplateBank> shared_bank;
+
+    std::mutex profile_mutex;
+    std::shared_ptr<const PruningProfile> shared_profile;
+    double shared_profile_recall = 0.0;
+
+    // The banks of the pyramid levels, built from the shared bank (level 0) by `sharedPyramidBanks`
+    using PyramidBanks = std::vector<std::shared_ptr<const TemplateBank>>;
+    std::mutex pyramid_mutex;
+    std::shared_ptr<const PyramidBanks> shared_pyramid;
+
+    // The basis of the shared bank truncated for the eigen-basis mode, by `sharedEigenBasis`
+    std::mutex basis_mutex;
+    std::shared_ptr<const TemplateBank> basis_bank;
+    double basis_energy = 0.0;
+    std::shared_ptr<const TemplateBasis> shared_basis;
+
+    // Writes the bank next to the bank file and renames it over the file, once the shared bank, which may still map
+    // the former file, is dropped: the file is never truncated under a mapping, and the next call to
+    // `sharedTemplateBank` loads the new one. The callers must not hold the shared bank themselves
+    void replaceTemplateBankFile(const TemplateBank& bank, const std::filesystem::path& bank_path)
+    {
+        std::filesystem::path temporary_path = bank_path;
+        temporary_path += ".tmp";
+        bank.save(temporary_path.string());
+
+        {
+            std::lock_guard<std::mutex> pyramid_lock(pyramid_mutex);
+            shared_pyramid.reset();
+        }
+        {
+            std::lock_guard<std::mutex> basis_lock(basis_mutex);
+            basis_bank.reset();
+            shared_basis.reset();
+        }
+
+        std::lock_guard<std::mutex> lock(bank_mutex);
+        shared_bank.reset();
+        std::filesystem::rename(temporary_path, bank_path);
+    }
+}
+
 
 
 /**
@@ -56,33 +125,52 @@ std::vector<int> angle_range(int start, int end, int step)
 }
 
 /**
- * @brief Rotates an image by a specified angle.
+ * @brief Rotates a template and builds the mask of its valid pixels.
  *
- * This function rotates the given image by a specified angle around its center.
- * It adjusts the bounding box to ensure the entire rotated image fits within the resulting image.
+ * Rotating the scene by `degree_angle` and correlating an upright template is equivalent to
+ * correlating the template rotated by `-degree_angle` against the unrotated scene. The rotated
+ * template is enlarged to its bounding box, so a mask is built alongside it: only the pixels
+ * that come from the original template are set, so the black corners introduced by the rotation
+ * are ignored by the correlation.
  *
- * @param[in] src_img The source image to be rotated.
- * @param[in] degree_angle The angle in degrees by which the image should be rotated.
- * @return A `cv::Mat` object containing the rotated image.
+ * @param[in] avg_plane The upright template.
+ * @param[in] template_index The index of the template in the template set.
+ * @param[in] degree_angle The scene rotation angle, in degrees, the template has to emulate.
+ * @return A `RotatedTemplate` holding the rotated template, its `CV_8U` mask, its index and the angle.
  *
- * @note The function uses the center of the image as the rotation point and adjusts the translation
- *       to ensure the entire rotated image fits within the new bounding box.
+ * @note The mask is rotated with nearest-neighbour interpolation so that it stays binary.
  *
- * @see cv::getRotationMatrix2D
- * @see cv::warpAffine
- * @see cv::RotatedRect
+ * @see rotateImage
  */
-cv::Mat rotateImage(const cv::Mat& src_img, int degree_angle)
+RotatedTemplate rotateTemplate(const cv::Mat& avg_plane, int template_index, int degree_angle)
 {
-    cv::Point rot_center = cv::Point(src_img.cols / 2.0f, src_img.rows / 2.0f);
-    cv::Mat rotation_mat = cv::getRotationMatrix2D(rot_center, degree_angle, 1);
-    cv::Rect2f bbox = cv::RotatedRect(cv::Point2f(), src_img.size(), degree_angle).boundingRect2f();
-    rotation_mat.at<double>(0, 2) += bbox.width / 2.0f - rot_center.x;
-    rotation_mat.at<double>(1, 2) += bbox.height / 2.0f - rot_center.y;
+    RotatedTemplate rotated_template;
+    rotated_template.template_index = template_index;
+    rotated_template.degree_angle = degree_angle;
+    rotated_template.image = rotateImage(avg_plane, -degree_angle);
+    rotated_template.mask = rotateImage(cv::Mat(avg_plane.size(), CV_8U, cv::Scalar(255)), -degree_angle, cv::INTER_NEAREST);
+    return rotated_template;
+}
 
-    cv::Mat dst;
-    cv::warpAffine(src_img, dst, rotation_mat, bbox.size());
-    return dst;
+/**
+ * @brief Builds a template bank holding every template rotated by every angle of the sweep.
+ *
+ * @param[in] avg_planes The upright templates.
+ * @param[in] angle_step The angle step, in degrees, of the sweep.
+ * @return A `TemplateBank` holding the templates, their rotated variants and masks, and their prepared kernels.
+ *
+ * @see rotateTemplate
+ * @see TemplateBank
+ */
+TemplateBank buildTemplateBank(const std::vector<cv::Mat>& avg_planes, int angle_step)
+{
+    std::vector<RotatedTemplate> rotated_templates;
+    for (size_t i = 0; i < avg_planes.size(); i++)
+    {
+        for (auto degree_angle : angle_range(0, 360, angle_step))
+            rotated_templates.push_back(rotateTemplate(avg_planes[i], static_cast<int>(i), degree_angle));
+    }
+    return TemplateBank(avg_planes, rotated_templates, angle_step);
 }
 
 
@@ -115,46 +203,250 @@ cv::Point transformPoint(const cv::Point& match_center, const cv::Mat& rotation_
 
 
 /**
- * @brief Performs template matching on a source image with a rotated template.
+ * @brief Extracts the matches of a template from its normalized cross-correlation map.
+ *
+ * This function extracts up to `options.peaks_per_map` peaks above `options.peak_threshold` from the map,
+ * suppressing peaks closer than `options.peak_radius` pixels (half the smaller template side when it is 0),
+ * and converts them to matches centered on the template window.
+ *
+ * @param[in] NCC_Output The normalized cross-correlation map of the template.
+ * @param[in] template_size The size of the correlated template.
+ * @param[in] template_index The index of the template in the template set, reported in the matches.
+ * @param[in] degree_angle The rotation angle, reported in the matches.
+ * @param[in] options The matching options (peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects, sorted by descending score, whose centers are in map coordinates
+ *         shifted by half the template size.
+ *
+ * @see extractPeaks
+ */
+std::vector<TemplateMatch> extractMatches(const cv::Mat& NCC_Output, cv::Size template_size, int template_index, int degree_angle, const TemplateMatchingOptions& options)
+{
+    const int radius = options.peak_radius > 0 ? options.peak_radius : std::min(template_size.width, template_size.height) / 2;
+
+    std::vector<TemplateMatch> matches;
+    for (const auto& peak : extractPeaks(NCC_Output, options.peaks_per_map, options.peak_threshold, radius))
+    {
+        const cv::Point matchCenter(peak.location.x + template_size.width / 2, peak.location.y + template_size.height / 2);
+        matches.push_back({ matchCenter, peak.score, template_index, degree_angle });
+    }
+    return matches;
+}
+
+/**
+ * @brief Performs template matching on a rotated source image.
  *
- * This function rotates the source image by a specified angle, performs template matching using the normalized cross-correlation method,
+ * This function performs template matching on the source image rotated by a specified angle, using the normalized cross-correlation method,
  * and returns the coordinates of the matched points transformed back to the original image coordinates.
  *
- * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] rotated_scene The source image rotated by `degree_angle`, with its affine transformation from the source image.
  * @param[in] avg_plane The template image used for matching.
- * @param[in] degree_angle The angle in degrees by which to rotate the source image for matching.
- * @return A vector of `cv::Point` objects representing the coordinates of the matched points in the original image.
+ * @param[in] separable_template The separable decomposition of the template, used with `CorrelationBackend::Separable`.
+ * @param[in] template_index The index of the template in the template set, reported in the matches.
+ * @param[in] degree_angle The angle in degrees by which the source image was rotated, reported in the matches.
+ * @param[in] options The matching options (correlation backend and peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects holding the coordinates of the matched points in the original image and their scores.
  *
- * @note The function uses `cv::getRotationMatrix2D` to compute the rotation matrix and `rotateImage` to rotate the source image.
- * @note The function uses `cv::matchTemplate` with the `cv::TM_CCOEFF_NORMED` method to perform template matching.
+ * @note The function uses `cv::matchTemplate` with the `cv::TM_CCOEFF_NORMED` method to perform template matching or,
+ *       with `CorrelationBackend::Separable`, the low-rank separable approximation of the template. The integer
+ *       kernels are never faster on whole rotated scenes, so `CorrelationBackend::Integer` only applies to the
+ *       local searches (see `correlateLocally`).
  * @note The function uses `transformPoint` to transform the coordinates of the matched points back to the original image coordinates.
  *
- * @see cv::getRotationMatrix2D
- * @see rotateImage
+ * @see RotationCache
  * @see cv::matchTemplate
- * @see cv::minMaxLoc
+ * @see separableNormalizedCorrelation
+ * @see extractMatches
  * @see transformPoint
  */
-std::vector<cv::Point> performTemplateMatching(const cv::Mat& src_img, const cv::Mat& avg_plane, int degree_angle)
+std::vector<TemplateMatch> performTemplateMatching(const RotatedScene& rotated_scene, const cv::Mat& avg_plane, const SeparableTemplate& separable_template, int template_index, int degree_angle, const TemplateMatchingOptions& options)
 {
-    std::vector<cv::Point> local_matched_points;
+    const cv::Mat& rotated_img = rotated_scene.image;
 
-    cv::Mat rotation_mat = cv::getRotationMatrix2D(cv::Point(src_img.cols / 2.0f, src_img.rows / 2.0f), degree_angle, 1);
-    cv::Mat rotated_img = rotateImage(src_img, degree_angle);
+    cv::Mat NCC_Output;
+    if (options.correlation_backend == CorrelationBackend::Separable)
+        NCC_Output = separableNormalizedCorrelation(rotated_img, separable_template);
+    else
+        cv::matchTemplate(rotated_img, avg_plane, NCC_Output, cv::TM_CCOEFF_NORMED);
+
+    std::vector<TemplateMatch> local_matches = extractMatches(NCC_Output, avg_plane.size(), template_index, degree_angle, options);
+    for (auto& match : local_matches)
+        match.center = transformPoint(match.center, rotated_scene.rotation_mat);
+
+    return local_matches;
+}
 
+/**
+ * @brief Performs masked template matching of a pre-rotated template against the unrotated source image.
+ *
+ * This function correlates a rotated template (see `rotateTemplate`) with the source image using the
+ * normalized cross-correlation method, restricted to the template mask. Since the scene is not rotated,
+ * the peak is already expressed in source image coordinates and no inverse transformation is needed.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] rotated_template The pre-rotated template and its mask.
+ * @param[in] options The matching options (peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects holding the coordinates of the matched points in the source image and their scores.
+ *
+ * @note Flat image regions make the masked normalization degenerate, so non-finite values are zeroed before
+ *       looking for the peaks.
+ *
+ * @see rotateTemplate
+ * @see cv::matchTemplate
+ * @see cv::patchNaNs
+ * @see extractMatches
+ */
+std::vector<TemplateMatch> performRotatedTemplateMatching(const cv::Mat& src_img, const RotatedTemplate& rotated_template, const TemplateMatchingOptions& options)
+{
     cv::Mat NCC_Output;
-    cv::matchTemplate(rotated_img, avg_plane, NCC_Output, cv::TM_CCOEFF_NORMED);
+    cv::matchTemplate(src_img, rotated_template.image, NCC_Output, cv::TM_CCOEFF_NORMED, rotated_template.mask);
+    cv::patchNaNs(NCC_Output, 0);
+    NCC_Output.setTo(0, (NCC_Output > 1.01) | (NCC_Output < -1.01));
+
+    return extractMatches(NCC_Output, rotated_template.image.size(), rotated_template.template_index, rotated_template.degree_angle, options);
+}
+
+/**
+ * @brief Estimates the peak memory allocated by a single matching task.
+ *
+ * The estimate is used by the thread pool to admit tasks within its memory budget, so it only needs to be
+ * of the right order of magnitude: it accounts for the large per-task buffers (rotated scene, correlation
+ * maps, normalization temporaries), not for the template-sized ones.
+ *
+ * @param[in] src_size The size of the source image.
+ * @param[in] options The matching options of the task (mode and correlation backend).
+ * @return The estimated peak memory of the task, in bytes.
+ */
+size_t matchingTaskMemory(cv::Size src_size, const TemplateMatchingOptions& options)
+{
+    const size_t src_area = static_cast<size_t>(src_size.area());
+    switch (options.mode)
+    {
+    case MatchingMode::RotateScene:
+    {
+        // Rotated scene (8-bit) and its float correlation map, both as large as the rotated bounding box;
+        // the separable backend adds its filtered maps and the double precision integral images
+        const double diagonal = std::ceil(std::hypot(src_size.width, src_size.height));
+        const size_t bytes_per_pixel = options.correlation_backend == CorrelationBackend::Separable
+            ? sizeof(uchar) + 3 * sizeof(float) + 4 * sizeof(double)
+            : sizeof(uchar) + 2 * sizeof(float);
+        return static_cast<size_t>(diagonal * diagonal) * bytes_per_pixel;
+    }
+    case MatchingMode::Fft:
+    {
+        // Mask and kernel spectra, spectrum product and inverse transform, plus the window norms shared by the
+        // mask group, the correlation map and the double precision temporaries of the norms
+        const size_t dft_area = static_cast<size_t>(cv::getOptimalDFTSize(src_size.width)) * cv::getOptimalDFTSize(src_size.height);
+        return dft_area * 4 * sizeof(float) + src_area * (2 * sizeof(float) + 3 * sizeof(double));
+    }
+    default:
+        // Float correlation map and the scratch buffers of cv::matchTemplate
+        return src_area * 3 * sizeof(float);
+    }
+}
+
+/**
+ * @brief Runs the matching of a (template, angle) pair, timing it when the matching profiler is recording.
+ *
+ * @param[in] template_index The index of the template.
+ * @param[in] degree_angle The rotation angle, in degrees.
+ * @param[in] match_pair The callable matching the pair, returning its matches.
+ * @return The matches of the pair.
+ *
+ * @see MatchingProfiler::recordTime
+ */
+template<typename F>
+std::vector<TemplateMatch> profiledPairMatching(int template_index, int degree_angle, F&& match_pair)
+{
+    MatchingProfiler& profiler = matchingProfiler();
+    if (!profiler.isRecording())
+        return match_pair();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<TemplateMatch> matches = match_pair();
+    profiler.recordTime(template_index, degree_angle, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    return matches;
+}
+
+/**
+ * @brief Computes the norms of the scene windows under the mask group of a rotated template.
+ *
+ * @param[in] correlator The FFT correlator built once for the source image.
+ * @param[in] bank The template bank.
+ * @param[in] bank_index The index, in the bank, of a rotated template of the group.
+ * @return The window norms shared by all the templates of the mask group.
+ *
+ * @see TemplateBank::maskSpectrum
+ * @see FftCorrelator::windowNorms
+ */
+cv::Mat maskGroupWindowNorms(const FftCorrelator& correlator, const TemplateBank& bank, size_t bank_index)
+{
+    const cv::Size window_size = bank.rotatedTemplates()[bank_index].image.size();
+    const cv::Mat& mask = bank.preparedTemplates()[bank_index].mask;
+    if (mask.empty())
+        return correlator.windowNorms(window_size);
+
+    return correlator.windowNorms(window_size, bank.maskSpectrum(bank.maskGroup(bank_index), correlator.dftSize()), cv::sum(mask)[0]);
+}
 
-    double maxVal;
-    cv::Point maxP;
-    cv::minMaxLoc(NCC_Output, nullptr, &maxVal, nullptr, &maxP);
+/**
+ * @brief Performs template matching of a pre-rotated template with the FFT correlation engine.
+ *
+ * The template only costs one spectrum multiplication and one inverse transform, its kernel spectrum coming from
+ * the spectrum cache of the bank when it holds it. As for `performRotatedTemplateMatching`, the peaks are
+ * directly expressed in source image coordinates.
+ *
+ * @param[in] correlator The FFT correlator built once for the source image.
+ * @param[in] bank The template bank.
+ * @param[in] bank_index The index, in the bank, of the rotated template to match.
+ * @param[in] window_norms The norms of the scene windows under its mask group (see `maskGroupWindowNorms`).
+ * @param[in] options The matching options (peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects holding the coordinates of the matched points in the source image and their scores.
+ *
+ * @note While the matching profiler records, the time of the template is recorded, without the window norms.
+ *
+ * @see FftCorrelator::correlate
+ * @see extractMatches
+ * @see profiledPairMatching
+ */
+std::vector<TemplateMatch> performFftTemplateMatching(const FftCorrelator& correlator, const TemplateBank& bank, size_t bank_index, const cv::Mat& window_norms, const TemplateMatchingOptions& options)
+{
+    const RotatedTemplate& rotated_template = bank.rotatedTemplates()[bank_index];
+    const cv::Size window_size = rotated_template.image.size();
 
-    cv::Point matchCenter(maxP.x + avg_plane.cols / 2, maxP.y + avg_plane.rows / 2);
-    cv::Point matchCenterOriginal = transformPoint(matchCenter, rotation_mat);
+    return profiledPairMatching(rotated_template.template_index, rotated_template.degree_angle, [&]() {
+        const cv::Mat NCC_Output = correlator.correlate(bank.kernelSpectrum(bank_index, correlator.dftSize()), window_size, window_norms, bank.preparedTemplates()[bank_index].norm);
+        return extractMatches(NCC_Output, window_size, rotated_template.template_index, rotated_template.degree_angle, options);
+        });
+}
 
-    local_matched_points.push_back(matchCenterOriginal);
+/**
+ * @brief Performs template matching of the pre-rotated templates of a mask group with the FFT correlation engine.
+ *
+ * The templates of a mask group (the templates of a size cluster at one angle) share their window, so the norms
+ * of the scene windows under it are computed once for the whole group.
+ *
+ * @param[in] correlator The FFT correlator built once for the source image.
+ * @param[in] bank The template bank.
+ * @param[in] bank_indices The indices, in the bank, of the rotated templates to match, all of the same mask group.
+ * @param[in] options The matching options (peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects holding the coordinates of the matched points in the source image and their scores.
+ *
+ * @see TemplateBank::maskGroups
+ * @see maskGroupWindowNorms
+ */
+std::vector<TemplateMatch> performFftTemplateMatching(const FftCorrelator& correlator, const TemplateBank& bank, const std::vector<size_t>& bank_indices, const TemplateMatchingOptions& options)
+{
+    std::vector<TemplateMatch> matches;
+    if (bank_indices.empty())
+        return matches;
 
-    return local_matched_points;
+    const cv::Mat window_norms = maskGroupWindowNorms(correlator, bank, bank_indices.front());
+    for (auto bank_index : bank_indices)
+    {
+        const std::vector<TemplateMatch> local_matches = performFftTemplateMatching(correlator, bank, bank_index, window_norms, options);
+        matches.insert(matches.end(), local_matches.begin(), local_matches.end());
+    }
+    return matches;
 }
 
 /**
@@ -163,66 +455,1486 @@ std::vector<cv::Point> performTemplateMatching(const cv::Mat& src_img, const cv:
  * This function performs template matching on a source image using a set of average planes, rotating each plane by various angles.
  * It uses multi-threading to parallelize the matching process, combining the results into a single list of matched points.
  *
+ * Depending on `options.mode`, either the scene is rotated once per angle and shared by all the planes (`MatchingMode::RotateScene`),
+ * or every plane is rotated once per angle, together with its mask, and correlated against the unrotated scene
+ * (`MatchingMode::RotateTemplates`). The latter avoids the full-scene warps and the padded correlation maps.
+ * `MatchingMode::Fft` also correlates pre-rotated templates, but through an `FftCorrelator` that computes the
+ * scene spectrum and integral images once for all the (plane, angle) pairs; its tasks match the templates of a
+ * mask group, sharing their window norms.
+ *
  * @param[in] src_img The source image in which to perform template matching.
- * @param[in] avg_planes A vector of `cv::Mat` objects representing the average planes used for matching.
- * @return A vector of `cv::Point` objects representing the coordinates of all matched points.
+ * @param[in] bank The template bank: the average planes, rotated by `options.angle_step`.
+ * @param[in] options The matching options (mode, angle step and peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects holding the coordinates and scores of all matched points.
  *
- * @note The function uses a step of 5 degrees for rotating the average planes.
- * @note The function uses `std::async` with `std::launch::async` to perform template matching in parallel.
- * @note The function collects and combines the results from all threads.
+ * @note The (plane, angle) tasks run on the shared thread pool, which bounds both the number of threads and,
+ *       through `matchingTaskMemory`, the memory allocated by the tasks running at once.
+ * @note The function collects and combines the results from all tasks.
+ * @note With `options.pruning_recall` set, the (plane, angle) pairs pruned by the profile are skipped. While the
+ *       matching profiler records, the time of every pair is recorded.
  *
  * @see performTemplateMatching
+ * @see RotationCache
+ * @see performRotatedTemplateMatching
+ * @see performFftTemplateMatching
+ * @see TemplateBank
  * @see angle_range
- * @see std::async
- * @see std::shared_future
+ * @see sharedThreadPool
+ * @see sharedPruningProfile
+ * @see profiledPairMatching
  */
-std::vector<cv::Point> matchTemplateMultiThreaded(const cv::Mat& src_img, const std::vector<cv::Mat>& avg_planes)
+std::vector<TemplateMatch> matchTemplateMultiThreaded(const cv::Mat& src_img, const TemplateBank& bank, const TemplateMatchingOptions& options)
 {
-    std::vector<cv::Point> matched_points;
-    constexpr auto angle_step = 5;
-    std::vector<std::shared_future<std::vector<cv::Point>>> futures;
+    std::vector<TemplateMatch> matches;
+    std::vector<std::future<std::vector<TemplateMatch>>> futures;
 
-    for (const auto& avg_plane : avg_planes)
+    ThreadPool& pool = sharedThreadPool();
+    const size_t task_memory = matchingTaskMemory(src_img.size(), options);
+
+    // Templates are rotated and prepared once, in the bank, so the tasks only need to read them
+    const auto& avg_planes = bank.templates();
+    const auto& rotated_templates = bank.rotatedTemplates();
+
+    // Pairs that (almost) never produced a hit on the training run are skipped
+    const std::shared_ptr<const PruningProfile> pruning_profile = options.pruning_recall > 0 ? sharedPruningProfile(options.pruning_recall, bank) : nullptr;
+    auto is_kept = [&pruning_profile](int template_index, int degree_angle)
     {
-        for (auto degree_angle : angle_range(0, 360, angle_step))
+        return !pruning_profile || pruning_profile->keeps(template_index, degree_angle);
+    };
+
+    // The upright templates are decomposed once, before any matching task is started
+    std::vector<SeparableTemplate> separable_templates(avg_planes.size());
+    if (options.mode == MatchingMode::RotateScene && options.correlation_backend == CorrelationBackend::Separable)
+    {
+        for (size_t i = 0; i < avg_planes.size(); i++)
+            separable_templates[i] = decomposeTemplate(avg_planes[i], options.separable_energy);
+    }
+
+    // The scene-side FFT work is done once, here, and shared by all the tasks
+    std::unique_ptr<FftCorrelator> correlator;
+    if (options.mode == MatchingMode::Fft)
+        correlator = std::make_unique<FftCorrelator>(src_img);
+
+    if (options.mode == MatchingMode::Fft)
+    {
+        bank.useSpectrumCache(correlator->dftSize(), options.spectrum_cache_mb << 20);
+
+        for (const auto& mask_group : bank.maskGroups())
         {
-            futures.emplace_back(std::async(std::launch::async, [src_img, avg_plane, degree_angle]() {
-                return performTemplateMatching(src_img, avg_plane, degree_angle);
-                }));
+            std::vector<size_t> kept_indices;
+            for (auto bank_index : mask_group)
+            {
+                if (is_kept(rotated_templates[bank_index].template_index, rotated_templates[bank_index].degree_angle))
+                    kept_indices.push_back(bank_index);
+            }
+            if (kept_indices.empty())
+                continue;
+
+            futures.emplace_back(pool.submit([&correlator, &bank, kept_indices, &options]() {
+                return performFftTemplateMatching(*correlator, bank, kept_indices, options);
+                }, task_memory));
+        }
+    }
+    else if (options.mode == MatchingMode::RotateTemplates)
+    {
+        for (const auto& rotated_template : rotated_templates)
+        {
+            if (!is_kept(rotated_template.template_index, rotated_template.degree_angle))
+                continue;
+
+            futures.emplace_back(pool.submit([src_img, &rotated_template, &options]() {
+                return profiledPairMatching(rotated_template.template_index, rotated_template.degree_angle, [&]() {
+                    return performRotatedTemplateMatching(src_img, rotated_template, options);
+                    });
+                }, task_memory));
+        }
+    }
+    else
+    {
+        // Only the angles kept for at least one plane are searched
+        std::vector<int> degree_angles;
+        for (auto degree_angle : angle_range(0, 360, options.angle_step))
+        {
+            for (size_t i = 0; i < avg_planes.size(); i++)
+            {
+                if (is_kept(static_cast<int>(i), degree_angle))
+                {
+                    degree_angles.push_back(degree_angle);
+                    break;
+                }
+            }
+        }
+
+        // Only the angles in [0, 90) are warped: the other quadrants are lossless quarter turns of them
+        const RotationCache rotation_cache(src_img, degree_angles);
+
+        for (auto degree_angle : degree_angles)
+        {
+            futures.emplace_back(pool.submit([&rotation_cache, &avg_planes, &separable_templates, &is_kept, degree_angle, &options]() {
+                const RotatedScene rotated_scene = rotation_cache.rotated(degree_angle);
+
+                std::vector<TemplateMatch> angle_matches;
+                for (size_t i = 0; i < avg_planes.size(); i++)
+                {
+                    const int template_index = static_cast<int>(i);
+                    if (!is_kept(template_index, degree_angle))
+                        continue;
+
+                    std::vector<TemplateMatch> local_matches = profiledPairMatching(template_index, degree_angle, [&]() {
+                        return performTemplateMatching(rotated_scene, avg_planes[i], separable_templates[i], template_index, degree_angle, options);
+                        });
+                    angle_matches.insert(angle_matches.end(), local_matches.begin(), local_matches.end());
+                }
+                return angle_matches;
+                }, task_memory));
         }
+
+        for (const auto& local_matches : pool.waitAll(futures))
+            matches.insert(matches.end(), local_matches.begin(), local_matches.end());
+        return matches;
     }
 
-    for (auto& future : futures)
+    for (const auto& local_matches : pool.waitAll(futures))
     {
-        auto local_points = future.get();
-        matched_points.insert(matched_points.end(), local_points.begin(), local_points.end());
+        matches.insert(matches.end(), local_matches.begin(), local_matches.end());
     }
 
-    return matched_points;
+    return matches;
 }
 
 /**
- * @brief Performs template matching on a source image using pre-loaded average planes.
+ * @brief Matches all the rotated templates of a bank against a single tile, sequentially.
  *
- * This function loads a set of average planes and performs multi-threaded template matching on the source image.
- * It returns the coordinates of all matched points found in the image.
+ * The tile is processed by a single task, so the large buffers (tile spectrum, correlation maps) exist once
+ * per running tile, whatever the number of templates. Templates larger than the tile are skipped: the tiles
+ * are sized so that this only happens when the whole scene is smaller than the template.
+ *
+ * @param[in] tile The grayscale tile.
+ * @param[in] tile_origin The position of the tile in the scene, added to the match centers.
+ * @param[in] bank The template bank.
+ * @param[in] options The matching options (mode and peak extraction parameters).
+ * @return A vector of `TemplateMatch` objects, in scene coordinates.
+ *
+ * @see performFftTemplateMatching
+ * @see performRotatedTemplateMatching
+ */
+std::vector<TemplateMatch> matchTile(const cv::Mat& tile, cv::Point tile_origin, const TemplateBank& bank, const TemplateMatchingOptions& options)
+{
+    const auto& rotated_templates = bank.rotatedTemplates();
+
+    std::unique_ptr<FftCorrelator> correlator;
+    if (options.mode == MatchingMode::Fft)
+        correlator = std::make_unique<FftCorrelator>(tile);
+
+    std::vector<TemplateMatch> matches;
+    for (const auto& mask_group : bank.maskGroups())
+    {
+        // The templates of a mask group share their size
+        const cv::Mat& rotated_image = rotated_templates[mask_group.front()].image;
+        if (rotated_image.cols > tile.cols || rotated_image.rows > tile.rows)
+            continue;
+
+        std::vector<TemplateMatch> local_matches;
+        if (correlator)
+            local_matches = performFftTemplateMatching(*correlator, bank, mask_group, options);
+        else
+        {
+            for (auto bank_index : mask_group)
+            {
+                const auto template_matches = performRotatedTemplateMatching(tile, rotated_templates[bank_index], options);
+                local_matches.insert(local_matches.end(), template_matches.begin(), template_matches.end());
+            }
+        }
+
+        for (auto match : local_matches)
+        {
+            match.center += tile_origin;
+            matches.push_back(match);
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Merges the matches found in overlapping tiles.
+ *
+ * The same template window can be seen by several tiles, and a map of the whole scene would only give its
+ * best peaks. The matches are therefore grouped by (template, angle) and, in every group, greedily kept by
+ * descending score, suppressing the ones within the peak radius of a kept match, up to
+ * `options.peaks_per_map` matches. With one peak per map this gives exactly the matches of the untiled search.
+ *
+ * @param[in] matches The matches of all the tiles.
+ * @param[in] bank The template bank, used to compute the default peak radius of every rotated template.
+ * @param[in] options The matching options (peak extraction parameters).
+ * @return The merged matches.
+ *
+ * @see extractMatches
+ */
+std::vector<TemplateMatch> mergeTileMatches(std::vector<TemplateMatch> matches, const TemplateBank& bank, const TemplateMatchingOptions& options)
+{
+    std::map<std::pair<int, int>, int> radii;
+    for (const auto& rotated_template : bank.rotatedTemplates())
+    {
+        const int default_radius = std::min(rotated_template.image.cols, rotated_template.image.rows) / 2;
+        radii[{ rotated_template.template_index, rotated_template.degree_angle }] = options.peak_radius > 0 ? options.peak_radius : default_radius;
+    }
+
+    std::sort(matches.begin(), matches.end(), [](const TemplateMatch& a, const TemplateMatch& b)
+    {
+        return std::tie(a.template_index, a.degree_angle, b.score) < std::tie(b.template_index, b.degree_angle, a.score);
+    });
+
+    std::vector<TemplateMatch> merged_matches;
+    auto group_begin = matches.begin();
+    while (group_begin != matches.end())
+    {
+        const auto group_end = std::find_if(group_begin, matches.end(), [&](const TemplateMatch& match)
+        {
+            return match.template_index != group_begin->template_index || match.degree_angle != group_begin->degree_angle;
+        });
+
+        const int radius = std::max(radii[{ group_begin->template_index, group_begin->degree_angle }], 1);
+        const size_t group_start = merged_matches.size();
+        for (auto it = group_begin; it != group_end && merged_matches.size() - group_start < static_cast<size_t>(options.peaks_per_map); ++it)
+        {
+            const bool suppressed = std::any_of(merged_matches.begin() + group_start, merged_matches.end(), [&](const TemplateMatch& kept)
+            {
+                const cv::Point offset = it->center - kept.center;
+                return offset.dot(offset) < radius * radius;
+            });
+
+            if (!suppressed)
+                merged_matches.push_back(*it);
+        }
+        group_begin = group_end;
+    }
+    return merged_matches;
+}
+
+/**
+ * @brief Performs tiled template matching, with memory bounded by the tile size.
+ *
+ * This function splits the scene into tiles of `options.tile_size` pixels, overlapping by the largest rotated
+ * template side, so that every template window fully inside the scene is also fully inside at least one tile.
+ * The tiles are matched in parallel on the shared thread pool (see `matchTile`), with a memory estimate that
+ * only depends on the tile size, and the matches of the overlaps are merged (see `mergeTileMatches`).
  *
  * @param[in] src_img The source image in which to perform template matching.
- * @return A vector of `cv::Point` objects representing the coordinates of all matched points.
+ * @param[in] bank The template bank: the average planes, rotated by `options.angle_step`.
+ * @param[in] options The matching options: `tile_size` sets the tile side, which is raised to twice the largest
+ *                    rotated template side if smaller.
+ * @return A vector of `TemplateMatch` objects holding the merged matches, in scene coordinates.
  *
- * @note The function uses `loadAvgPlanes` to load the average planes from the predefined directory.
- * @note The function uses `matchTemplateMultiThreaded` to perform multi-threaded template matching.
+ * @note Only the pre-rotated template modes (`MatchingMode::RotateTemplates` and `MatchingMode::Fft`) can be
+ *       tiled, since they do not transform the scene.
  *
- * @see loadAvgPlanes
- * @see matchTemplateMultiThreaded
+ * @see matchTile
+ * @see mergeTileMatches
+ * @see matchingTaskMemory
  */
-std::vector<cv::Point> templateMatching(const cv::Mat& src_img)
+std::vector<TemplateMatch> matchTemplateTiled(const cv::Mat& src_img, const TemplateBank& bank, const TemplateMatchingOptions& options)
+{
+    int overlap = 0;
+    for (const auto& rotated_template : bank.rotatedTemplates())
+        overlap = std::max({ overlap, rotated_template.image.cols, rotated_template.image.rows });
+
+    // A window of side w <= overlap starting at x fits in the tile starting at the largest multiple
+    // of the stride not above x, as long as stride - 1 + w <= tile side
+    const int tile_side = std::max(options.tile_size, 2 * overlap);
+    const int stride = tile_side - overlap + 1;
+
+    auto tile_starts = [&](int scene_side)
+    {
+        std::vector<int> starts;
+        const int tile_length = std::min(tile_side, scene_side);
+        for (int start = 0;; start += stride)
+        {
+            starts.push_back(std::min(start, scene_side - tile_length));
+            if (starts.back() + tile_length >= scene_side)
+                break;
+        }
+        return starts;
+    };
+
+    const cv::Size tile_size(std::min(tile_side, src_img.cols), std::min(tile_side, src_img.rows));
+    const size_t task_memory = matchingTaskMemory(tile_size, options);
+
+    // All the tiles have the same size, so they share the cached template spectra
+    if (options.mode == MatchingMode::Fft)
+        bank.useSpectrumCache(cv::Size(cv::getOptimalDFTSize(tile_size.width), cv::getOptimalDFTSize(tile_size.height)), options.spectrum_cache_mb << 20);
+
+    ThreadPool& pool = sharedThreadPool();
+    std::vector<std::future<std::vector<TemplateMatch>>> futures;
+    for (int y : tile_starts(src_img.rows))
+    {
+        for (int x : tile_starts(src_img.cols))
+        {
+            const cv::Rect tile_rect(cv::Point(x, y), tile_size);
+            futures.emplace_back(pool.submit([tile = src_img(tile_rect), tile_origin = tile_rect.tl(), &bank, &options]() {
+                return matchTile(tile, tile_origin, bank, options);
+                }, task_memory));
+        }
+    }
+
+    std::vector<TemplateMatch> matches;
+    for (const auto& tile_matches : pool.waitAll(futures))
+    {
+        matches.insert(matches.end(), tile_matches.begin(), tile_matches.end());
+    }
+
+    return mergeTileMatches(std::move(matches), bank, options);
+}
+
+/**
+ * @brief Wraps an angle, in degrees, to the range [0, 360).
+ *
+ * @param[in] degree_angle The angle in degrees.
+ * @return The equivalent angle in the range [0, 360).
+ */
+int wrapAngle(int degree_angle)
+{
+    return ((degree_angle % 360) + 360) % 360;
+}
+
+/**
+ * @brief Finds the angle of a sweep nearest to an angle, on the circle.
+ *
+ * The sweep does not have to divide the full turn: with a step of 7 degrees, 359 degrees is nearest to 0,
+ * not to 357.
+ *
+ * @param[in] degree_angle The angle in degrees, in any range.
+ * @param[in] degree_angles The angles of the sweep, as returned by `angle_range`.
+ * @return The index of the nearest angle in `degree_angles`.
+ */
+size_t nearestAngleIndex(double degree_angle, const std::vector<int>& degree_angles)
+{
+    size_t nearest_index = 0;
+    double nearest_distance = 360.0;
+    for (size_t i = 0; i < degree_angles.size(); i++)
+    {
+        const double difference = std::abs(std::remainder(degree_angle - degree_angles[i], 360.0));
+        if (difference < nearest_distance)
+        {
+            nearest_distance = difference;
+            nearest_index = i;
+        }
+    }
+    return nearest_index;
+}
+
+/**
+ * @brief Keeps only the best matches, sorted by descending score.
+ *
+ * @param[in,out] matches The matches to be filtered.
+ * @param[in] max_matches The maximum number of matches to keep.
+ */
+void keepBestMatches(std::vector<TemplateMatch>& matches, size_t max_matches)
+{
+    std::sort(matches.begin(), matches.end(), [](const TemplateMatch& a, const TemplateMatch& b)
+    {
+        return a.score > b.score;
+    });
+
+    if (matches.size() > max_matches)
+        matches.resize(max_matches);
+}
+
+/**
+ * @brief Refines a match found at a coarser pyramid level.
+ *
+ * This function projects the match center to the next finer pyramid level and searches the template
+ * rotated by the candidate angle and by its two neighbours (at the angle step of the finer level) in a small
+ * window around the projected center. The rotated, prepared templates are read from the bank of the finer
+ * level, and the correlation is computed locally, on the window only.
+ *
+ * @param[in] scene The scene at the finer pyramid level.
+ * @param[in] level_bank The template bank of the finer pyramid level, at its angle step.
+ * @param[in] candidate The match found at the coarser level.
+ * @param[in] integer_correlation Whether to correlate with the integer kernels (`CorrelationBackend::Integer`).
+ * @return The best match around the candidate at the finer level. If the candidate cannot be refined
+ *         (e.g. the window falls outside the scene), the returned match has a score of -1.
+ *
+ * @note Neighbour angles off the angle grid of the bank (when the step does not divide 360) are not searched,
+ *       as in the exhaustive search.
+ *
+ * @see sharedPyramidBanks
+ * @see correlateLocally
+ */
+TemplateMatch refineMatch(const cv::Mat& scene, const TemplateBank& level_bank, const TemplateMatch& candidate, bool integer_correlation)
+{
+    // A coarse pixel covers two fine pixels, plus one pixel of uncertainty on each side
+    constexpr int search_radius = 2;
+    const cv::Point predicted_center(candidate.center.x * 2, candidate.center.y * 2);
+    const cv::Rect scene_rect(0, 0, scene.cols, scene.rows);
+
+    const int angle_step = level_bank.angleStep();
+    const size_t num_angles = level_bank.rotatedTemplates().size() / level_bank.templates().size();
+
+    TemplateMatch best_match{ predicted_center, -1.0f, candidate.template_index, candidate.degree_angle };
+
+    for (const int angle_offset : { -angle_step, 0, angle_step })
+    {
+        const int degree_angle = wrapAngle(candidate.degree_angle + angle_offset);
+        if (degree_angle % angle_step != 0)
+            continue;
+
+        const size_t bank_index = static_cast<size_t>(candidate.template_index) * num_angles + degree_angle / angle_step;
+        const RotatedTemplate& rotated_template = level_bank.rotatedTemplates()[bank_index];
+        const cv::Size template_size = rotated_template.image.size();
+
+        const cv::Rect window = cv::Rect(
+            predicted_center.x - template_size.width / 2 - search_radius,
+            predicted_center.y - template_size.height / 2 - search_radius,
+            template_size.width + 2 * search_radius,
+            template_size.height + 2 * search_radius) & scene_rect;
+
+        if (window.width < template_size.width || window.height < template_size.height)
+            continue;
+
+        const cv::Mat NCC_Output = correlateLocally(scene(window), level_bank.preparedTemplates()[bank_index], integer_correlation);
+
+        double maxVal;
+        cv::Point maxP;
+        cv::minMaxLoc(NCC_Output, nullptr, &maxVal, nullptr, &maxP);
+
+        if (maxVal > best_match.score)
+        {
+            best_match.center = cv::Point(window.x + maxP.x + template_size.width / 2, window.y + maxP.y + template_size.height / 2);
+            best_match.score = static_cast<float>(maxVal);
+            best_match.degree_angle = rotated_template.degree_angle;
+        }
+    }
+    return best_match;
+}
+
+/**
+ * @brief Returns the process-wide template banks of the pyramid levels.
+ *
+ * Level 0 is the shared bank itself. Every coarser level holds the templates of the finer one downsampled by
+ * `cv::pyrDown`, rotated at an angle step that doubles at every level, and prepared, so neither the coarse
+ * sweep nor the refinement tasks rotate or prepare a template. The banks are built once and then shared by all
+ * the subsequent calls with the same shared bank and number of levels; they are dropped with the bank file.
+ *
+ * @param[in] bank The shared template bank, the full resolution level.
+ * @param[in] levels The number of downsampling levels.
+ * @return A shared pointer to the banks of the levels 0 to `levels`.
+ *
+ * @see buildTemplateBank
+ * @see sharedTemplateBank
+ */
+std::shared_ptr<const PyramidBanks> sharedPyramidBanks(const std::shared_ptr<const TemplateBank>& bank, int levels)
 {
-    // Load average planes
-    std::vector<cv::Mat> avg_planes = loadAvgPlanes();
+    std::lock_guard<std::mutex> lock(pyramid_mutex);
+    if (shared_pyramid && shared_pyramid->front() == bank && shared_pyramid->size() == static_cast<size_t>(levels) + 1)
+        return shared_pyramid;
+
+    auto pyramid = std::make_shared<PyramidBanks>();
+    pyramid->push_back(bank);
+
+    std::vector<cv::Mat> level_planes = bank->templates();
+    for (int level = 1; level <= levels; level++)
+    {
+        std::vector<cv::Mat> downsampled_planes;
+        for (const auto& avg_plane : level_planes)
+        {
+            cv::Mat downsampled_plane;
+            cv::pyrDown(avg_plane, downsampled_plane);
+            downsampled_planes.push_back(downsampled_plane);
+        }
+        level_planes = std::move(downsampled_planes);
+        pyramid->push_back(std::make_shared<const TemplateBank>(buildTemplateBank(level_planes, bank->angleStep() << level)));
+    }
+
+    shared_pyramid = pyramid;
+    return shared_pyramid;
+}
 
-    // Find template matches
-    std::vector<cv::Point> matched_points = matchTemplateMultiThreaded(src_img, avg_planes);
+/**
+ * @brief Performs coarse-to-fine template matching on an image pyramid.
+ *
+ * This function builds a Gaussian pyramid of the source image and reads the banks of the template pyramid
+ * (see `sharedPyramidBanks`). The full angle sweep is only run at the coarsest level, with the FFT engine and an
+ * angle step that doubles at every level. The best candidates are then refined level by level (see
+ * `refineMatch`), halving the angle step each time, so that the full-resolution matches lie on the same angle
+ * grid as the exhaustive search.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] bank The shared template bank, at the angle step of the options.
+ * @param[in] options The matching options: `pyramid_levels` sets the number of downsampling levels and
+ *                    `pyramid_candidates` the number of candidates kept at every level.
+ * @return A vector of `TemplateMatch` objects holding the refined full-resolution matches.
+ *
+ * @note The number of levels is reduced if the smallest template would become smaller than 8 pixels.
+ *
+ * @see matchTemplateMultiThreaded
+ * @see refineMatch
+ * @see sharedPyramidBanks
+ * @see cv::pyrDown
+ */
+std::vector<TemplateMatch> matchTemplatePyramid(const cv::Mat& src_img, const std::shared_ptr<const TemplateBank>& bank, const TemplateMatchingOptions& options)
+{
+    constexpr int min_template_side = 8;
+    int levels = options.pyramid_levels;
+    for (const auto& avg_plane : bank->templates())
+    {
+        while (levels > 0 && std::min(avg_plane.cols, avg_plane.rows) >> levels < min_template_side)
+            levels--;
+    }
+
+    // Level 0 is the full resolution, level `levels` the coarsest one
+    const std::shared_ptr<const PyramidBanks> level_banks = sharedPyramidBanks(bank, levels);
+    std::vector<cv::Mat> scene_pyramid{ src_img };
+    for (int level = 1; level <= levels; level++)
+    {
+        cv::Mat downsampled_scene;
+        cv::pyrDown(scene_pyramid.back(), downsampled_scene);
+        scene_pyramid.push_back(downsampled_scene);
+    }
+
+    // Full angle sweep at the coarsest level. The pruning profile is recorded for the full resolution bank, so
+    // it does not apply to the coarse one
+    TemplateMatchingOptions coarse_options = options;
+    coarse_options.mode = MatchingMode::Fft;
+    coarse_options.angle_step = options.angle_step << levels;
+    coarse_options.pruning_recall = 0.0;
+
+    std::vector<TemplateMatch> candidates = matchTemplateMultiThreaded(scene_pyramid[levels], *(*level_banks)[levels], coarse_options);
+    keepBestMatches(candidates, options.pyramid_candidates);
+
+    // Refinement of the best candidates, level by level
+    const bool integer_correlation = options.correlation_backend == CorrelationBackend::Integer;
+    for (int level = levels - 1; level >= 0; level--)
+    {
+        std::vector<std::future<TemplateMatch>> futures;
+        for (const auto& candidate : candidates)
+        {
+            futures.emplace_back(sharedThreadPool().submit([&scene = scene_pyramid[level], &level_bank = *(*level_banks)[level], candidate, integer_correlation]() {
+                return refineMatch(scene, level_bank, candidate, integer_correlation);
+                }));
+        }
+
+        candidates.clear();
+        for (const auto& refined_match : sharedThreadPool().waitAll(futures))
+        {
+            if (refined_match.score >= 0)
+                candidates.push_back(refined_match);
+        }
+        keepBestMatches(candidates, options.pyramid_candidates);
+    }
+
+    return candidates;
+}
+
+/**
+ * @brief Searches the templates around a candidate location, at the angles suggested by its orientation.
+ *
+ * The orientation of the scene around the candidate is estimated over the same disk as the one of the
+ * templates, so the rotation between a template and the candidate is the difference of the two orientations,
+ * modulo 180 degrees (see `estimateOrientation`). Each template is correlated at that rotation and at the
+ * opposite one, both widened by `options.orientation_window` degrees and snapped to the nearest angles of the
+ * bank (see `nearestAngleIndex`).
+ * If either orientation is unreliable (isotropic gradients), all the angles of the bank are tried.
+ *
+ * The correlation is computed locally, over the template window widened by `search_radius` on every side.
+ *
+ * @param[in] src_img The source image.
+ * @param[in] bank The template bank.
+ * @param[in] template_orientations The orientations of the upright templates.
+ * @param[in] candidate The candidate center, in source image coordinates.
+ * @param[in] disk_diameter The diameter of the disk over which the orientations are estimated.
+ * @param[in] search_radius The uncertainty, in pixels, of the candidate location.
+ * @param[in] options The matching options.
+ * @return The best match around the candidate. If the candidate is too close to the image border,
+ *         the returned match has a score of -1.
+ *
+ * @see estimateOrientation
+ * @see nearestAngleIndex
+ * @see correlateLocally
+ */
+TemplateMatch matchCandidate(const cv::Mat& src_img, const TemplateBank& bank, const std::vector<Orientation>& template_orientations, cv::Point candidate, int disk_diameter, int search_radius, const TemplateMatchingOptions& options)
+{
+    // Below this coherence the gradients have no clear dominant orientation
+    constexpr double min_coherence = 0.05;
+
+    const cv::Rect scene_rect(0, 0, src_img.cols, src_img.rows);
+    TemplateMatch best_match{ candidate, -1.0f, 0, 0 };
+
+    const cv::Rect disk_rect(candidate.x - disk_diameter / 2, candidate.y - disk_diameter / 2, disk_diameter, disk_diameter);
+    if ((disk_rect & scene_rect) != disk_rect)
+        return best_match;
+
+    const Orientation scene_orientation = estimateOrientation(src_img(disk_rect), diskMask(disk_diameter));
+
+    const int angle_step = bank.angleStep();
+    const std::vector<int> all_angles = angle_range(0, 360, angle_step);
+    const auto& rotated_templates = bank.rotatedTemplates();
+    const auto& prepared_templates = bank.preparedTemplates();
+
+    for (size_t i = 0; i < template_orientations.size(); i++)
+    {
+        // Indices of the searched angles in the sweep
+        std::set<size_t> angle_indices;
+        if (scene_orientation.coherence < min_coherence || template_orientations[i].coherence < min_coherence)
+        {
+            for (size_t a = 0; a < all_angles.size(); a++)
+                angle_indices.insert(a);
+        }
+        else
+        {
+            const double estimated_angle = template_orientations[i].degree_angle - scene_orientation.degree_angle;
+            for (const double flip : { 0.0, 180.0 })
+            {
+                for (int offset = -options.orientation_window; offset <= options.orientation_window; offset += angle_step)
+                    angle_indices.insert(nearestAngleIndex(estimated_angle + flip + offset, all_angles));
+            }
+        }
+
+        for (const size_t angle_index : angle_indices)
+        {
+            // The bank holds, for every template, its rotations by all the angles of the sweep
+            const size_t bank_index = i * all_angles.size() + angle_index;
+            const RotatedTemplate& rotated_template = rotated_templates[bank_index];
+            const cv::Size template_size = rotated_template.image.size();
+
+            const cv::Rect window = cv::Rect(
+                candidate.x - template_size.width / 2 - search_radius,
+                candidate.y - template_size.height / 2 - search_radius,
+                template_size.width + 2 * search_radius,
+                template_size.height + 2 * search_radius) & scene_rect;
+
+            if (window.width < template_size.width || window.height < template_size.height)
+                continue;
+
+            const cv::Mat NCC_Output = correlateLocally(src_img(window), prepared_templates[bank_index], options.correlation_backend == CorrelationBackend::Integer);
+
+            double maxVal;
+            cv::Point maxP;
+            cv::minMaxLoc(NCC_Output, nullptr, &maxVal, nullptr, &maxP);
+
+            if (maxVal > best_match.score)
+            {
+                best_match.center = cv::Point(window.x + maxP.x + template_size.width / 2, window.y + maxP.y + template_size.height / 2);
+                best_match.score = static_cast<float>(maxVal);
+                best_match.template_index = rotated_template.template_index;
+                best_match.degree_angle = rotated_template.degree_angle;
+            }
+        }
+    }
+    return best_match;
+}
+
+/**
+ * @brief Performs orientation-guided template matching.
+ *
+ * Instead of sweeping every angle over the whole scene, this function:
+ * - proposes candidate locations: the local maxima of the variance of the scene over the smallest template
+ *   window (see `localVariance`), at most `options.orientation_candidates` of them, half a template apart;
+ * - estimates the dominant orientation of the scene around each candidate and of every upright template;
+ * - correlates each template, around each candidate only, at the few angles compatible with the two
+ *   orientations (see `matchCandidate`).
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] bank The template bank, rotated by `options.angle_step`.
+ * @param[in] options The matching options.
+ * @return A vector of `TemplateMatch` objects holding the best match around every candidate scoring at least
+ *         `options.peak_threshold`.
+ *
+ * @note The candidates are matched in parallel on the shared thread pool.
+ *
+ * @see localVariance
+ * @see extractPeaks
+ * @see estimateOrientation
+ * @see matchCandidate
+ */
+std::vector<TemplateMatch> matchTemplateOriented(const cv::Mat& src_img, const TemplateBank& bank, const TemplateMatchingOptions& options)
+{
+    const auto& avg_planes = bank.templates();
+    if (avg_planes.empty())
+        return {};
+
+    cv::Size min_template_size = avg_planes.front().size();
+    for (const auto& avg_plane : avg_planes)
+    {
+        min_template_size.width = std::min(min_template_size.width, avg_plane.cols);
+        min_template_size.height = std::min(min_template_size.height, avg_plane.rows);
+    }
+    if (min_template_size.width > src_img.cols || min_template_size.height > src_img.rows)
+        return {};
+
+    // The orientations are all estimated over the disk inscribed in the smallest template, which does not
+    // change as the content rotates
+    const int disk_diameter = std::min(min_template_size.width, min_template_size.height);
+    const cv::Mat disk_mask = diskMask(disk_diameter);
+    std::vector<Orientation> template_orientations;
+    for (const auto& avg_plane : avg_planes)
+    {
+        const cv::Rect disk_rect((avg_plane.cols - disk_diameter) / 2, (avg_plane.rows - disk_diameter) / 2, disk_diameter, disk_diameter);
+        template_orientations.push_back(estimateOrientation(avg_plane(disk_rect), disk_mask));
+    }
+
+    // A candidate may be off the object center by about the distance between two candidates
+    const int candidate_radius = disk_diameter / 2;
+    const std::vector<Peak> peaks = extractPeaks(localVariance(src_img, min_template_size), options.orientation_candidates, 0.0f, candidate_radius);
+
+    std::vector<std::future<TemplateMatch>> futures;
+    for (const auto& peak : peaks)
+    {
+        const cv::Point candidate(peak.location.x + min_template_size.width / 2, peak.location.y + min_template_size.height / 2);
+        futures.emplace_back(sharedThreadPool().submit([&src_img, &bank, &template_orientations, candidate, disk_diameter, candidate_radius, &options]() {
+            return matchCandidate(src_img, bank, template_orientations, candidate, disk_diameter, candidate_radius, options);
+            }));
+    }
+
+    std::vector<TemplateMatch> matches;
+    for (const auto& match : sharedThreadPool().waitAll(futures))
+    {
+        if (match.score >= 0 && match.score >= options.peak_threshold)
+            matches.push_back(match);
+    }
+    return matches;
+}
+
+/**
+ * @brief Returns the path of the template bank file, next to the average planes.
+ */
+std::filesystem::path templateBankPath()
+{
+    return std::filesystem::path(SRC_DIR_PATH) / "avg_airplanes" / "template_bank.bin";
+}
+
+/**
+ * @brief Returns the process-wide template bank for a given angle step.
+ *
+ * The bank is built once and then shared by all the subsequent calls, so a batch of images does no
+ * per-image template I/O, rotation or decomposition. It is loaded (memory-mapped) from the file written by
+ * `saveTemplateBank` when it exists, template basis included; if its angle step differs, the rotated variants
+ * are rebuilt from copies of the upright templates of the file, which is unmapped once the rebuilt bank is made.
+ * Without a bank file, the average planes are read from their PNGs.
+ *
+ * @param[in] angle_step The angle step, in degrees, of the rotated variants.
+ * @return A shared pointer to the template bank.
+ *
+ * @see TemplateBank::load
+ * @see buildTemplateBank
+ * @see loadAvgPlanes
+ */
+std::shared_ptr<const TemplateBank> sharedTemplateBank(int angle_step)
+{
+    std::lock_guard<std::mutex> lock(bank_mutex);
+    if (shared_bank && shared_bank->angleStep() == angle_step)
+        return shared_bank;
+
+    const auto bank_path = templateBankPath();
+    if (std::filesystem::exists(bank_path))
+    {
+        TemplateBank saved_bank = TemplateBank::load(bank_path.string());
+        if (saved_bank.angleStep() == angle_step)
+        {
+            shared_bank = std::make_shared<const TemplateBank>(std::move(saved_bank));
+        }
+        else
+        {
+            // The templates of the saved bank point into its mapping, which does not outlive it
+            std::vector<cv::Mat> avg_planes;
+            for (const auto& avg_plane : saved_bank.templates())
+                avg_planes.push_back(avg_plane.clone());
+            shared_bank = std::make_shared<const TemplateBank>(buildTemplateBank(avg_planes, angle_step));
+        }
+    }
+    else
+    {
+        shared_bank = std::make_shared<const TemplateBank>(buildTemplateBank(loadAvgPlanes(), angle_step));
+    }
+    return shared_bank;
+}
+
+/**
+ * @brief Returns the path of the pruning profile file, next to the average planes.
+ */
+std::filesystem::path pruningProfilePath()
+{
+    return std::filesystem::path(SRC_DIR_PATH) / "avg_airplanes" / "pruning_profile.csv";
+}
+
+/**
+ * @brief Returns the process-wide pruning profile for a given target recall.
+ *
+ * The profile is loaded once from the file written by `saveMatchingProfile`, and its expected recall loss and
+ * speedup (measured on the recorded run) are reported when it is loaded.
+ *
+ * @param[in] target_recall The fraction of the recorded hits to keep, in (0, 1].
+ * @param[in] bank The template bank the profile is applied to.
+ * @return A shared pointer to the pruning profile.
+ *
+ * @throws std::runtime_error If the profile does not match the template bank (number of templates or angle step).
+ *
+ * @see loadPruningProfile
+ */
+std::shared_ptr<const PruningProfile> sharedPruningProfile(double target_recall, const TemplateBank& bank)
+{
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    if (!shared_profile || shared_profile_recall != target_recall)
+    {
+        shared_profile = std::make_shared<const PruningProfile>(loadPruningProfile(pruningProfilePath(), target_recall));
+        shared_profile_recall = target_recall;
+
+        const size_t kept_pairs = std::count(shared_profile->kept_pairs.begin(), shared_profile->kept_pairs.end(), true);
+        std::cout << "Pruning profile: " << kept_pairs << "/" << shared_profile->kept_pairs.size() << " (template, angle) pairs kept, "
+            << "expected recall loss " << 100.0 * (1.0 - shared_profile->expected_recall) << "%, "
+            << "expected speedup " << shared_profile->expected_speedup << "x\n";
+    }
+
+    if (shared_profile->num_templates != static_cast<int>(bank.templates().size()) || shared_profile->angle_step != bank.angleStep())
+        throw std::runtime_error("The pruning profile does not match the template bank (number of templates or angle step).");
+
+    return shared_profile;
+}
+
+/**
+ * @brief Starts recording the matching statistics of the shared template bank.
+ *
+ * @see MatchingProfiler::start
+ */
+void startMatchingProfile()
+{
+    const TemplateMatchingOptions& options = templateMatchingOptions();
+    matchingProfiler().start(static_cast<int>(sharedTemplateBank(options.angle_step)->templates().size()), options.angle_step);
+}
+
+/**
+ * @brief Stops recording the matching statistics and saves them as the pruning profile, next to the average planes.
+ *
+ * @see savePruningProfile
+ * @see sharedPruningProfile
+ */
+void saveMatchingProfile()
+{
+    matchingProfiler().stop();
+    savePruningProfile(matchingProfiler(), pruningProfilePath());
+}
+
+/**
+ * @brief Builds the template bank from the average planes and saves it next to them.
+ *
+ * The bank holds the rotated variants for the angle step of the process-wide options and the decomposition of
+ * the templates used by the eigen-basis mode, so the matching steps run with the same options find it ready to
+ * use. The file is replaced rather than overwritten, and the shared bank loaded from the former file is dropped.
+ *
+ * @see buildTemplateBank
+ * @see TemplateBank::save
+ * @see sharedTemplateBank
+ */
+void saveTemplateBank()
+{
+    replaceTemplateBankFile(buildTemplateBank(loadAvgPlanes(), templateMatchingOptions().angle_step), templateBankPath());
+}
+
+/**
+ * @brief Drops the redundant templates of the template bank and saves the compacted bank in its place.
+ *
+ * Two templates are redundant when they are at least `min_similarity` similar up to a rotation of the sweep
+ * and a moderate scaling (see `templateSimilarity`): the first one in bank order stands for the other, which is
+ * dropped. The dropped templates are reported with their representative, together with the number of
+ * (template, angle) pairs before and after compaction. Since every pair costs the same correlation whatever
+ * the template size, the fraction of dropped pairs is the expected saving of matching time.
+ *
+ * @param[in] min_similarity The similarity from which a template is redundant, in (0, 1].
+ *
+ * @note A pruning profile recorded on the former bank no longer matches the compacted one: when templates are
+ *       dropped, its file is deleted and it has to be recorded again (see `saveMatchingProfile`).
+ *
+ * @see findRedundantTemplates
+ * @see saveTemplateBank
+ */
+void compactTemplateBank(double min_similarity)
+{
+    // Templates whose areas differ by more than 25% describe aircraft of different classes
+    constexpr double max_area_ratio = 1.25;
+
+    const int angle_step = templateMatchingOptions().angle_step;
+    std::vector<cv::Mat> kept_templates;
+    size_t num_templates = 0;
+    {
+        // The templates point into the mapping of the bank, which is held until the kept ones are copied
+        const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(angle_step);
+        const std::vector<cv::Mat>& templates = bank->templates();
+        const TemplateRedundancy redundancy = findRedundantTemplates(templates, angle_step, min_similarity, max_area_ratio);
+
+        num_templates = templates.size();
+        for (size_t i = 0; i < templates.size(); i++)
+        {
+            if (redundancy.representatives[i] == static_cast<int>(i))
+                kept_templates.push_back(templates[i].clone());
+            else
+                std::cout << "Template " << i << " dropped: " << 100.0 * redundancy.similarities[i] << "% similar to template "
+                    << redundancy.representatives[i] << "\n";
+        }
+    }
+
+    const TemplateBank compacted_bank = buildTemplateBank(kept_templates, angle_step);
+    replaceTemplateBankFile(compacted_bank, templateBankPath());
+
+    const size_t num_pairs = num_templates * angle_range(0, 360, angle_step).size();
+    const size_t kept_pairs = compacted_bank.rotatedTemplates().size();
+    std::cout << "Template bank compacted: " << kept_templates.size() << "/" << num_templates << " templates, "
+        << kept_pairs << "/" << num_pairs << " (template, angle) pairs kept, expected matching time saving "
+        << 100.0 * (num_pairs - kept_pairs) / num_pairs << "%\n";
+
+    if (kept_templates.size() < num_templates)
+    {
+        std::lock_guard<std::mutex> lock(profile_mutex);
+        shared_profile.reset();
+        if (std::filesystem::remove(pruningProfilePath()))
+            std::cout << "The pruning profile no longer matches the template bank: it is deleted and has to be recorded again.\n";
+    }
+}
+
+/**
+ * @brief Returns the process-wide template matching options.
+ *
+ * The returned options are used by `templateMatching(const cv::Mat&)`, so that the pipeline steps
+ * calling it (e.g. `generateSvmTrainingData`) follow the options given on the command line.
+ *
+ * @return A mutable reference to the process-wide `TemplateMatchingOptions`.
+ */
+TemplateMatchingOptions& templateMatchingOptions()
+{
+    static TemplateMatchingOptions options;
+    return options;
+}
+
+/**
+ * @brief Converts a matching mode name to the corresponding `MatchingMode`.
+ *
+ * @param[in] mode The mode name: "rotate-scene", "rotate-templates", "fft" or "pyramid".
+ * @return The corresponding `MatchingMode`.
+ *
+ * @throws std::invalid_argument If the mode name is unknown.
+ */
+MatchingMode parseMatchingMode(const std::string& mode)
+{
+    if (mode == "rotate-scene")
+        return MatchingMode::RotateScene;
+    if (mode == "rotate-templates")
+        return MatchingMode::RotateTemplates;
+    if (mode == "fft")
+        return MatchingMode::Fft;
+    if (mode == "pyramid")
+        return MatchingMode::Pyramid;
+    if (mode == "oriented")
+        return MatchingMode::Oriented;
+    if (mode == "eigen")
+        return MatchingMode::EigenBasis;
+
+    throw std::invalid_argument("Unknown matching mode: " + mode);
+}
+
+/**
+ * @brief Converts a correlation backend name to the corresponding `CorrelationBackend`.
+ *
+ * @param[in] backend The backend name: "float", "int8" or "separable".
+ * @return The corresponding `CorrelationBackend`.
+ *
+ * @throws std::invalid_argument If the backend name is unknown.
+ */
+CorrelationBackend parseCorrelationBackend(const std::string& backend)
+{
+    if (backend == "float")
+        return CorrelationBackend::Float;
+    if (backend == "int8")
+        return CorrelationBackend::Integer;
+    if (backend == "separable")
+        return CorrelationBackend::Separable;
+
+    throw std::invalid_argument("Unknown correlation backend: " + backend);
+}
+
+/**
+ * @brief Returns the process-wide template basis of the eigen-basis mode, for an energy threshold.
+ *
+ * The decomposition of the templates is computed once with the bank and saved in its file (see
+ * `TemplateBank::basis`), so this function only keeps its leading components. The truncated basis is shared by
+ * all the subsequent calls with the same bank and threshold, and its number of components and reconstruction
+ * error are reported when it is made.
+ *
+ * @param[in] bank The shared template bank.
+ * @param[in] energy_threshold The fraction of the energy of the templates to keep, in (0, 1].
+ * @return A shared pointer to the truncated basis.
+ *
+ * @see truncateTemplateBasis
+ * @see sharedTemplateBank
+ */
+std::shared_ptr<const TemplateBasis> sharedEigenBasis(const std::shared_ptr<const TemplateBank>& bank, double energy_threshold)
+{
+    std::lock_guard<std::mutex> lock(basis_mutex);
+    if (shared_basis && basis_bank == bank && basis_energy == energy_threshold)
+        return shared_basis;
+
+    shared_basis = std::make_shared<const TemplateBasis>(truncateTemplateBasis(bank->basis(), energy_threshold));
+    basis_bank = bank;
+    basis_energy = energy_threshold;
+    std::cout << "Eigen-basis matching: " << shared_basis->components.size() << " components for " << bank->templates().size()
+        << " templates, worst reconstruction error " << 100.0 * shared_basis->reconstruction_error << "%\n";
+
+    return shared_basis;
+}
+
+/**
+ * @brief Performs template matching through the principal components shared by all the templates.
+ *
+ * The templates are decomposed on a few orthonormal components (see `sharedEigenBasis`). For every angle,
+ * only the rotated components are correlated with the scene, through an `FftCorrelator` shared by all the
+ * angles. The raw correlation of every template is then the linear combination of the component correlations
+ * given by its coordinates, normalized with the local scene statistics over the rotated template window.
+ * With N templates and k components, this replaces N full correlations per angle with k of them.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] bank The shared template bank, rotated by `options.angle_step`.
+ * @param[in] options The matching options: `eigen_energy` sets the number of components.
+ * @return A vector of `TemplateMatch` objects holding the coordinates and scores of all matched points.
+ *
+ * @note The scores approximate the ones of `MatchingMode::Fft`: the templates are reconstructed from the
+ *       components, and the black corners of the rotation are part of the scene window.
+ * @note Template positions closer to the border than the common frame allows are not searched.
+ *
+ * @see sharedEigenBasis
+ * @see FftCorrelator::rawCorrelation
+ * @see FftCorrelator::normalize
+ */
+std::vector<TemplateMatch> matchTemplateEigenBasis(const cv::Mat& src_img, const std::shared_ptr<const TemplateBank>& bank, const TemplateMatchingOptions& options)
+{
+    const std::shared_ptr<const TemplateBasis> shared_eigen_basis = sharedEigenBasis(bank, options.eigen_energy);
+    const TemplateBasis& basis = *shared_eigen_basis;
+    if (basis.components.empty())
+        return {};
+
+    const FftCorrelator correlator(src_img);
+    const auto& rotated_templates = bank->rotatedTemplates();
+    const std::vector<int> degree_angles = angle_range(0, 360, bank->angleStep());
+
+    // One raw correlation map per component, the combined map and the double precision normalization temporaries
+    const size_t src_area = static_cast<size_t>(src_img.size().area());
+    const size_t dft_area = static_cast<size_t>(correlator.dftSize().area());
+    const size_t task_memory = src_area * ((basis.components.size() + 2) * sizeof(float) + 4 * sizeof(double)) + dft_area * 2 * sizeof(float);
+
+    ThreadPool& pool = sharedThreadPool();
+    std::vector<std::future<std::vector<TemplateMatch>>> futures;
+    for (size_t a = 0; a < degree_angles.size(); a++)
+    {
+        futures.emplace_back(pool.submit([&correlator, &basis, &rotated_templates, num_angles = degree_angles.size(), a, degree_angle = degree_angles[a], &options]() {
+            cv::Size rotated_frame_size;
+            const cv::Mat rotation_mat = rotationMatrix(basis.frame_size, -degree_angle, rotated_frame_size);
+            if (rotated_frame_size.width > correlator.sceneSize().width || rotated_frame_size.height > correlator.sceneSize().height)
+                return std::vector<TemplateMatch>();
+
+            std::vector<cv::Mat> component_correlations;
+            for (const auto& component : basis.components)
+            {
+                cv::Mat rotated_component;
+                cv::warpAffine(component, rotated_component, rotation_mat, rotated_frame_size, cv::INTER_LINEAR);
+                component_correlations.push_back(correlator.rawCorrelation(rotated_component));
+            }
+
+            std::vector<TemplateMatch> angle_matches;
+            for (int i = 0; i < basis.coefficients.rows; i++)
+            {
+                cv::Mat correlation = cv::Mat::zeros(component_correlations.front().size(), CV_32F);
+                for (int k = 0; k < basis.coefficients.cols; k++)
+                    cv::scaleAdd(component_correlations[k], basis.coefficients.at<double>(i, k), correlation, correlation);
+
+                // The rotated template window is centered on the rotated center of the template in the frame
+                const cv::Size template_size = rotated_templates[i * num_angles + a].image.size();
+                const cv::Rect& template_rect = basis.template_rects[i];
+                const cv::Point rotated_center = transformPoint(cv::Point(template_rect.x + template_rect.width / 2, template_rect.y + template_rect.height / 2), rotation_mat);
+                const cv::Point window_offset(
+                    std::clamp(rotated_center.x - template_size.width / 2, 0, rotated_frame_size.width - template_size.width),
+                    std::clamp(rotated_center.y - template_size.height / 2, 0, rotated_frame_size.height - template_size.height));
+
+                const cv::Mat NCC_Output = correlator.normalize(correlation, window_offset, template_size, cv::norm(basis.coefficients.row(i)));
+
+                for (auto match : extractMatches(NCC_Output, template_size, i, degree_angle, options))
+                {
+                    match.center += window_offset;
+                    angle_matches.push_back(match);
+                }
+            }
+            return angle_matches;
+            }, task_memory));
+    }
+
+    std::vector<TemplateMatch> matches;
+    for (const auto& local_matches : pool.waitAll(futures))
+        matches.insert(matches.end(), local_matches.begin(), local_matches.end());
+
+    return matches;
+}
+
+/**
+ * @brief Performs template matching inside the regions selected by the proposal stage only.
+ *
+ * The proposal mask (see `proposeRegions`) is turned into a few disjoint regions, each large enough to hold any
+ * rotated template centered in the mask (see `proposalRegions`). The regions are matched one after the other,
+ * each with the engine selected by `options.mode`, and only the matches centered in the mask are kept.
+ *
+ * With a deadline, the budget covers the proposal stage too, and what remains of it before a region is shared
+ * evenly by the regions left: every region runs the anytime search with its share, and the time a region does
+ * not use goes to the next ones.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] options The matching options: `proposal_method` and `proposal_fraction` configure the proposals.
+ * @return A vector of `TemplateMatch` objects holding the matches found in the proposed regions.
+ *
+ * @see proposeRegions
+ * @see proposalRegions
+ * @see findTemplateMatches
+ * @see anytimeTemplateMatching
+ */
+std::vector<TemplateMatch> matchTemplateInProposals(const cv::Mat& src_img, const TemplateMatchingOptions& options)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(options.angle_step);
+    if (bank->empty())
+        return {};
+
+    cv::Size min_template_size = bank->templates().front().size();
+    for (const auto& avg_plane : bank->templates())
+    {
+        min_template_size.width = std::min(min_template_size.width, avg_plane.cols);
+        min_template_size.height = std::min(min_template_size.height, avg_plane.rows);
+    }
+
+    int max_template_side = 0;
+    for (const auto& rotated_template : bank->rotatedTemplates())
+        max_template_side = std::max({ max_template_side, rotated_template.image.cols, rotated_template.image.rows });
+
+    const cv::Mat proposal_mask = proposeRegions(src_img, options.proposal_method, options.proposal_fraction, min_template_size);
+    const std::vector<cv::Rect> regions = proposalRegions(proposal_mask, max_template_side / 2 + 1, cv::Size(max_template_side, max_template_side));
+
+    TemplateMatchingOptions region_options = options;
+    region_options.proposal_method = ProposalMethod::None;
+
+    // The centers of the rotate-scene matches are mapped back from the rotated region, so they can fall outside of it
+    const cv::Rect mask_rect(0, 0, proposal_mask.cols, proposal_mask.rows);
+
+    std::vector<TemplateMatch> matches;
+    for (size_t i = 0; i < regions.size(); i++)
+    {
+        const cv::Rect& region = regions[i];
+        if (options.deadline_ms > 0)
+        {
+            const double remaining_ms = options.deadline_ms - std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (remaining_ms <= 0)
+                break;
+
+            region_options.deadline_ms = remaining_ms / static_cast<double>(regions.size() - i);
+        }
+
+        for (auto match : findTemplateMatches(src_img(region), region_options))
+        {
+            match.center += region.tl();
+            if (mask_rect.contains(match.center) && proposal_mask.at<uchar>(match.center) != 0)
+                matches.push_back(match);
+        }
+    }
+    return matches;
+}
+
+/**
+ * @brief Orders the angles of a sweep from coarse to fine.
+ *
+ * The index step between the angles is halved (rounding up) at every level, and every level holds the angles
+ * on its step not already in a coarser level: with 72 angles, the levels are {0, 180}, {90, 270}, {45, 135,
+ * 225, 315}, then the multiples of 25 degrees, and so on down to every angle.
+ *
+ * @param[in] num_angles The number of angles of the sweep.
+ * @return The indices of the angles, level by level.
+ */
+std::vector<std::vector<int>> coarseToFineAngles(int num_angles)
+{
+    std::vector<std::vector<int>> levels;
+    std::vector<bool> scheduled(num_angles, false);
+    int index_step = num_angles;
+    do
+    {
+        index_step = (index_step + 1) / 2;
+        std::vector<int> level;
+        for (int i = 0; i < num_angles; i += index_step)
+        {
+            if (!scheduled[i])
+            {
+                scheduled[i] = true;
+                level.push_back(i);
+            }
+        }
+        if (!level.empty())
+            levels.push_back(level);
+    } while (index_step > 1);
+
+    return levels;
+}
+
+/**
+ * @brief Performs template matching under a latency deadline, publishing the matches as they are found.
+ *
+ * The (template, angle) pairs are correlated with the FFT engine in a fixed priority order: angles from
+ * coarse to fine (see `coarseToFineAngles`) and, within an angle, templates from the most to the least
+ * contrasted, since flat templates correlate with almost anything. The templates of an angle are taken by mask
+ * group, so that they share their window norms (see `maskGroupWindowNorms`), the groups in the order of their
+ * most contrasted template. With `options.pruning_recall` set, the pairs pruned by the profile are skipped.
+ *
+ * The deadline is checked once the bank and the scene transforms are ready, and then before every transform:
+ * the pool threads stop once it has expired, so the call returns after the deadline by at most the time of one
+ * correlation. Whenever all the pairs of an angle are completed, the matches found so far are published to
+ * `on_progress`.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] deadline_ms The time budget of the search, in milliseconds, including the bank and the scene
+ *                        transforms. 0 searches every pair.
+ * @param[in] options The matching options (angle step, pruning recall and peak extraction parameters).
+ * @param[in] on_progress Called with the matches so far, sorted by descending score, and the coverage
+ *                        reached, every time an angle is completed. It is called from the pool threads,
+ *                        one call at a time. It may be empty.
+ * @return The matches found before the deadline, sorted by descending score, and the coverage reached, relative
+ *         to the pairs kept by the pruning profile.
+ *
+ * @see coarseToFineAngles
+ * @see performFftTemplateMatching
+ * @see sharedPruningProfile
+ * @see sharedThreadPool
+ */
+AnytimeMatchingResult anytimeTemplateMatching(const cv::Mat& src_img, double deadline_ms, const TemplateMatchingOptions& options, const AnytimeMatchingCallback& on_progress)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(deadline_ms));
+    auto elapsed_ms = [&start]()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    auto expired = [deadline_ms, &deadline]()
+    {
+        return deadline_ms > 0 && std::chrono::steady_clock::now() >= deadline;
+    };
+
+    const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(options.angle_step);
+    const auto& prepared_templates = bank->preparedTemplates();
+    const int num_templates = static_cast<int>(bank->templates().size());
+    const int num_angles = static_cast<int>(angle_range(0, 360, options.angle_step).size());
+
+    const std::shared_ptr<const PruningProfile> pruning_profile = options.pruning_recall > 0 ? sharedPruningProfile(options.pruning_recall, *bank) : nullptr;
+
+    // Templates by decreasing contrast (standard deviation of the upright template)
+    std::vector<int> template_order(num_templates);
+    std::iota(template_order.begin(), template_order.end(), 0);
+    auto contrast = [&](int i)
+    {
+        const PreparedTemplate& upright_template = prepared_templates[static_cast<size_t>(i) * num_angles];
+        return upright_template.norm / std::sqrt(static_cast<double>(upright_template.kernel.total()));
+    };
+    std::stable_sort(template_order.begin(), template_order.end(), [&](int a, int b) { return contrast(a) > contrast(b); });
+
+    struct WorkItem
+    {
+        std::vector<size_t> bank_indices; // the kept templates of a mask group, by decreasing contrast
+        int level;
+        int angle_index;
+    };
+    const std::vector<std::vector<int>> angle_levels = coarseToFineAngles(num_angles);
+    std::vector<WorkItem> work_items;
+    std::vector<size_t> pairs_per_level(angle_levels.size(), 0);
+    std::vector<size_t> pairs_per_angle(num_angles, 0);
+    for (size_t level = 0; level < angle_levels.size(); level++)
+    {
+        for (const int angle_index : angle_levels[level])
+        {
+            std::map<size_t, size_t> group_items;
+            for (const int template_index : template_order)
+            {
+                if (pruning_profile && !pruning_profile->keeps(template_index, angle_index * options.angle_step))
+                    continue;
+
+                const size_t bank_index = static_cast<size_t>(template_index) * num_angles + angle_index;
+                const auto [group_item, inserted] = group_items.emplace(bank->maskGroup(bank_index), work_items.size());
+                if (inserted)
+                    work_items.push_back({ {}, static_cast<int>(level), angle_index });
+
+                work_items[group_item->second].bank_indices.push_back(bank_index);
+                pairs_per_angle[angle_index]++;
+                pairs_per_level[level]++;
+            }
+        }
+    }
+
+    AnytimeMatchingResult result;
+    for (const size_t level_pairs : pairs_per_level)
+        result.coverage.total_pairs += level_pairs;
+    result.coverage.total_levels = static_cast<int>(angle_levels.size());
+
+    const FftCorrelator correlator(src_img);
+    bank->useSpectrumCache(correlator.dftSize(), options.spectrum_cache_mb << 20);
+
+    std::mutex result_mutex;
+    std::vector<size_t> completed_per_level(angle_levels.size(), 0);
+    std::vector<size_t> completed_per_angle(num_angles, 0);
+    std::atomic<size_t> next_item = 0;
+
+    // Coverage of the pairs completed so far; called with the result mutex held
+    auto update_coverage = [&]()
+    {
+        int completed_levels = 0;
+        while (completed_levels < result.coverage.total_levels && completed_per_level[completed_levels] == pairs_per_level[completed_levels])
+            completed_levels++;
+        result.coverage.completed_levels = completed_levels;
+
+        // Angles whose pairs are all pruned are never searched
+        std::vector<int> searched_angles;
+        for (int i = 0; i < num_angles; i++)
+        {
+            if (pairs_per_angle[i] > 0 && completed_per_angle[i] == pairs_per_angle[i])
+                searched_angles.push_back(i * options.angle_step);
+        }
+
+        result.coverage.max_angle_gap = 360.0;
+        if (searched_angles.size() > 1)
+        {
+            int max_gap = 360 - searched_angles.back() + searched_angles.front();
+            for (size_t i = 1; i < searched_angles.size(); i++)
+                max_gap = std::max(max_gap, searched_angles[i] - searched_angles[i - 1]);
+            result.coverage.max_angle_gap = max_gap;
+        }
+        result.coverage.elapsed_ms = elapsed_ms();
+    };
+
+    auto worker = [&]()
+    {
+        for (size_t item = next_item++; item < work_items.size() && !expired(); item = next_item++)
+        {
+            const WorkItem& work_item = work_items[item];
+            const cv::Mat window_norms = maskGroupWindowNorms(correlator, *bank, work_item.bank_indices.front());
+
+            for (const size_t bank_index : work_item.bank_indices)
+            {
+                if (expired())
+                    break;
+
+                std::vector<TemplateMatch> local_matches = performFftTemplateMatching(correlator, *bank, bank_index, window_norms, options);
+
+                std::lock_guard<std::mutex> lock(result_mutex);
+                result.matches.insert(result.matches.end(), local_matches.begin(), local_matches.end());
+                result.coverage.searched_pairs++;
+                completed_per_level[work_item.level]++;
+                if (++completed_per_angle[work_item.angle_index] == pairs_per_angle[work_item.angle_index] && on_progress)
+                {
+                    update_coverage();
+                    keepBestMatches(result.matches, result.matches.size());
+                    on_progress(result.matches, result.coverage);
+                }
+            }
+        }
+    };
+
+    // The bank and the scene transforms may already have used up the budget
+    if (!expired())
+    {
+        ThreadPool& pool = sharedThreadPool();
+        TemplateMatchingOptions fft_options = options;
+        fft_options.mode = MatchingMode::Fft;
+        const size_t task_memory = matchingTaskMemory(src_img.size(), fft_options);
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < pool.numThreads(); i++)
+            futures.emplace_back(pool.submit(worker, task_memory));
+        pool.waitAll(futures);
+    }
+
+    update_coverage();
+    result.coverage.deadline_expired = result.coverage.searched_pairs < result.coverage.total_pairs;
+    keepBestMatches(result.matches, result.matches.size());
+    return result;
+}
+
+/**
+ * @brief Finds the template matches in a source image, with their scores.
+ *
+ * This function gets the template bank for the angle step of the options and dispatches the matching to the engine
+ * selected by `options.mode`. If a proposal method is selected, only the proposed regions are searched.
+ * If a deadline is set, the anytime search runs instead, whatever the mode, with the pruning profile of the
+ * options, and its coverage is discarded; with proposals, the regions share the deadline.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] options The matching options.
+ * @return A vector of `TemplateMatch` objects holding the coordinates, scores, template indices and angles of the matches.
+ *
+ * @see sharedTemplateBank
+ * @see matchTemplateMultiThreaded
+ * @see matchTemplatePyramid
+ * @see matchTemplateOriented
+ * @see matchTemplateEigenBasis
+ * @see matchTemplateTiled
+ * @see matchTemplateInProposals
+ * @see anytimeTemplateMatching
+ */
+std::vector<TemplateMatch> findTemplateMatches(const cv::Mat& src_img, const TemplateMatchingOptions& options)
+{
+    if (options.proposal_method != ProposalMethod::None)
+        return matchTemplateInProposals(src_img, options);
+
+    if (options.deadline_ms > 0)
+        return anytimeTemplateMatching(src_img, options.deadline_ms, options).matches;
+
+    const std::shared_ptr<const TemplateBank> bank = sharedTemplateBank(options.angle_step);
+
+    if (options.mode == MatchingMode::Pyramid)
+        return matchTemplatePyramid(src_img, bank, options);
+
+    if (options.mode == MatchingMode::Oriented)
+        return matchTemplateOriented(src_img, *bank, options);
+
+    if (options.mode == MatchingMode::EigenBasis)
+        return matchTemplateEigenBasis(src_img, bank, options);
+
+    if (options.tile_size > 0 && options.mode != MatchingMode::RotateScene)
+        return matchTemplateTiled(src_img, *bank, options);
+
+    return matchTemplateMultiThreaded(src_img, *bank, options);
+}
+
+/**
+ * @brief Performs template matching on a source image using pre-loaded average planes.
+ *
+ * This function performs multi-threaded template matching on the source image, with the shared template bank
+ * and the process-wide options (see `templateMatchingOptions`).
+ * It returns the coordinates of all matched points found in the image.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @return A vector of `cv::Point` objects representing the coordinates of all matched points.
+ *
+ * @see templateMatchingOptions
+ */
+std::vector<cv::Point> templateMatching(const cv::Mat& src_img)
+{
+    return templateMatching(src_img, templateMatchingOptions());
+}
+
+/**
+ * @brief Performs template matching on a source image using pre-loaded average planes.
+ *
+ * This function performs template matching on the source image with the shared template bank.
+ * It returns the coordinates of all matched points found in the image.
+ *
+ * @param[in] src_img The source image in which to perform template matching.
+ * @param[in] options The matching options.
+ * @return A vector of `cv::Point` objects representing the coordinates of all matched points.
+ *
+ * @see findTemplateMatches
+ */
+std::vector<cv::Point> templateMatching(const cv::Mat& src_img, const TemplateMatchingOptions& options)
+{
+    const std::vector<TemplateMatch> matches = findTemplateMatches(src_img, options);
+
+    std::vector<cv::Point> matched_points;
+    matched_points.reserve(matches.size());
+    for (const auto& match : matches)
+        matched_points.push_back(match.center);
 
     return matched_points;
 }
\ No newline at end of file
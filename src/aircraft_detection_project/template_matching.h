@@ -1,7 +1,113 @@
 #pragma once
 
+#include "proposals.h"
 #include <opencv2/opencv.hpp>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 
-std::vector<cv::Point> templateMatching(const cv::Mat& src_img);
\ No newline at end of file
+enum class MatchingMode
+{
+    RotateScene,     // rotate the whole scene for every angle and correlate the upright templates
+    RotateTemplates, // pre-rotate the templates (with masks) and correlate them against the unrotated scene
+    Fft,             // as RotateTemplates, with an FFT correlation engine sharing the scene spectrum
+    Pyramid,         // coarse-to-fine search: full angle sweep on a downsampled scene, local refinement of the best candidates
+    Oriented,        // local search around candidate locations, at the rotations suggested by the local gradient orientation
+    EigenBasis       // correlate the principal components shared by the templates and combine their responses
+};
+
+enum class CorrelationBackend
+{
+    Float,    // cv::matchTemplate
+    Integer,  // 8-bit integer SIMD kernel, for the local searches (see integer_correlation.h)
+    Separable // low-rank separable approximation of the templates (see separable_correlation.h)
+};
+
+struct TemplateMatchingOptions
+{
+    MatchingMode mode = MatchingMode::Fft;
+    CorrelationBackend correlation_backend = CorrelationBackend::Float;
+    int angle_step = 5;
+    int pyramid_levels = 2;
+    int pyramid_candidates = 200;
+    double match_tolerance = 4.0;
+    int peaks_per_map = 1;
+    float peak_threshold = -1.0f;
+    int peak_radius = 0;    // 0 selects half the smaller template side
+    int tile_size = 0;      // 0 matches the whole scene at once
+    double separable_energy = 0.99;
+    int orientation_candidates = 500;
+    int orientation_window = 10; // degrees searched on each side of the estimated rotation
+    ProposalMethod proposal_method = ProposalMethod::None;
+    double proposal_fraction = 0.1; // fraction of the (downsampled) pixels kept by the proposal stage
+    double eigen_energy = 0.99;     // fraction of the template energy kept by the eigen-basis mode
+    double deadline_ms = 0.0;       // time budget of the anytime search, 0 disables it
+    double pruning_recall = 0.0;    // fraction of the profiled hits kept when pruning (template, angle) pairs, 0 disables pruning
+    size_t spectrum_cache_mb = 1024; // memory of the template spectra cached across scenes by the FFT engine, 0 disables the cache
+};
+
+struct RotatedTemplate
+{
+    cv::Mat image;
+    cv::Mat mask;
+    int template_index = 0;
+    int degree_angle = 0;
+};
+
+struct TemplateMatch
+{
+    cv::Point center;       // center of the match, in source image coordinates
+    float score = 0.0f;     // normalized cross-correlation score
+    int template_index = 0; // index of the matched template
+    int degree_angle = 0;   // scene rotation angle the match corresponds to
+};
+
+struct MatchingCoverage
+{
+    size_t searched_pairs = 0;    // (template, angle) pairs correlated
+    size_t total_pairs = 0;       // (template, angle) pairs of the full search, without the pruned ones
+    int completed_levels = 0;     // coarse-to-fine angle levels searched for every kept template
+    int total_levels = 0;         // coarse-to-fine angle levels of the full search
+    double max_angle_gap = 360.0; // largest gap, in degrees, between two consecutive angles searched for every kept template
+    double elapsed_ms = 0.0;
+    bool deadline_expired = false;
+};
+
+struct AnytimeMatchingResult
+{
+    std::vector<TemplateMatch> matches; // sorted by descending score
+    MatchingCoverage coverage;
+};
+
+using AnytimeMatchingCallback = std::function<void(const std::vector<TemplateMatch>&, const MatchingCoverage&)>;
+
+class TemplateBank;
+struct PruningProfile;
+
+TemplateMatchingOptions& templateMatchingOptions();
+
+MatchingMode parseMatchingMode(const std::string& mode);
+
+CorrelationBackend parseCorrelationBackend(const std::string& backend);
+
+std::shared_ptr<const TemplateBank> sharedTemplateBank(int angle_step);
+
+void saveTemplateBank();
+
+void compactTemplateBank(double min_similarity);
+
+std::shared_ptr<const PruningProfile> sharedPruningProfile(double target_recall, const TemplateBank& bank);
+
+void startMatchingProfile();
+
+void saveMatchingProfile();
+
+std::vector<TemplateMatch> findTemplateMatches(const cv::Mat& src_img, const TemplateMatchingOptions& options);
+
+AnytimeMatchingResult anytimeTemplateMatching(const cv::Mat& src_img, double deadline_ms, const TemplateMatchingOptions& options, const AnytimeMatchingCallback& on_progress = {});
+
+std::vector<cv::Point> templateMatching(const cv::Mat& src_img);
+
+std::vector<cv::Point> templateMatching(const cv::Mat& src_img, const TemplateMatchingOptions& options);
\ No newline at end of file
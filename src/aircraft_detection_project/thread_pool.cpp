@@ -0,0 +1,248 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+
+namespace
+{
+    // Pool and queue of the worker running on the current thread, if any
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+
+    // Number of tasks being run by the current thread (more than one when a task helps while waiting)
+    thread_local int running_task_depth = 0;
+}
+
+
+
+/**
+ * @brief Starts the worker threads of the pool.
+ *
+ * Every worker owns a task queue: it pushes and pops its own tasks at the back (so nested tasks run depth-first,
+ * while their data is still in cache) and, when its queue is empty, steals tasks from the front of the others.
+ *
+ * @param[in] num_threads The number of worker threads. 0 selects one thread.
+ * @param[in] memory_budget The maximum memory, in bytes, that the admitted tasks may allocate at once. 0 means no limit.
+ *
+ * @see submit
+ */
+ThreadPool::ThreadPool(size_t num_threads, size_t memory_budget)
+    : memory_budget(memory_budget)
+{
+    num_threads = std::max<size_t>(num_threads, 1);
+
+    for (size_t i = 0; i < num_threads; i++)
+        queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (size_t i = 0; i < num_threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+/**
+ * @brief Stops the pool, after all the queued tasks have run.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake_condition.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+/**
+ * @brief Sets the memory budget of the pool.
+ *
+ * @param[in] memory_budget The maximum memory, in bytes, that the admitted tasks may allocate at once. 0 means no limit.
+ */
+void ThreadPool::setMemoryBudget(size_t memory_budget)
+{
+    {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        this->memory_budget = memory_budget;
+    }
+    memory_condition.notify_all();
+}
+
+/**
+ * @brief Returns the memory budget of the pool, in bytes (0 means no limit).
+ */
+size_t ThreadPool::memoryBudget() const
+{
+    std::lock_guard<std::mutex> lock(memory_mutex);
+    return memory_budget;
+}
+
+/**
+ * @brief Runs the tasks of a worker until the pool is stopped.
+ *
+ * @param[in] worker_index The index of the worker, and of the queue it owns.
+ */
+void ThreadPool::workerLoop(size_t worker_index)
+{
+    current_pool = this;
+    current_worker = worker_index;
+
+    while (true)
+    {
+        if (runPendingTask())
+            continue;
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake_condition.wait(lock, [this]() { return stopping || queued_tasks.load() > 0; });
+        if (stopping && queued_tasks.load() == 0)
+            return;
+    }
+}
+
+/**
+ * @brief Pushes a task in a queue and wakes up a worker.
+ *
+ * Tasks submitted by a worker go to its own queue, the others are spread over the queues in round-robin order.
+ *
+ * @param[in] task The task to queue.
+ */
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    const size_t queue_index = current_pool == this ? current_worker : next_queue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[queue_index]->mutex);
+        queues[queue_index]->tasks.push_back(std::move(task));
+        queued_tasks++;
+    }
+
+    // Taking the lock orders the notification after any worker that is about to sleep
+    { std::lock_guard<std::mutex> lock(wake_mutex); }
+    wake_condition.notify_one();
+}
+
+/**
+ * @brief Pops a task from a queue, if any.
+ *
+ * @param[in] queue_index The index of the queue.
+ * @param[in] from_back Whether to pop the most recent task (owner) or the oldest one (thief).
+ * @param[out] task The popped task.
+ * @return `true` if a task was popped, `false` if the queue was empty.
+ */
+bool ThreadPool::popTask(size_t queue_index, bool from_back, std::function<void()>& task)
+{
+    std::lock_guard<std::mutex> lock(queues[queue_index]->mutex);
+    auto& tasks = queues[queue_index]->tasks;
+    if (tasks.empty())
+        return false;
+
+    if (from_back)
+    {
+        task = std::move(tasks.back());
+        tasks.pop_back();
+    }
+    else
+    {
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    queued_tasks--;
+    return true;
+}
+
+/**
+ * @brief Runs one pending task on the calling thread, if any.
+ *
+ * A worker first looks at its own queue, then steals from the others. Any other thread only steals.
+ *
+ * @return `true` if a task was run, `false` if all the queues were empty.
+ */
+bool ThreadPool::runPendingTask()
+{
+    const bool is_worker = current_pool == this;
+    const size_t first_queue = is_worker ? current_worker : 0;
+
+    std::function<void()> task;
+    for (size_t i = 0; i < queues.size(); i++)
+    {
+        const size_t queue_index = (first_queue + i) % queues.size();
+        if (popTask(queue_index, is_worker && i == 0, task))
+        {
+            running_task_depth++;
+            task();
+            running_task_depth--;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Waits for a batch of tasks without result, running pending tasks in the meantime.
+ *
+ * @param[in] futures The futures returned by `submit`.
+ *
+ * @throws The first exception thrown by a task, in the order of `futures`.
+ *
+ * @see waitAll
+ */
+void ThreadPool::waitAll(std::vector<std::future<void>>& futures)
+{
+    waitReady(futures);
+
+    for (auto& future : futures)
+        future.get();
+}
+
+/**
+ * @brief Reserves memory for a task, waiting until it fits in the budget.
+ *
+ * @param[in] bytes The memory estimate of the task.
+ */
+void ThreadPool::acquireMemory(size_t bytes)
+{
+    std::unique_lock<std::mutex> lock(memory_mutex);
+
+    // A task submitted from inside a running task is part of the work of an already admitted task:
+    // it is charged to the budget, but never waits, since the memory it waits for may be held by its parent
+    const bool is_nested = running_task_depth > 0;
+    while (!is_nested && memory_budget != 0 && memory_in_use != 0 && memory_in_use + bytes > memory_budget)
+    {
+        // Run queued tasks instead of idling, they are the ones that free the budget
+        lock.unlock();
+        const bool ran_task = runPendingTask();
+        lock.lock();
+
+        if (!ran_task)
+            memory_condition.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    memory_in_use += bytes;
+}
+
+/**
+ * @brief Releases the memory reserved for a task and wakes up the threads waiting for admission.
+ *
+ * @param[in] bytes The memory estimate of the task.
+ */
+void ThreadPool::releaseMemory(size_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        memory_in_use -= bytes;
+    }
+    memory_condition.notify_all();
+}
+
+/**
+ * @brief Returns the process-wide thread pool.
+ *
+ * The pool has one worker per hardware thread and is shared by all the parallel stages (template matching,
+ * HOG extraction, per-cluster processing), so that nested or concurrent stages never oversubscribe the CPU.
+ * Its memory budget (4 GB by default) can be changed with `ThreadPool::setMemoryBudget`.
+ *
+ * @return A reference to the process-wide `ThreadPool`.
+ */
+ThreadPool& sharedThreadPool()
+{
+    constexpr size_t default_memory_budget = size_t(4096) << 20;
+    static ThreadPool pool(std::thread::hardware_concurrency(), default_memory_budget);
+    return pool;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t num_threads = std::thread::hardware_concurrency(), size_t memory_budget = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template<typename F>
+    std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& task, size_t memory_estimate = 0);
+
+    template<typename T>
+    std::vector<T> waitAll(std::vector<std::future<T>>& futures);
+
+    void waitAll(std::vector<std::future<void>>& futures);
+
+    void setMemoryBudget(size_t memory_budget);
+
+    size_t memoryBudget() const;
+
+    size_t numThreads() const { return workers.size(); }
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(size_t worker_index);
+
+    void enqueue(std::function<void()> task);
+
+    bool popTask(size_t queue_index, bool from_back, std::function<void()>& task);
+
+    bool runPendingTask();
+
+    template<typename T>
+    void waitReady(const std::vector<std::future<T>>& futures);
+
+    void acquireMemory(size_t bytes);
+
+    void releaseMemory(size_t bytes);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_condition;
+    std::atomic<size_t> queued_tasks{ 0 };
+    std::atomic<size_t> next_queue{ 0 };
+    bool stopping = false;
+
+    mutable std::mutex memory_mutex;
+    std::condition_variable memory_condition;
+    size_t memory_budget;
+    size_t memory_in_use = 0;
+};
+
+ThreadPool& sharedThreadPool();
+
+
+
+/**
+ * @brief Submits a task to the pool.
+ *
+ * The task is admitted only when its memory estimate fits in the remaining memory budget (a task is always
+ * admitted when no other admitted task is pending, so that a task larger than the whole budget cannot block
+ * forever). While waiting for admission the calling thread runs pending tasks itself. Tasks submitted from
+ * inside a running task are charged to the budget but admitted at once, so nested submissions cannot
+ * deadlock the pool.
+ *
+ * @param[in] task The callable to run, without arguments.
+ * @param[in] memory_estimate An estimate, in bytes, of the peak memory allocated by the task.
+ * @return A `std::future` holding the result of the task (or the exception it threw).
+ *
+ * @see waitAll
+ */
+template<typename F>
+std::future<std::invoke_result_t<std::decay_t<F>>> ThreadPool::submit(F&& task, size_t memory_estimate)
+{
+    using Result = std::invoke_result_t<std::decay_t<F>>;
+
+    auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> future = packaged_task->get_future();
+
+    acquireMemory(memory_estimate);
+    enqueue([this, packaged_task, memory_estimate]() {
+        (*packaged_task)();
+        releaseMemory(memory_estimate);
+        });
+
+    return future;
+}
+
+/**
+ * @brief Waits for the results of a batch of tasks, running pending tasks in the meantime.
+ *
+ * All the tasks are completed before any result is read, so when a task throws, the exception is only
+ * propagated once none of the tasks of the batch is still using data owned by the caller.
+ *
+ * @param[in] futures The futures returned by `submit`.
+ * @return The results of the tasks, in the order of `futures`.
+ *
+ * @throws The first exception thrown by a task, in the order of `futures`.
+ */
+template<typename T>
+std::vector<T> ThreadPool::waitAll(std::vector<std::future<T>>& futures)
+{
+    waitReady(futures);
+
+    std::vector<T> results;
+    results.reserve(futures.size());
+    for (auto& future : futures)
+        results.push_back(future.get());
+    return results;
+}
+
+/**
+ * @brief Runs pending tasks on the calling thread until all the given tasks are completed.
+ *
+ * @param[in] futures The futures of the tasks to wait for.
+ */
+template<typename T>
+void ThreadPool::waitReady(const std::vector<std::future<T>>& futures)
+{
+    for (const auto& future : futures)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!runPendingTask())
+                future.wait_for(std::chrono::milliseconds(1));
+        }
+    }
+}
@@ -260,17 +260,16 @@ cv::Rect Yolo2BRect(const cv::Mat& img, double x_center, double y_center, double
  * @brief Checks if a region of interest (ROI) is completely within the image boundaries.
  *
  * This function checks whether a given ROI is entirely contained within the boundaries of an image
- * with the specified width and height.
+ * with the specified size.
  *
  * @param[in] roi The region of interest represented as a `cv::Rect`.
- * @param[in] width The width of the image.
- * @param[in] height The height of the image.
+ * @param[in] image_size The size of the image.
  * @return `true` if the ROI is completely within the image boundaries, `false` otherwise.
  */
-bool isRoiInImage(const cv::Rect& roi,int width, int height)
+bool isRoiInImage(const cv::Rect& roi, const cv::Size& image_size)
 {
 	// Create a rectangle that represents the image boundaries
-	const cv::Rect image_rect(0, 0, width, height);
+	const cv::Rect image_rect(cv::Point(0, 0), image_size);
 
 	// Check if the roi is completely inside the image
 	return (image_rect & roi) == roi;
@@ -361,6 +360,7 @@ std::ofstream openFile(const std::string& filename)
  *
  * @param[in] points A vector of `cv::Point` objects representing the centers of the ROIs.
  * @param[in] roi_sizes A vector of `cv::Size` objects representing the sizes of the ROIs.
+ * @param[in] image_size The size of the image the ROIs must lie in.
  * @return A vector of `cv::Rect` objects representing the valid ROIs.
  *
  * @note The function checks if each generated ROI is within the image boundaries before adding it to the output vector.
@@ -368,7 +368,7 @@ std::ofstream openFile(const std::string& filename)
  *
  * @see isRoiInImage
  */
-std::vector<cv::Rect> generateRoisFromPoints(const std::vector<cv::Point>& points, const std::vector<cv::Size>& roi_sizes)
+std::vector<cv::Rect> generateRoisFromPoints(const std::vector<cv::Point>& points, const std::vector<cv::Size>& roi_sizes, const cv::Size& image_size)
 {
 	std::vector<cv::Rect> rois;
 
@@ -379,7 +379,7 @@ std::vector<cv::Rect> generateRoisFromPoints(const std::vector<cv::Point>& point
 			const int x = point.x - roi_size.width / 2;
 			const int y = point.y - roi_size.height / 2;
 
-			if (cv::Rect roi(x, y, roi_size.width, roi_size.height); isRoiInImage(roi))
+			if (cv::Rect roi(x, y, roi_size.width, roi_size.height); isRoiInImage(roi, image_size))
 			{
 				rois.push_back(roi);
 			}
@@ -25,13 +25,13 @@ void processYoloLabels(const std::string& filePath, const cv::Mat& img, std::vec
 
 cv::Rect Yolo2BRect(const cv::Mat& img, double x_center, double y_center, double width, double height);
 
-bool isRoiInImage(const cv::Rect& roi, int width=4800, int height=2703);
+bool isRoiInImage(const cv::Rect& roi, const cv::Size& image_size);
 
 std::vector<cv::Rect> readYoloBoxes(const std::filesystem::path& file_path, const cv::Mat& img);
 
 std::ofstream openFile(const std::string& filename);
 
-std::vector<cv::Rect> generateRoisFromPoints(const std::vector<cv::Point>& points, const std::vector<cv::Size>& roi_sizes);
+std::vector<cv::Rect> generateRoisFromPoints(const std::vector<cv::Point>& points, const std::vector<cv::Size>& roi_sizes, const cv::Size& image_size);
 
 cv::Size calculateAvgDims(const std::filesystem::path& directory_path);
 